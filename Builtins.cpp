@@ -0,0 +1,72 @@
+//
+//  Copyright © 2017 Lennart Oymanns. All rights reserved.
+//
+#include <cmath>
+
+#include "Builtins.hpp"
+#include "Canonical.hpp"
+#include "Derivative.hpp"
+#include "MathFunction.hpp"
+#include "Number.hpp"
+#include "Polynomial.hpp"
+
+using namespace Equation;
+
+const Builtins &Builtins::Get() {
+  // initialization of a local static is thread safe.
+  static const Builtins builtins;
+  return builtins;
+}
+
+Builtins::Builtins() {
+  // the registry outlives every arena, i.e. the nodes (including the special
+  // values of the math functions) have to be allocated from the heap.
+  NodeArena::Scope heap(nullptr);
+
+  funcs["sin"] = std::make_shared<FuncSin>();
+  funcs["cos"] = std::make_shared<FuncCos>();
+  funcs["tan"] = std::make_shared<FuncTan>();
+  funcs["asin"] = std::make_shared<FuncASin>();
+  funcs["acos"] = std::make_shared<FuncACos>();
+  funcs["atan"] = std::make_shared<FuncATan>();
+  funcs["exp"] = std::make_shared<FuncExp>();
+  funcs["log"] = std::make_shared<FuncLog>();
+  funcs["sqrt"] = std::make_shared<FuncSqrt>();
+  funcs["sinh"] = std::make_shared<FuncSinh>();
+  funcs["cosh"] = std::make_shared<FuncCosh>();
+  funcs["tanh"] = std::make_shared<FuncTanh>();
+  funcs["arsinh"] = std::make_shared<FuncArSinh>();
+  funcs["arcosh"] = std::make_shared<FuncArCosh>();
+  funcs["artanh"] = std::make_shared<FuncArTanh>();
+  funcs["D"] = std::make_shared<Derivative>();
+  funcs["grad"] = std::make_shared<FuncGrad>();
+  funcs["jacobian"] = std::make_shared<FuncJacobian>();
+  funcs["hessian"] = std::make_shared<FuncHessian>();
+  funcs["taylor"] = std::make_shared<FuncTaylor>();
+  funcs["expand"] = std::make_shared<FuncExpand>();
+  funcs["normal"] = std::make_shared<FuncNormal>();
+
+  variables["pi"] = new_node<Number>(M_PI);
+
+  // hashes are cached lazily; computing them now avoids writes to shared
+  // nodes later.
+  for (const auto &v : variables) {
+    cache_canonical(v.second);
+  }
+}
+
+UserFunction *Builtins::Function(const std::string &name) const {
+  auto it = funcs.find(name);
+  if (it == funcs.end()) {
+    return nullptr;
+  }
+  return it->second.get();
+}
+
+NodePtr Builtins::Variable(const std::string &name) const {
+  auto it = variables.find(name);
+  if (it == variables.end()) {
+    return 0;
+  }
+  return it->second;
+}
@@ -0,0 +1,48 @@
+//
+//  Copyright © 2017 Lennart Oymanns. All rights reserved.
+//
+
+#ifndef Builtins_hpp
+#define Builtins_hpp
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "State.hpp"
+
+namespace Equation {
+
+/** Builtins is the registry of the predefined functions (sin, cos, ..., D)
+ and constants (pi).
+
+ There is only one registry per process. It is created on the first call of
+ Get() and is never modified afterwards, so it can be used by several threads
+ at the same time. All nodes of the registry are allocated from the heap (not
+ from a NodeArena) and their hashes are computed in advance. Callers must not
+ modify the returned nodes; clone them instead. */
+class Builtins {
+public:
+  /** Get returns the registry. */
+  static const Builtins &Get();
+
+  /** Function returns the builtin function name or nullptr. */
+  UserFunction *Function(const std::string &name) const;
+
+  /** Variable returns the value of the builtin constant name or an empty
+   pointer. */
+  NodePtr Variable(const std::string &name) const;
+
+  Builtins(const Builtins &) = delete;
+  Builtins &operator=(const Builtins &) = delete;
+
+private:
+  Builtins();
+
+  std::unordered_map<std::string, std::shared_ptr<UserFunction>> funcs;
+  std::unordered_map<std::string, NodePtr> variables;
+};
+
+} // namespace Equation
+
+#endif /* Builtins_hpp */
@@ -0,0 +1,166 @@
+//
+//  Copyright © 2017 Lennart Oymanns. All rights reserved.
+//
+
+#include "Canonical.hpp"
+#include "Function.hpp"
+#include "Number.hpp"
+#include "Power.hpp"
+#include "TwoOp.hpp"
+#include "UnaryMinus.hpp"
+#include "Variable.hpp"
+
+namespace Equation {
+
+namespace {
+
+template <class T> int compare_values(const T &a, const T &b) {
+  if (a < b) {
+    return -1;
+  }
+  if (b < a) {
+    return 1;
+  }
+  return 0;
+}
+
+int compare_numbers(const NumberRepr &a, const NumberRepr &b) {
+  // invalid numbers are ordered last, then floating point numbers after
+  // fractions.
+  if (a.IsValid() != b.IsValid()) {
+    return a.IsValid() ? -1 : 1;
+  }
+  if (!a.IsValid()) {
+    return 0;
+  }
+  if (a.IsFraction() != b.IsFraction()) {
+    return a.IsFraction() ? -1 : 1;
+  }
+  if (a == b) {
+    return 0;
+  }
+  return a < b ? -1 : 1;
+}
+
+int compare_lists(const NodeList &a, const NodeList &b) {
+  if (a.size() != b.size()) {
+    return compare_values(a.size(), b.size());
+  }
+  for (size_t i = 0; i < a.size(); i++) {
+    int c = canonical_compare(a[i], b[i]);
+    if (c != 0) {
+      return c;
+    }
+  }
+  return 0;
+}
+
+int compare_structure(const NodePtr &a, const NodePtr &b) {
+  if (a->Type() != b->Type()) {
+    return compare_values(static_cast<int>(a->Type()),
+                          static_cast<int>(b->Type()));
+  }
+  switch (a->Type()) {
+  case Node::Type_t::Number:
+    return compare_numbers(std::static_pointer_cast<Number>(a)->GetValue(),
+                           std::static_pointer_cast<Number>(b)->GetValue());
+  case Node::Type_t::Variable:
+    return std::static_pointer_cast<Variable>(a)->Name().compare(
+        std::static_pointer_cast<Variable>(b)->Name());
+  case Node::Type_t::Power: {
+    auto pa = std::static_pointer_cast<Power>(a);
+    auto pb = std::static_pointer_cast<Power>(b);
+    int c = canonical_compare(pa->Base(), pb->Base());
+    if (c != 0) {
+      return c;
+    }
+    return canonical_compare(pa->Exponent(), pb->Exponent());
+  }
+  case Node::Type_t::Function: {
+    auto fa = std::static_pointer_cast<Function>(a);
+    auto fb = std::static_pointer_cast<Function>(b);
+    int c = fa->Name().compare(fb->Name());
+    if (c != 0) {
+      return c;
+    }
+    return compare_lists(fa->Args(), fb->Args());
+  }
+  case Node::Type_t::UnaryMinus:
+    return canonical_compare(
+        std::static_pointer_cast<const UnaryMinus>(a)->Data(),
+        std::static_pointer_cast<const UnaryMinus>(b)->Data());
+  case Node::Type_t::Summand:
+  case Node::Type_t::Factor: {
+    auto ta = std::static_pointer_cast<const TwoOp>(a);
+    auto tb = std::static_pointer_cast<const TwoOp>(b);
+    const auto &oa = ta->Data();
+    const auto &ob = tb->Data();
+    if (oa.size() != ob.size()) {
+      return compare_values(oa.size(), ob.size());
+    }
+    const auto &ia = ta->CanonicalOrder();
+    const auto &ib = tb->CanonicalOrder();
+    for (size_t i = 0; i < ia.size(); i++) {
+      int c = canonical_compare(oa[ia[i]], ob[ib[i]]);
+      if (c != 0) {
+        return c;
+      }
+    }
+    return 0;
+  }
+  }
+  return 0;
+}
+
+} // namespace
+
+int canonical_compare(const NodePtr &a, const NodePtr &b) {
+  if (a == b) {
+    return 0;
+  }
+  auto ha = a->Hash();
+  auto hb = b->Hash();
+  if (ha != hb) {
+    return compare_values(ha, hb);
+  }
+  return compare_structure(a, b);
+}
+
+void canonical_sort(NodeList &op) {
+  op.sort([](const NodePtr &a, const NodePtr &b) {
+    return canonical_compare(a, b) < 0;
+  });
+}
+
+void cache_canonical(const NodePtr &n) {
+  switch (n->Type()) {
+  case Node::Type_t::Power: {
+    auto p = std::static_pointer_cast<Power>(n);
+    cache_canonical(p->Base());
+    cache_canonical(p->Exponent());
+    break;
+  }
+  case Node::Type_t::Function:
+    for (const auto &e : std::static_pointer_cast<const Function>(n)->Args()) {
+      cache_canonical(e);
+    }
+    break;
+  case Node::Type_t::UnaryMinus:
+    cache_canonical(std::static_pointer_cast<const UnaryMinus>(n)->Data());
+    break;
+  case Node::Type_t::Summand:
+  case Node::Type_t::Factor: {
+    auto t = std::static_pointer_cast<const TwoOp>(n);
+    for (const auto &e : t->Data()) {
+      cache_canonical(e);
+    }
+    t->CanonicalOrder();
+    break;
+  }
+  default:
+    break;
+  }
+  n->Hash();
+}
+
+} // namespace Equation
@@ -0,0 +1,32 @@
+//
+//  Copyright © 2017 Lennart Oymanns. All rights reserved.
+//
+
+#ifndef Canonical_hpp
+#define Canonical_hpp
+
+#include "Node.hpp"
+
+namespace Equation {
+
+/** canonical_compare defines a total order on nodes.
+
+ The result is 0 if a and b are equal (see Node::equals), negative if a is
+ ordered before b and positive otherwise. Nodes are ordered by their hash
+ first, so the structure of two nodes is only compared if their hashes are
+ equal. The order of the operands of sums and products does not matter. */
+int canonical_compare(const NodePtr &a, const NodePtr &b);
+
+/** canonical_sort sorts the nodes in op according to canonical_compare. After
+ sorting, two lists which contain the same nodes in any order are equal
+ element by element. */
+void canonical_sort(NodeList &op);
+
+/** cache_canonical computes the cached hashes and canonical orders of n and
+ all its children. Comparing n afterwards does not write to it, which is
+ required for nodes that are shared between threads. */
+void cache_canonical(const NodePtr &n);
+
+} // namespace Equation
+
+#endif /* Canonical_hpp */
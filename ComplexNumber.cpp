@@ -38,7 +38,7 @@ std::pair<std::complex<NumberRepr>, bool> complex_number(NodePtr n) {
     return invalid;
   }
   if (n->Type() == Node::Type_t::Factor) {
-    auto factor = std::static_pointer_cast<Factor>(n);
+    auto factor = std::static_pointer_cast<const Factor>(n);
     if (factor->Data().size() != 2) {
       return invalid;
     }
@@ -60,7 +60,7 @@ std::pair<std::complex<NumberRepr>, bool> complex_number(NodePtr n) {
   }
   // is it a + b*i?
   if (n->Type() == Node::Type_t::Summand) {
-    auto summand = std::static_pointer_cast<Summand>(n);
+    auto summand = std::static_pointer_cast<const Summand>(n);
     if (summand->Data().size() != 2) {
       return invalid;
     }
@@ -86,17 +86,17 @@ std::pair<std::complex<NumberRepr>, bool> complex_number(NodePtr n) {
  */
 NodePtr node_from_complex(std::complex<double> c) {
   if (c.imag() == 0.0) {
-    return std::make_shared<Number>(c.real());
+    return new_node<Number>(c.real());
   }
   if (c.real() == 0.0) {
-    auto factor = std::make_shared<Factor>();
-    factor->AddOp1(std::make_shared<Number>(c.imag()));
-    factor->AddOp1(std::make_shared<Variable>("i"));
+    auto factor = new_node<Factor>();
+    factor->AddOp1(new_node<Number>(c.imag()));
+    factor->AddOp1(new_node<Variable>("i"));
     return factor;
   }
   auto real = node_from_complex(std::complex<double>(c.real(), 0.0));
   auto imag = node_from_complex(std::complex<double>(0.0, c.imag()));
-  auto sum = std::make_shared<Summand>();
+  auto sum = new_node<Summand>();
   sum->AddOp1(real);
   sum->AddOp1(imag);
   return sum;
@@ -108,19 +108,19 @@ NodePtr node_from_complex(std::complex<double> c) {
  */
 NodePtr node_from_complex(std::complex<NumberRepr> c) {
   if (c.imag() == NumberRepr(0l) || c.imag() == NumberRepr(0.0)) {
-    return std::make_shared<Number>(c.real());
+    return new_node<Number>(c.real());
   }
   if (c.real() == NumberRepr(0l) || c.real() == NumberRepr(0.0)) {
-    auto factor = std::make_shared<Factor>();
-    factor->AddOp1(std::make_shared<Number>(c.imag()));
-    factor->AddOp1(std::make_shared<Variable>("i"));
+    auto factor = new_node<Factor>();
+    factor->AddOp1(new_node<Number>(c.imag()));
+    factor->AddOp1(new_node<Variable>("i"));
     return factor;
   }
   auto real =
       node_from_complex(std::complex<NumberRepr>(c.real(), NumberRepr(0l)));
   auto imag =
       node_from_complex(std::complex<NumberRepr>(NumberRepr(0l), c.imag()));
-  auto sum = std::make_shared<Summand>();
+  auto sum = new_node<Summand>();
   sum->AddOp1(real);
   sum->AddOp1(imag);
   return sum;
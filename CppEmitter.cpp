@@ -0,0 +1,217 @@
+//
+//  Copyright © 2017 Lennart Oymanns. All rights reserved.
+//
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+#include <vector>
+
+#include "CppEmitter.hpp"
+#include "Error.h"
+
+using namespace Equation;
+
+namespace {
+
+/** function_name returns the C++ function for op or nullptr if op is an
+ operator. */
+const char *function_name(Program::Op op) {
+  switch (op) {
+  case Program::Op::Pow:
+    return "std::pow";
+  case Program::Op::Sqrt:
+    return "std::sqrt";
+  case Program::Op::Exp:
+    return "std::exp";
+  case Program::Op::Log:
+    return "std::log";
+  case Program::Op::Sin:
+    return "std::sin";
+  case Program::Op::Cos:
+    return "std::cos";
+  case Program::Op::Tan:
+    return "std::tan";
+  case Program::Op::ASin:
+    return "std::asin";
+  case Program::Op::ACos:
+    return "std::acos";
+  case Program::Op::ATan:
+    return "std::atan";
+  case Program::Op::Sinh:
+    return "std::sinh";
+  case Program::Op::Cosh:
+    return "std::cosh";
+  case Program::Op::Tanh:
+    return "std::tanh";
+  case Program::Op::ASinh:
+    return "std::asinh";
+  case Program::Op::ACosh:
+    return "std::acosh";
+  case Program::Op::ATanh:
+    return "std::atanh";
+  default:
+    return nullptr;
+  }
+}
+
+/** literal returns a C++ literal which is exactly equal to d. */
+std::string literal(double d) {
+  if (std::isnan(d)) {
+    return "std::numeric_limits<double>::quiet_NaN()";
+  }
+  if (std::isinf(d)) {
+    return d > 0 ? "std::numeric_limits<double>::infinity()"
+                 : "(-std::numeric_limits<double>::infinity())";
+  }
+  std::stringstream ss;
+  ss << std::setprecision(17) << d;
+  auto s = ss.str();
+  if (s.find_first_of(".eE") == std::string::npos) {
+    s += ".0";
+  }
+  if (d < 0) {
+    return "(" + s + ")";
+  }
+  return s;
+}
+
+/** keywords are the C++ keywords and alternative tokens, sorted. */
+const char *const keywords[] = {
+    "alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor",
+    "bool", "break", "case", "catch", "char", "char16_t", "char32_t", "char8_t",
+    "class", "co_await", "co_return", "co_yield", "compl", "concept", "const",
+    "const_cast", "consteval", "constexpr", "constinit", "continue", "decltype",
+    "default", "delete", "do", "double", "dynamic_cast", "else", "enum",
+    "explicit", "export", "extern", "false", "float", "for", "friend", "goto",
+    "if", "inline", "int", "long", "mutable", "namespace", "new", "noexcept",
+    "not", "not_eq", "nullptr", "operator", "or", "or_eq", "private",
+    "protected", "public", "register", "reinterpret_cast", "requires", "return",
+    "short", "signed", "sizeof", "static", "static_assert", "static_cast",
+    "struct", "switch", "template", "this", "thread_local", "throw", "true",
+    "try", "typedef", "typeid", "typename", "union", "unsigned", "using",
+    "virtual", "void", "volatile", "wchar_t", "while", "xor", "xor_eq"};
+
+/** check_identifier throws an InputError if name cannot be used as a name in
+ the generated code. Names starting with an underscore are reserved for the
+ temporaries, std and calcgen_powi are used by the generated code. */
+void check_identifier(const std::string &name) {
+  bool valid = !name.empty() && name[0] != '_' &&
+               !std::isdigit(static_cast<unsigned char>(name[0]));
+  for (auto c : name) {
+    if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_') {
+      valid = false;
+    }
+  }
+  if (!valid) {
+    throw InputError(0, "'" + name + "' is not a valid C++ identifier");
+  }
+  if (std::binary_search(std::begin(keywords), std::end(keywords), name) ||
+      name == "std" || name == "calcgen_powi") {
+    throw InputError(0, "'" + name + "' is reserved in C++");
+  }
+}
+
+} // namespace
+
+void CppEmitter::EmitPrelude(std::ostream &s) {
+  s << "#include <cmath>\n"
+    << "#include <limits>\n\n"
+    << "#ifndef CALCGEN_POWI\n"
+    << "#define CALCGEN_POWI\n"
+    << "/** calcgen_powi returns x^n for an integer n. */\n"
+    << "constexpr double calcgen_powi(double x, int n) {\n"
+    << "  return n < 0 ? 1.0 / calcgen_powi(x, -n)\n"
+    << "               : n == 0 ? 1.0\n"
+    << "                        : n % 2 == 1 ? x * calcgen_powi(x, n - 1)\n"
+    << "                                     : calcgen_powi(x * x, n / 2);\n"
+    << "}\n"
+    << "#endif\n\n";
+}
+
+void CppEmitter::Emit(std::ostream &s, const std::string &name,
+                      const Program &p) const {
+  if (!p.IsReal()) {
+    throw InputError(0, "cannot emit complex program '" + name + "'");
+  }
+  const auto &vars = p.Variables();
+  const auto &consts = p.Constants();
+  check_identifier(name);
+  for (const auto &v : vars) {
+    check_identifier(v);
+  }
+
+  // expr[r] is the current C++ expression of register r.
+  std::vector<std::string> expr(p.NumRegisters());
+  for (std::size_t i = 0; i < vars.size(); i++) {
+    expr[i] = vars[i];
+  }
+  for (std::size_t i = 0; i < consts.size(); i++) {
+    expr[vars.size() + i] = literal(consts[i].real());
+  }
+
+  bool calls = false;
+  std::stringstream body;
+  for (std::size_t k = 0; k < p.Code().size(); k++) {
+    const auto &in = p.Code()[k];
+    const auto &a = expr[in.a];
+    std::string e;
+    bool call = false;
+    switch (in.op) {
+    case Program::Op::Add:
+      e = a + " + " + expr[in.b];
+      break;
+    case Program::Op::Sub:
+      e = a + " - " + expr[in.b];
+      break;
+    case Program::Op::Mul:
+      e = a + " * " + expr[in.b];
+      break;
+    case Program::Op::Div:
+      e = a + " / " + expr[in.b];
+      break;
+    case Program::Op::Neg:
+      e = "-" + a;
+      break;
+    case Program::Op::PowInt:
+      e = "calcgen_powi(" + a + ", " + std::to_string(in.b) + ")";
+      call = true;
+      break;
+    case Program::Op::Pow:
+      e = "std::pow(" + a + ", " + expr[in.b] + ")";
+      call = true;
+      calls = true;
+      break;
+    default:
+      e = std::string(function_name(in.op)) + "(" + a + ")";
+      call = true;
+      calls = true;
+      break;
+    }
+    if (temps) {
+      // variables start with a letter, so the names cannot collide.
+      auto t = "_t" + std::to_string(k);
+      body << "  const double " << t << " = " << e << ";\n";
+      expr[in.dst] = t;
+    } else if (call) {
+      expr[in.dst] = e;
+    } else {
+      expr[in.dst] = "(" + e + ")";
+    }
+  }
+
+  bool is_constexpr = !calls && !temps;
+  s << (is_constexpr ? "constexpr" : "inline") << " double " << name << "(";
+  for (std::size_t i = 0; i < vars.size(); i++) {
+    if (i > 0) {
+      s << ", ";
+    }
+    s << "double " << vars[i];
+  }
+  s << ") {\n" << body.str();
+  s << "  return " << expr[p.Result()] << ";\n";
+  s << "}\n";
+}
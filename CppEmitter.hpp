@@ -0,0 +1,44 @@
+//
+//  Copyright © 2017 Lennart Oymanns. All rights reserved.
+//
+
+#ifndef CppEmitter_hpp
+#define CppEmitter_hpp
+
+#include <iostream>
+#include <string>
+
+#include "Program.hpp"
+
+namespace Equation {
+
+/** CppEmitter writes a compiled Program as a standalone C++ function.
+
+ The function takes one double parameter per variable of the program and
+ returns a double. With temporaries, every instruction of the program becomes
+ a local constant, so common subexpressions are computed once. Without
+ temporaries, the function consists of a single return statement; if it does
+ not call any library functions, it is declared constexpr.
+
+ The generated code needs <cmath> and the helper calcgen_powi, both are
+ written by EmitPrelude. */
+class CppEmitter {
+public:
+  explicit CppEmitter(bool temporaries = true) : temps(temporaries) {}
+
+  /** EmitPrelude writes the includes and helpers for the generated functions.
+   It has to be written once before the functions. */
+  static void EmitPrelude(std::ostream &s);
+
+  /** Emit writes the function name for program p to stream s. It throws an
+   InputError if p is not real or if name or a variable of p is not a valid
+   C++ identifier. */
+  void Emit(std::ostream &s, const std::string &name, const Program &p) const;
+
+private:
+  bool temps;
+};
+
+} // namespace Equation
+
+#endif /* CppEmitter_hpp */
@@ -1,3 +1,7 @@
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
 #include "Derivative.hpp"
 
 #include "Error.h"
@@ -5,193 +9,532 @@
 #include "Function.hpp"
 #include "Node.hpp"
 #include "Number.hpp"
-#include "Parser.hpp"
 #include "Power.hpp"
+#include "Series.hpp"
 #include "Summand.hpp"
 #include "UnaryMinus.hpp"
 #include "Variable.hpp"
 
 namespace Equation {
 
-Derivative::Derivative() {
-  Parser parser;
-  functions["sin"] = parser.Parse("cos(x_)");
-  functions["cos"] = parser.Parse("-sin(x_)");
-  functions["tan"] = parser.Parse("1/(cos(x_))^2");
-  functions["exp"] = parser.Parse("exp(x_)");
-  functions["log"] = parser.Parse("1/x_");
-  functions["asin"] = parser.Parse("1/(1-x_^2)^(1/2)");
-  functions["acos"] = parser.Parse("-1/(1-x_^2)^(1/2)");
-  functions["atan"] = parser.Parse("1/(1+x_^2)");
-  functions["sinh"] = parser.Parse("cosh(x_)");
-  functions["cosh"] = parser.Parse("sinh(x_)");
-  functions["tanh"] = parser.Parse("1/(cosh(x_))^2");
+namespace {
+
+NodePtr number(long num, long denom = 1l) {
+  return new_node<Number>(NumberRepr(num, denom));
 }
 
-NodePtr Derivative::Eval(const std::list<NodePtr> &args, bool numeric) {
-  if (args.size() != 2) {
-    throw InputError(0, "expected two arguments for function 'D'.");
-  }
-  auto it = args.begin();
-  auto func = *it;
-  std::advance(it, 1);
-  auto var = *it;
+NodePtr function(const std::string &name, const NodePtr &u) {
+  auto f = new_node<Function>(name);
+  f->AddArg(u);
+  return f;
+}
 
-  if (var->Type() != Node::Type_t::Variable) {
-    throw InputError(0, "expected variable as 2nd argument of 'D'");
-  }
+NodePtr power(const NodePtr &base, const NodePtr &exponent) {
+  return new_node<Power>(base, exponent);
+}
+
+NodePtr product(const NodePtr &a, const NodePtr &b) {
+  auto f = new_node<Factor>(a);
+  f->AddOp1(b);
+  return f;
+}
+
+NodePtr sum(const NodePtr &a, const NodePtr &b) {
+  auto s = new_node<Summand>(a);
+  s->AddOp1(b);
+  return s;
+}
+
+NodePtr minus(const NodePtr &a) { return new_node<UnaryMinus>(a); }
+
+/** Rule returns the derivative f'(u) of a function f. The argument u is a
+ new node which is used only once. */
+typedef NodePtr (*Rule)(const NodePtr &u);
+
+const std::unordered_map<std::string, Rule> &rules() {
+  static const std::unordered_map<std::string, Rule> r = {
+      {"sin", [](const NodePtr &u) { return function("cos", u); }},
+      {"cos", [](const NodePtr &u) { return minus(function("sin", u)); }},
+      {"tan",
+       [](const NodePtr &u) { return power(function("cos", u), number(-2)); }},
+      {"exp", [](const NodePtr &u) { return function("exp", u); }},
+      {"log", [](const NodePtr &u) { return power(u, number(-1)); }},
+      {"sqrt",
+       [](const NodePtr &u) {
+         return product(number(1, 2), power(u, number(-1, 2)));
+       }},
+      {"asin",
+       [](const NodePtr &u) {
+         return power(sum(number(1), minus(power(u, number(2)))),
+                      number(-1, 2));
+       }},
+      {"acos",
+       [](const NodePtr &u) {
+         return minus(power(sum(number(1), minus(power(u, number(2)))),
+                            number(-1, 2)));
+       }},
+      {"atan",
+       [](const NodePtr &u) {
+         return power(sum(number(1), power(u, number(2))), number(-1));
+       }},
+      {"sinh", [](const NodePtr &u) { return function("cosh", u); }},
+      {"cosh", [](const NodePtr &u) { return function("sinh", u); }},
+      {"tanh",
+       [](const NodePtr &u) {
+         return power(function("cosh", u), number(-2));
+       }},
+      {"arsinh",
+       [](const NodePtr &u) {
+         return power(sum(power(u, number(2)), number(1)), number(-1, 2));
+       }},
+      {"arcosh",
+       [](const NodePtr &u) {
+         return power(sum(power(u, number(2)), number(-1)), number(-1, 2));
+       }},
+      {"artanh",
+       [](const NodePtr &u) {
+         return power(sum(number(1), minus(power(u, number(2)))), number(-1));
+       }},
+  };
+  return r;
+}
 
-  if (func->Type() == Node::Type_t::Number) {
-    return Dnumber(std::static_pointer_cast<Number>(func));
+Rule find_rule(const FunctionPtr &f) {
+  if (f->Args().size() != 1) {
+    return nullptr;
   }
-  auto varname = std::static_pointer_cast<Variable>(var)->Name();
-  if (func->Type() == Node::Type_t::Variable) {
-    return Dvariable(std::static_pointer_cast<Variable>(func), varname);
+  auto it = rules().find(f->Name());
+  if (it == rules().end()) {
+    return nullptr;
   }
+  return it->second;
+}
 
-  if (func->Type() == Node::Type_t::Summand) {
-    return Dsum(std::static_pointer_cast<Summand>(func), varname);
+/** Differentiator differentiates a tree with respect to one variable.
+
+ The derivative is built from the tree directly and is not evaluated, i.e.
+ the caller evaluates the result once. Subtrees which do not depend on the
+ variable have the derivative 0, which is represented by an empty pointer so
+ that these terms are dropped early. Derivatives of equal subtrees are
+ computed only once. */
+class Differentiator {
+public:
+  /** Products with at least wide_product factors which depend on the
+   variable are differentiated by splitting them in halves (see
+   splitProduct). */
+  static const size_t wide_product = 8;
+
+  explicit Differentiator(const std::string &variable) : var(variable) {}
+
+  /** D returns the derivative of n or an empty pointer if it is 0. */
+  NodePtr D(const NodePtr &n) {
+    if (!depends(n)) {
+      return 0;
+    }
+    auto range = memo.equal_range(n->Hash());
+    for (auto it = range.first; it != range.second; ++it) {
+      if (it->second.first->equals(n)) {
+        // the first copy is already part of the result tree.
+        return it->second.second->clone();
+      }
+    }
+    auto result = d(n);
+    memo.insert(std::make_pair(n->Hash(), std::make_pair(n, result)));
+    return result;
   }
 
-  if (func->Type() == Node::Type_t::Power) {
-    return Dpower(std::static_pointer_cast<Power>(func), varname);
+private:
+  /** depends returns true if n depends on the variable. */
+  bool depends(const NodePtr &n) {
+    auto it = dependency.find(n.get());
+    if (it != dependency.end()) {
+      return it->second;
+    }
+    bool result = false;
+    switch (n->Type()) {
+    case Node::Type_t::Number:
+      break;
+    case Node::Type_t::Variable:
+      result = std::static_pointer_cast<Variable>(n)->Name() == var;
+      break;
+    case Node::Type_t::Summand:
+    case Node::Type_t::Factor:
+      for (const auto &e : std::static_pointer_cast<TwoOp>(n)->Data()) {
+        if (depends(e)) {
+          result = true;
+          break;
+        }
+      }
+      break;
+    case Node::Type_t::UnaryMinus:
+      result = depends(std::static_pointer_cast<UnaryMinus>(n)->Data());
+      break;
+    case Node::Type_t::Power: {
+      auto p = std::static_pointer_cast<Power>(n);
+      result = depends(p->Base()) || depends(p->Exponent());
+      break;
+    }
+    case Node::Type_t::Function:
+      for (const auto &e : std::static_pointer_cast<Function>(n)->Args()) {
+        if (depends(e)) {
+          result = true;
+          break;
+        }
+      }
+      break;
+    }
+    dependency[n.get()] = result;
+    return result;
   }
 
-  if (func->Type() == Node::Type_t::UnaryMinus) {
-    return Dminus(std::static_pointer_cast<UnaryMinus>(func), varname);
+  NodePtr d(const NodePtr &n) {
+    switch (n->Type()) {
+    case Node::Type_t::Number:
+      return 0;
+    case Node::Type_t::Variable:
+      return number(1);
+    case Node::Type_t::Summand:
+      return dsum(std::static_pointer_cast<Summand>(n));
+    case Node::Type_t::Factor:
+      return dmul(std::static_pointer_cast<Factor>(n));
+    case Node::Type_t::UnaryMinus: {
+      auto u = D(std::static_pointer_cast<UnaryMinus>(n)->Data());
+      return u ? minus(u) : 0;
+    }
+    case Node::Type_t::Power:
+      return dpower(std::static_pointer_cast<Power>(n));
+    case Node::Type_t::Function:
+      return dfunc(std::static_pointer_cast<Function>(n));
+    }
+    return 0;
   }
 
-  if (func->Type() == Node::Type_t::Factor) {
-    return Dmul(std::static_pointer_cast<Factor>(func), varname);
+  NodePtr dsum(const SummandPtr &v) {
+    auto s = new_node<Summand>();
+    for (const auto &e : v->Data()) {
+      auto de = D(e);
+      if (de) {
+        s->AddOp1(de);
+      }
+    }
+    return s->Data().size() == 0 ? 0 : s;
   }
 
-  if (func->Type() == Node::Type_t::Function) {
-    return Dfunc(std::static_pointer_cast<Function>(func), varname);
+  /** dmul differentiates a product. Constant factors are pulled out and
+   only the other factors are differentiated. */
+  NodePtr dmul(const FactorPtr &v) {
+    NodeList constant, dependent;
+    for (const auto &e : v->Data()) {
+      (depends(e) ? dependent : constant).push_back(e);
+    }
+    NodePtr d;
+    if (dependent.size() == 1) {
+      d = D(dependent[0]);
+    } else if (dependent.size() < wide_product) {
+      d = productRule(dependent);
+    } else {
+      d = splitProduct(dependent, 0, dependent.size());
+    }
+    if (!d || constant.size() == 0) {
+      return d;
+    }
+    auto f = new_node<Factor>();
+    for (const auto &c : constant) {
+      f->AddOp1(c->clone());
+    }
+    f->AddOp1(d);
+    return f;
   }
 
-  return 0;
-}
-
-NodePtr Derivative::Dnumber(const NumberPtr &nb) {
-  return std::make_shared<Number>(0l);
-}
+  /** productRule returns the sum of the products of ops where one factor
+   is replaced by its derivative. The size of the result grows
+   quadratically with the number of factors. */
+  NodePtr productRule(const NodeList &ops) {
+    auto s = new_node<Summand>();
+    for (size_t i = 0; i < ops.size(); i++) {
+      auto di = D(ops[i]);
+      if (!di) {
+        continue;
+      }
+      auto term = new_node<Factor>();
+      for (size_t j = 0; j < ops.size(); j++) {
+        if (j != i) {
+          term->AddOp1(ops[j]->clone());
+        }
+      }
+      term->AddOp1(di);
+      s->AddOp1(term);
+    }
+    return s->Data().size() == 0 ? 0 : s;
+  }
 
-NodePtr Derivative::Dvariable(const VariablePtr &v, const std::string &var) {
-  if (v->Name() == var) {
-    return std::make_shared<Number>(1l);
+  /** splitProduct returns the derivative of the product of ops[begin, end)
+   by the product rule for its two halves L and R, L'*R + L*R'. The partial
+   products L and R are shared by all terms of the derivative of the other
+   half, so every factor is cloned once per level and the size grows as
+   n log n. Unlike p * (f1'/f1 + ...), no factor is divided by, so the
+   result is defined where a factor is zero. */
+  NodePtr splitProduct(const NodeList &ops, size_t begin, size_t end) {
+    if (end - begin == 1) {
+      return D(ops[begin]);
+    }
+    auto mid = (begin + end) / 2;
+    auto dl = splitProduct(ops, begin, mid);
+    auto dr = splitProduct(ops, mid, end);
+    auto s = new_node<Summand>();
+    if (dl) {
+      auto term = new_node<Factor>(dl);
+      for (size_t j = mid; j < end; j++) {
+        term->AddOp1(ops[j]->clone());
+      }
+      s->AddOp1(term);
+    }
+    if (dr) {
+      auto term = new_node<Factor>();
+      for (size_t j = begin; j < mid; j++) {
+        term->AddOp1(ops[j]->clone());
+      }
+      term->AddOp1(dr);
+      s->AddOp1(term);
+    }
+    if (s->Data().size() == 0) {
+      return 0;
+    }
+    return s->Data().size() == 1 ? s->Data().front() : s;
   }
-  return std::make_shared<Number>(0l);
-}
 
-NodePtr Derivative::Dsum(const SummandPtr &v, const std::string &var) {
-  auto newsum = std::make_shared<Summand>();
+  /** dpower differentiates b^e. */
+  NodePtr dpower(const PowerPtr &v) {
+    auto b = v->Base();
+    auto e = v->Exponent();
+    auto db = D(b);
+    auto de = D(e);
+    if (!de) {
+      // e * b^(e-1) * b'
+      auto f = new_node<Factor>(e->clone());
+      f->AddOp1(power(b->clone(), sum(e->clone(), number(-1))));
+      f->AddOp1(db);
+      return f;
+    }
+    if (!db) {
+      // b^e * log(b) * e'
+      auto f = new_node<Factor>(v->clone());
+      f->AddOp1(function("log", b->clone()));
+      f->AddOp1(de);
+      return f;
+    }
+    // b^(e-1) * (e * b' + b * log(b) * e')
+    auto f = new_node<Factor>(power(b->clone(), sum(e->clone(), number(-1))));
+    auto t = new_node<Factor>(b->clone());
+    t->AddOp1(function("log", b->clone()));
+    t->AddOp1(de);
+    f->AddOp1(sum(product(e->clone(), db), t));
+    return f;
+  }
 
-  for (const auto &s : v->Data()) {
-    std::list<NodePtr> args;
-    args.push_back(s);
-    args.push_back(std::make_shared<Variable>(var));
-    NodePtr D = std::make_shared<Function>("D", args);
-    newsum->Data().push_back(D);
+  /** dfunc applies the chain rule. Functions without a rule stay as
+   D(f(...), var). */
+  NodePtr dfunc(const FunctionPtr &v) {
+    auto rule = find_rule(v);
+    if (!rule) {
+      auto d = new_node<Function>("D");
+      d->AddArg(v->clone());
+      d->AddArg(new_node<Variable>(var));
+      return d;
+    }
+    const auto &u = v->Args()[0];
+    auto du = D(u);
+    if (!du) {
+      return 0;
+    }
+    return product(rule(u->clone()), du);
   }
 
-  NodePtr result = std::static_pointer_cast<Node>(newsum);
+  std::string var;
+  std::unordered_map<const Node *, bool> dependency;
+  std::unordered_multimap<std::size_t, std::pair<NodePtr, NodePtr>> memo;
+};
+
+/** differentiate returns the evaluated derivative of f. The derivative is
+ copied before the evaluation, because the memo of d refers to it. */
+NodePtr differentiate(Differentiator &d, const NodePtr &f) {
+  auto result = d.D(f);
+  if (!result) {
+    return new_node<Number>(0l);
+  }
+  result = result->clone();
   result->Eval(&result, std::make_shared<DefaultState>());
   return result;
 }
 
-NodePtr Derivative::Dpower(const PowerPtr &v, const std::string &var) {
-  auto root = std::make_shared<Factor>();
+/** differentiators returns a Differentiator for each of the variables
+ args[1], args[2], .... */
+std::vector<std::unique_ptr<Differentiator>>
+differentiators(const NodeList &args, const std::string &fname) {
+  if (args.size() < 2) {
+    throw InputError(0, "expected a function and at least one variable for '" +
+                            fname + "'");
+  }
+  std::vector<std::unique_ptr<Differentiator>> d;
+  for (size_t i = 1; i < args.size(); i++) {
+    if (args[i]->Type() != Node::Type_t::Variable) {
+      throw InputError(0, "expected variables as arguments of '" + fname +
+                              "'");
+    }
+    auto name = std::static_pointer_cast<Variable>(args[i])->Name();
+    d.emplace_back(new Differentiator(name));
+  }
+  return d;
+}
 
-  auto sum1 = std::make_shared<Summand>(v->Exponent()->clone());
-  sum1->AddOp1(std::make_shared<Number>(-1l));
-  auto p1 = std::make_shared<Power>(v->Base()->clone(), sum1);
+/** is_vector returns true if n is a vector(...) node. */
+bool is_vector(const NodePtr &n) {
+  return n->Type() == Node::Type_t::Function &&
+         std::static_pointer_cast<Function>(n)->Name() == "vector";
+}
 
-  root->AddOp1(p1);
+FunctionPtr make_vector() { return new_node<Function>("vector"); }
 
-  auto mul1 = std::make_shared<Factor>();
-  mul1->AddOp1(v->Exponent()->clone());
-  std::list<NodePtr> args1 = {
-      {v->Base()->clone(), std::make_shared<Variable>(var)}};
-  mul1->AddOp1(std::make_shared<Function>("D", args1));
+/** order returns the non-negative integer n or throws an InputError. */
+std::size_t order(const NodePtr &n, const std::string &fname) {
+  if (n->Type() == Node::Type_t::Number) {
+    auto v = std::static_pointer_cast<Number>(n)->GetValue();
+    if (v.IsValid() && v.IsFraction() && v.Denominator() == 1 &&
+        v.Numerator() >= 0 && v.Numerator() <= 1000) {
+      return v.Numerator().convert_to<std::size_t>();
+    }
+  }
+  throw InputError(0, "expected a non-negative integer as order of '" + fname +
+                          "'");
+}
+
+/** variable_name returns the name of the variable n or throws an
+ InputError. */
+std::string variable_name(const NodePtr &n, const std::string &fname) {
+  if (n->Type() != Node::Type_t::Variable) {
+    throw InputError(0, "expected variable as 2nd argument of '" + fname +
+                            "'");
+  }
+  return std::static_pointer_cast<Variable>(n)->Name();
+}
 
-  auto mul2 = std::make_shared<Factor>();
-  mul2->AddOp1(v->Base()->clone());
-  std::list<NodePtr> args2 = {
-      {v->Exponent()->clone(), std::make_shared<Variable>(var)}};
-  mul2->AddOp1(std::make_shared<Function>("D", args2));
-  std::list<NodePtr> args3 = {
-      {v->Base()->clone(), std::make_shared<Variable>(var)}};
-  mul2->AddOp1(std::make_shared<Function>("D", args3));
+} // namespace
 
-  auto sum2 = std::make_shared<Summand>();
-  sum2->AddOp1(mul1);
-  sum2->AddOp1(mul2);
+NodePtr Derivative::Eval(const NodeList &args, bool numeric) {
+  if (args.size() != 2 && args.size() != 3) {
+    throw InputError(0, "expected two or three arguments for function 'D'.");
+  }
+  const auto &func = args[0];
+  auto varname = variable_name(args[1], "D");
+  std::size_t n = args.size() == 3 ? order(args[2], "D") : 1;
+  if (n == 0) {
+    return func->clone();
+  }
 
-  root->AddOp1(sum2);
+  // D(f(x), x) of an unknown function f stays as it is.
+  if (func->Type() == Node::Type_t::Function &&
+      !find_rule(std::static_pointer_cast<Function>(func))) {
+    return 0;
+  }
+
+  if (n > 1) {
+    // Higher derivatives come from the Taylor coefficients at x itself; if
+    // f cannot be expanded, D(f, x, n) stays as it is.
+    try {
+      return Series::Expand(func, varname, new_node<Variable>(varname), n)
+          .Derivative(n);
+    } catch (InputError &) {
+      return 0;
+    }
+  }
 
-  NodePtr result = std::static_pointer_cast<Node>(root);
+  Differentiator diff(varname);
+  auto result = diff.D(func);
+  if (!result) {
+    return new_node<Number>(0l);
+  }
   result->Eval(&result, std::make_shared<DefaultState>());
   return result;
 }
 
-NodePtr Derivative::Dminus(const UnaryMinusPtr &v, const std::string &var) {
-  std::list<NodePtr> args = {v->Data(), std::make_shared<Variable>(var)};
-  NodePtr result =
-      std::make_shared<UnaryMinus>(std::make_shared<Function>("D", args));
-  result->Eval(&result, std::make_shared<DefaultState>());
-  return result;
+NodePtr FuncGrad::Eval(const NodeList &args, bool numeric) {
+  auto d = differentiators(args, "grad");
+  auto v = make_vector();
+  for (auto &di : d) {
+    v->AddArg(differentiate(*di, args[0]));
+  }
+  return v;
 }
 
-NodePtr Derivative::Dmul(const FactorPtr &v, const std::string &var) {
-  auto sum = std::make_shared<Summand>();
-  for (size_t i = 0; i < v->Data().size(); i++) {
-    auto mul = std::make_shared<Factor>();
-    for (size_t j = 0; j < v->Data().size(); j++) {
-      auto t = v->Data().begin();
-      std::advance(t, j);
-      if (j != i) {
-        mul->AddOp1((*t)->clone());
-      } else {
-        std::list<NodePtr> args = {(*t)->clone(),
-                                   std::make_shared<Variable>(var)};
-        mul->AddOp1(std::make_shared<Function>("D", args));
-      }
+NodePtr FuncJacobian::Eval(const NodeList &args, bool numeric) {
+  auto d = differentiators(args, "jacobian");
+  NodeList funcs;
+  if (is_vector(args[0])) {
+    funcs = std::static_pointer_cast<Function>(args[0])->Args();
+  } else {
+    funcs.push_back(args[0]);
+  }
+  // the differentiators are shared by all rows, so common subexpressions of
+  // the functions are differentiated once.
+  auto m = new_node<Function>("matrix");
+  for (const auto &f : funcs) {
+    auto row = make_vector();
+    for (auto &di : d) {
+      row->AddArg(differentiate(*di, f));
     }
-    sum->AddOp1(mul);
+    m->AddArg(row);
   }
-  NodePtr result = std::static_pointer_cast<Node>(sum);
-  result->Eval(&result, std::make_shared<DefaultState>());
-  return result;
+  return m;
 }
 
-NodePtr Derivative::Dfunc(const FunctionPtr &v, const std::string &var) {
-  auto it = functions.find(v->Name());
-  if (it == functions.end()) {
-    return 0;
+NodePtr FuncHessian::Eval(const NodeList &args, bool numeric) {
+  auto d = differentiators(args, "hessian");
+  auto n = d.size();
+  NodeList first;
+  for (auto &di : d) {
+    first.push_back(differentiate(*di, args[0]));
+  }
+  // only the upper triangle is computed, the matrix is symmetric.
+  std::vector<std::vector<NodePtr>> h(n, std::vector<NodePtr>(n));
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = i; j < n; j++) {
+      h[i][j] = differentiate(*d[j], first[i]);
+    }
   }
+  auto m = new_node<Function>("matrix");
+  for (size_t i = 0; i < n; i++) {
+    auto row = make_vector();
+    for (size_t j = 0; j < n; j++) {
+      row->AddArg(j < i ? h[j][i]->clone() : h[i][j]);
+    }
+    m->AddArg(row);
+  }
+  return m;
+}
 
-  auto factor = std::make_shared<Factor>();
-  if (v->Args().size() != 1) {
+NodePtr FuncTaylor::Eval(const NodeList &args, bool numeric) {
+  if (args.size() != 4) {
+    throw InputError(0, "expected four arguments for function 'taylor'.");
+  }
+  auto varname = variable_name(args[1], "taylor");
+  auto n = order(args[3], "taylor");
+  const auto &x0 = args[2];
+
+  Series series;
+  try {
+    series = Series::Expand(args[0], varname, x0, n);
+  } catch (InputError &) {
     return 0;
   }
-  auto arg = v->Args().begin();
-
-  auto state = std::make_shared<DefaultState>();
-  state->SetVariable("x_", (*arg)->clone());
-
-  Parser parser;
-  // auto outer = parser.Parse("cos(x_)");
-  auto outer = it->second->clone();
-  factor->AddOp1(outer);
-
-  std::list<NodePtr> args = {*arg, std::make_shared<Variable>(var)};
-  auto inner = std::make_shared<Function>("D", args);
-
-  factor->AddOp1(inner);
-
-  NodePtr result = std::static_pointer_cast<Node>(factor);
-  result->Eval(&result, state);
-  return result;
+  // h = x - x0
+  NodePtr h = new_node<Variable>(varname);
+  bool at_zero = x0->Type() == Node::Type_t::Number &&
+                 std::static_pointer_cast<Number>(x0)->GetValue() ==
+                     NumberRepr(0l);
+  if (!at_zero) {
+    h = sum(h, minus(x0->clone()));
+  }
+  return series.Polynomial(h);
 }
 
 } // namespace Equation
@@ -5,7 +5,6 @@
 #ifndef Derivative_hpp
 #define Derivative_hpp
 
-#include <map>
 #include <string>
 #include <vector>
 
@@ -33,29 +32,82 @@ typedef std::shared_ptr<Factor> FactorPtr;
 class Function;
 typedef std::shared_ptr<Function> FunctionPtr;
 
+/** Derivative is the function D(f, x) which returns the derivative of f with
+ respect to the variable x. D(f, x, n) returns the n-th derivative; for n > 1
+ it is computed from the Taylor series of f (see Series). */
 class Derivative : public UserFunction {
 public:
-  Derivative();
-  virtual size_t NumArgs() const { return 2; }
-  virtual NodePtr Eval(const std::list<NodePtr> &args, bool numeric = false);
+  virtual size_t NumArgs() const { return 0; }
+  virtual NodePtr Eval(const NodeList &args, bool numeric = false);
 
   virtual NodePtr EvalNum(const std::vector<std::complex<NumberRepr>> &args) {
     return 0;
   }
-  virtual bool SpecialValues(const std::list<NodePtr> &args, NodePtr *result) {
+  virtual bool SpecialValues(const NodeList &args, NodePtr *result) {
     return false;
   }
+};
+
+/** FuncGrad is the function grad(f, x, y, ...) which returns the gradient
+ vector(D(f, x), D(f, y), ...). */
+class FuncGrad : public UserFunction {
+public:
+  virtual size_t NumArgs() const { return 0; }
+  virtual NodePtr Eval(const NodeList &args, bool numeric = false);
+
+  virtual NodePtr EvalNum(const std::vector<std::complex<NumberRepr>> &args) {
+    return 0;
+  }
+  virtual bool SpecialValues(const NodeList &args, NodePtr *result) {
+    return false;
+  }
+};
+
+/** FuncJacobian is the function jacobian(vector(f, g, ...), x, y, ...) which
+ returns the matrix(vector(D(f, x), D(f, y), ...), vector(D(g, x), ...), ...).
+ A single function f can be given instead of a vector. */
+class FuncJacobian : public UserFunction {
+public:
+  virtual size_t NumArgs() const { return 0; }
+  virtual NodePtr Eval(const NodeList &args, bool numeric = false);
+
+  virtual NodePtr EvalNum(const std::vector<std::complex<NumberRepr>> &args) {
+    return 0;
+  }
+  virtual bool SpecialValues(const NodeList &args, NodePtr *result) {
+    return false;
+  }
+};
 
-private:
-  NodePtr Dnumber(const NumberPtr &nb);
-  NodePtr Dvariable(const VariablePtr &v, const std::string &var);
-  NodePtr Dsum(const SummandPtr &v, const std::string &var);
-  NodePtr Dpower(const PowerPtr &v, const std::string &var);
-  NodePtr Dminus(const UnaryMinusPtr &v, const std::string &var);
-  NodePtr Dmul(const FactorPtr &v, const std::string &var);
-  NodePtr Dfunc(const FunctionPtr &v, const std::string &var);
+/** FuncHessian is the function hessian(f, x, y, ...) which returns the
+ matrix of the second derivatives of f. Each entry of the upper triangle is
+ computed once and mirrored. */
+class FuncHessian : public UserFunction {
+public:
+  virtual size_t NumArgs() const { return 0; }
+  virtual NodePtr Eval(const NodeList &args, bool numeric = false);
 
-  std::map<std::string, NodePtr> functions;
+  virtual NodePtr EvalNum(const std::vector<std::complex<NumberRepr>> &args) {
+    return 0;
+  }
+  virtual bool SpecialValues(const NodeList &args, NodePtr *result) {
+    return false;
+  }
+};
+
+/** FuncTaylor is the function taylor(f, x, x0, n) which returns the Taylor
+ polynomial of f of order n in x around x0. */
+class FuncTaylor : public UserFunction {
+public:
+  virtual size_t NumArgs() const { return 4; }
+  virtual NodePtr Eval(const NodeList &args, bool numeric = false);
+
+  virtual NodePtr EvalNum(const std::vector<std::complex<NumberRepr>> &args) {
+    return 0;
+  }
+  virtual bool SpecialValues(const NodeList &args, NodePtr *result) {
+    return false;
+  }
 };
 
 } // namespace Equation
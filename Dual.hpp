@@ -0,0 +1,139 @@
+//
+//  Copyright © 2017 Lennart Oymanns. All rights reserved.
+//
+
+#ifndef Dual_hpp
+#define Dual_hpp
+
+#include <cmath>
+
+namespace Equation {
+
+/** Dual is a dual number value + derivative*e with e^2 = 0.
+
+ Evaluating a function with dual numbers yields the value of the function
+ and its derivative in the direction of the derivative parts of the inputs
+ (forward-mode automatic differentiation). */
+struct Dual {
+  Dual() = default;
+  Dual(double v, double d = 0.0) : value(v), derivative(d) {}
+
+  Dual &operator+=(const Dual &o) {
+    value += o.value;
+    derivative += o.derivative;
+    return *this;
+  }
+
+  Dual &operator-=(const Dual &o) {
+    value -= o.value;
+    derivative -= o.derivative;
+    return *this;
+  }
+
+  Dual &operator*=(const Dual &o) {
+    derivative = derivative * o.value + value * o.derivative;
+    value *= o.value;
+    return *this;
+  }
+
+  Dual &operator/=(const Dual &o) {
+    value /= o.value;
+    derivative = (derivative - value * o.derivative) / o.value;
+    return *this;
+  }
+
+  double value = 0.0;
+  double derivative = 0.0;
+};
+
+inline Dual operator+(Dual a, const Dual &b) { return a += b; }
+inline Dual operator-(Dual a, const Dual &b) { return a -= b; }
+inline Dual operator*(Dual a, const Dual &b) { return a *= b; }
+inline Dual operator/(Dual a, const Dual &b) { return a /= b; }
+inline Dual operator-(const Dual &a) { return Dual(-a.value, -a.derivative); }
+
+/** chain returns f(a) for the value fa = f(a.value) and the derivative
+ dfa = f'(a.value). */
+inline Dual chain(const Dual &a, double fa, double dfa) {
+  return Dual(fa, dfa * a.derivative);
+}
+
+inline Dual sqrt(const Dual &a) {
+  double r = std::sqrt(a.value);
+  return chain(a, r, 0.5 / r);
+}
+
+inline Dual exp(const Dual &a) {
+  double r = std::exp(a.value);
+  return chain(a, r, r);
+}
+
+inline Dual log(const Dual &a) {
+  return chain(a, std::log(a.value), 1 / a.value);
+}
+
+inline Dual pow(const Dual &a, const Dual &b) {
+  double r = std::pow(a.value, b.value);
+  double d = 0.0;
+  if (a.derivative != 0.0) {
+    d += b.value * std::pow(a.value, b.value - 1) * a.derivative;
+  }
+  if (b.derivative != 0.0 && r != 0.0) {
+    d += r * std::log(a.value) * b.derivative;
+  }
+  return Dual(r, d);
+}
+
+inline Dual sin(const Dual &a) {
+  return chain(a, std::sin(a.value), std::cos(a.value));
+}
+
+inline Dual cos(const Dual &a) {
+  return chain(a, std::cos(a.value), -std::sin(a.value));
+}
+
+inline Dual tan(const Dual &a) {
+  double r = std::tan(a.value);
+  return chain(a, r, 1 + r * r);
+}
+
+inline Dual asin(const Dual &a) {
+  return chain(a, std::asin(a.value), 1 / std::sqrt(1 - a.value * a.value));
+}
+
+inline Dual acos(const Dual &a) {
+  return chain(a, std::acos(a.value), -1 / std::sqrt(1 - a.value * a.value));
+}
+
+inline Dual atan(const Dual &a) {
+  return chain(a, std::atan(a.value), 1 / (1 + a.value * a.value));
+}
+
+inline Dual sinh(const Dual &a) {
+  return chain(a, std::sinh(a.value), std::cosh(a.value));
+}
+
+inline Dual cosh(const Dual &a) {
+  return chain(a, std::cosh(a.value), std::sinh(a.value));
+}
+
+inline Dual tanh(const Dual &a) {
+  double r = std::tanh(a.value);
+  return chain(a, r, 1 - r * r);
+}
+
+inline Dual asinh(const Dual &a) {
+  return chain(a, std::asinh(a.value), 1 / std::sqrt(a.value * a.value + 1));
+}
+
+inline Dual acosh(const Dual &a) {
+  return chain(a, std::acosh(a.value), 1 / std::sqrt(a.value * a.value - 1));
+}
+
+inline Dual atanh(const Dual &a) {
+  return chain(a, std::atanh(a.value), 1 / (1 - a.value * a.value));
+}
+
+} // namespace Equation
+
+#endif /* Dual_hpp */
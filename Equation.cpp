@@ -4,11 +4,16 @@
 
 #include "Equation.hpp"
 #include "Error.h"
+#include "LimbPool.hpp"
 #include "Parser.hpp"
 
 namespace Equation {
 
 bool Equation::Set(const std::string &eq, std::ostream &errorstream) {
+  equation.reset();
+  arena = NodeArenaPtr(new NodeArena);
+  NodeArena::Scope scope(arena);
+
   Parser parser;
   try {
     auto node = parser.Parse(eq);
@@ -30,9 +35,22 @@ std::string Equation::Evaluate(bool numeric, std::shared_ptr<State> state) {
   if (!equation) {
     return "";
   }
+  NodeArena::Scope scope(arena);
   equation->Eval(&equation, state, numeric);
 
-  return equation->ToString();
+  auto result = equation->ToString();
+  if (releaseNumberPool) {
+    LimbPool::Release();
+  }
+  return result;
+}
+
+Program Equation::Compile(const std::vector<std::string> &variables,
+                          std::shared_ptr<State> state) const {
+  if (!equation) {
+    throw InputError(0, "empty equation");
+  }
+  return Program::Compile(equation, variables, state);
 }
 
 void Equation::WriteInternalRepToStream(std::ostream &s) {
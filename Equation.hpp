@@ -8,6 +8,8 @@
 #include <iostream>
 #include <memory>
 
+#include "NodeArena.hpp"
+#include "Program.hpp"
 #include "State.hpp"
 
 namespace Equation {
@@ -16,6 +18,11 @@ class Node;
 
 typedef std::shared_ptr<Node> NodePtr;
 
+/** Equation is a parsed expression.
+
+ All nodes of an Equation are allocated from a NodeArena owned by the
+ Equation. Set() starts a new arena; the previous arena is deleted as soon as
+ none of its nodes is referenced any more. */
 class Equation {
 public:
   bool Set(const std::string &eq, std::ostream &errorstream = std::cerr);
@@ -24,6 +31,12 @@ public:
   Evaluate(bool numeric = false,
            std::shared_ptr<State> state = std::make_shared<DefaultState>());
 
+  /** Compile compiles the equation for fast numerical evaluation (see
+   Program::Compile). The equation should be evaluated first. */
+  Program
+  Compile(const std::vector<std::string> &variables = {},
+          std::shared_ptr<State> state = std::make_shared<DefaultState>()) const;
+
   std::string ToString() const;
 
   std::string ToLatex() const;
@@ -32,8 +45,18 @@ public:
 
   bool operator==(const Equation &e) const;
 
+  /** SetReleaseNumberPool determines if Evaluate releases the limb buffers
+   which are cached by the LimbPool of the calling thread after the
+   evaluation. This bounds the memory of long running threads at the cost of
+   new allocations in the next evaluation. */
+  void SetReleaseNumberPool(bool release) { releaseNumberPool = release; }
+
 private:
+  // the arena has to be declared before the equation so that the nodes are
+  // destroyed first.
+  NodeArenaPtr arena;
   NodePtr equation;
+  bool releaseNumberPool = false;
 };
 } // namespace Equation
 
@@ -1,19 +1,24 @@
 //
 //  Copyright © 2017 Lennart Oymanns. All rights reserved.
 //
+#include <algorithm>
 #include <cassert>
+#include <unordered_map>
+#include <vector>
 
 #include "ComplexNumber.hpp"
 #include "Factor.hpp"
 #include "Number.hpp"
+#include "Polynomial.hpp"
 #include "Power.hpp"
 #include "Summand.hpp"
+#include "Variable.hpp"
 
 using namespace Equation;
 
 namespace {
 
-bool comparator(NodePtr &first, NodePtr &second) {
+bool comparator(const NodePtr &first, const NodePtr &second) {
   if (first->Type() == Node::Type_t::Number) {
     if (second->Type() == Node::Type_t::Number) {
       auto f = std::static_pointer_cast<Number>(first)->GetValue();
@@ -67,62 +72,251 @@ void Factor::ToStream(std::ostream &s) {
   }
 }
 
-void Factor::simplify(std::list<NodePtr> &op, std::shared_ptr<State> state) {
-  for (auto it = op.begin(); it != op.end();) {
-    auto it2 = it;
-    it2++;
-    std::shared_ptr<Node> base;
-    NodePtr exponent = std::make_shared<Summand>(std::make_shared<Number>(0l));
-    if ((*it)->Type() == Node::Type_t::Power) {
-      auto a = std::static_pointer_cast<Power>(*it);
+namespace {
+
+/** PowerGroup collects all factors with the same base. Numerical exponents
+ are summed up directly, all other exponents are collected in a sum. */
+struct PowerGroup {
+  NodePtr base;
+  NumberRepr number;
+  std::shared_ptr<Summand> exponent;
+};
+
+} // namespace
+
+/** simplify merges factors with the same base, e.g. x^2*y*x^a = x^(2+a)*y.
+
+ Factors are grouped by the hash of their base, so the merge is linear in the
+ number of factors. The order of the factors is the order of the first
+ occurrence of their base. */
+void Factor::simplify(NodeList &op, std::shared_ptr<State> state) {
+  std::vector<PowerGroup> groups;
+  groups.reserve(op.size());
+  std::unordered_multimap<std::size_t, std::size_t> index;
+  index.reserve(op.size());
+  for (auto &e : op) {
+    NodePtr base = e;
+    NodePtr exp;
+    if (e->Type() == Node::Type_t::Power) {
+      auto a = std::static_pointer_cast<Power>(e);
       base = a->Base();
-      auto e = std::static_pointer_cast<Summand>(exponent);
-      e->AddOp1(a->Exponent());
-    } else {
-      base = *it;
-      auto e = std::static_pointer_cast<Summand>(exponent);
-      e->AddOp1(std::make_shared<Number>(1l));
-    }
-    for (; it2 != op.end();) {
-      std::shared_ptr<Node> base2;
-      std::shared_ptr<Node> exp2;
-      if ((*it2)->Type() == Node::Type_t::Power) {
-        auto a = std::static_pointer_cast<Power>(*it2);
-        base2 = a->Base();
-        exp2 = a->Exponent();
-      } else {
-        base2 = *it2;
-        exp2 = std::make_shared<Number>(1l);
+      exp = a->Exponent();
+    }
+    auto h = base->Hash();
+    auto pos = groups.size();
+    auto range = index.equal_range(h);
+    for (auto it = range.first; it != range.second; it++) {
+      if (groups[it->second].base->equals(base)) {
+        pos = it->second;
+        break;
       }
-      if (base->equals(base2)) {
-        it2 = op.erase(it2);
-        auto e = std::static_pointer_cast<Summand>(exponent);
-        e->AddOp1(exp2);
-      } else {
-        it2++;
+    }
+    if (pos == groups.size()) {
+      index.emplace(h, groups.size());
+      groups.push_back(PowerGroup{base, NumberRepr(0l), nullptr});
+    }
+    auto &group = groups[pos];
+    if (!exp) {
+      group.number += NumberRepr(1l);
+    } else if (exp->Type() == Node::Type_t::Number) {
+      group.number += std::static_pointer_cast<Number>(exp)->GetValue();
+    } else {
+      if (!group.exponent) {
+        group.exponent = new_node<Summand>();
       }
+      group.exponent->AddOp1(exp);
     }
+  }
 
-    exponent->Eval(&exponent, state);
+  op.clear();
+  for (auto &g : groups) {
+    NodePtr exponent;
+    if (g.exponent) {
+      g.exponent->AddOp1(new_node<Number>(g.number));
+      exponent = g.exponent;
+      exponent->Eval(&exponent, state);
+    } else {
+      exponent = new_node<Number>(g.number);
+    }
     if (exponent->Type() == Node::Type_t::Number) {
       auto number = std::static_pointer_cast<Number>(exponent);
       if (number->GetValue() == NumberRepr(0l)) {
-        it = op.erase(it);
         continue;
       }
       if (number->GetValue() == NumberRepr(1l)) {
-        *it = base;
-        it++;
+        op.push_back(g.base);
         continue;
       }
     }
-    NodePtr n = std::make_shared<Power>(base, exponent);
+    NodePtr n = new_node<Power>(g.base, exponent);
     n->Eval(&n, state);
-    *it = n;
-    it++;
+    op.push_back(n);
+  }
+}
+
+namespace {
+
+/** max_cancel_terms is the largest number of terms of a sum whose common
+ factors with the other factors are cancelled by Factor::cancelPolynomial. */
+const std::size_t max_cancel_terms = 64;
+
+/** PolynomialFactor is a factor base^exponent whose base is a polynomial. */
+struct PolynomialFactor {
+  NodePtr base;
+  int exponent;
+  Polynomial p;
+};
+
+/** polynomial_factor sets base and exponent if n is a sum or a variable or
+ an integer power of one. */
+bool polynomial_factor(const NodePtr &n, NodePtr *base, int *exponent) {
+  *base = n;
+  *exponent = 1;
+  if (n->Type() == Node::Type_t::Power) {
+    auto p = std::static_pointer_cast<Power>(n);
+    if (p->Exponent()->Type() != Node::Type_t::Number) {
+      return false;
+    }
+    auto e = std::static_pointer_cast<Number>(p->Exponent())->GetValue();
+    if (!e.IsFraction() || e.Denominator() != 1 ||
+        abs(e.Numerator()) > Polynomial::MaxExponent) {
+      return false;
+    }
+    *base = p->Base();
+    *exponent = e.Numerator().convert_to<int>();
+  }
+  switch ((*base)->Type()) {
+  case Node::Type_t::Summand:
+    return std::static_pointer_cast<Summand>(*base)->Data().size() <=
+           max_cancel_terms;
+  case Node::Type_t::Variable:
+    return std::static_pointer_cast<Variable>(*base)->Name() != "i";
+  default:
+    return false;
   }
 }
 
+NodePtr power_node(const NodePtr &base, int exponent) {
+  if (exponent == 1) {
+    return base;
+  }
+  return new_node<Power>(base, new_node<Number>(long(exponent)));
+}
+
+} // namespace
+
+/** cancelPolynomial cancels the common factors of polynomials in the
+ numerator and the denominator, e.g. (x^2-1)*(x-1)^(-1) = x+1. Only sums of
+ monomials of variables with at most max_cancel_terms terms and variables
+ are considered, and at least one factor of each pair has to be a sum. The
+ factors are replaced by their quotients and the gcd; the caller evaluates
+ the product again. It returns true if a common factor was found. */
+bool Factor::cancelPolynomial() {
+  auto is_sum = [](const NodePtr &e) {
+    if (e->Type() == Node::Type_t::Power) {
+      return std::static_pointer_cast<Power>(e)->Base()->Type() ==
+             Node::Type_t::Summand;
+    }
+    return e->Type() == Node::Type_t::Summand;
+  };
+  if (std::none_of(op1.begin(), op1.end(), is_sum)) {
+    return false;
+  }
+
+  std::vector<PolynomialFactor> factors;
+  bool numerator = false, denominator = false;
+  bool numerator_sum = false, denominator_sum = false;
+  for (const auto &e : op1) {
+    NodePtr b;
+    int k;
+    if (!polynomial_factor(e, &b, &k)) {
+      continue;
+    }
+    bool sum = b->Type() == Node::Type_t::Summand;
+    if (k > 0) {
+      numerator = true;
+      numerator_sum = numerator_sum || sum;
+    } else {
+      denominator = true;
+      denominator_sum = denominator_sum || sum;
+    }
+    factors.push_back(PolynomialFactor{b, k, Polynomial()});
+  }
+  if (!(numerator_sum && denominator) && !(denominator_sum && numerator)) {
+    return false;
+  }
+
+  PolynomialRing ring;
+  for (const auto &f : factors) {
+    if (!ring.Add(f.base)) {
+      return false;
+    }
+  }
+  if (!ring.HasOnlyVariables()) {
+    return false;
+  }
+  std::vector<std::uint64_t> words(
+      Polynomial::Words(ring.Generators().size()));
+  NumberRepr c;
+  for (auto &f : factors) {
+    if (f.base->Type() == Node::Type_t::Summand) {
+      for (const auto &e : std::static_pointer_cast<Summand>(f.base)->Data()) {
+        // products of sums would have to be multiplied out.
+        if (!ring.Monomial(e, words.data(), &c)) {
+          return false;
+        }
+      }
+    }
+    f.p = ring.FromNode(f.base);
+  }
+
+  std::vector<PolynomialFactor> common;
+  for (auto &num : factors) {
+    for (auto &den : factors) {
+      if (num.exponent < 0 || den.exponent > 0 ||
+          (num.p.NumTerms() == 1 && den.p.NumTerms() == 1) ||
+          num.p.IsConstant() || den.p.IsConstant()) {
+        continue;
+      }
+      auto g = Polynomial::Gcd(num.p, den.p);
+      if (g.IsConstant()) {
+        continue;
+      }
+      Polynomial q;
+      num.p.Divide(g, &q);
+      num.p = q;
+      den.p.Divide(g, &q);
+      den.p = q;
+      common.push_back(
+          PolynomialFactor{nullptr, num.exponent + den.exponent, g});
+    }
+  }
+  if (common.empty()) {
+    return false;
+  }
+
+  op1.remove_if([](const NodePtr &e) {
+    NodePtr b;
+    int k;
+    return polynomial_factor(e, &b, &k);
+  });
+  for (const auto &f : factors) {
+    // the content is kept as a number, so that the numerator and the
+    // denominator have coprime integer coefficients.
+    auto c = f.p.Content();
+    op1.push_back(new_node<Number>(
+        NumberRepr::Pow(NumberRepr(c), NumberRepr(long(f.exponent)))));
+    op1.push_back(
+        power_node(ring.ToNode(f.p * Rational_t(1 / c)), f.exponent));
+  }
+  for (const auto &f : common) {
+    if (f.exponent != 0) {
+      op1.push_back(power_node(ring.ToNode(f.p), f.exponent));
+    }
+  }
+  return true;
+}
+
 void Factor::Eval(NodePtr *base, std::shared_ptr<State> state, bool numeric) {
   TwoOp::Eval(base, state, numeric);
 
@@ -135,31 +329,15 @@ void Factor::Eval(NodePtr *base, std::shared_ptr<State> state, bool numeric) {
     return;
   }
 
-  // if a child is also a Factor, move elements to this Factor, i.e.
-  // a tree (*, a, (*, b, c)) is converted to (*, a, b, c).
-  std::list<NodePtr> n;
-  for (auto it = op1.begin(); it != op1.end();) {
-    if ((*it)->Type() == Node::Type_t::Factor) {
-      auto fact = std::static_pointer_cast<Factor>(*it);
-      n.insert(n.end(), fact->Data().begin(), fact->Data().end());
-      it = op1.erase(it);
-    } else {
-      it++;
-    }
-  }
-  op1.insert(op1.end(), n.begin(), n.end());
-
   // evaluate complex factors
   auto value = std::complex<NumberRepr>(NumberRepr(1l), NumberRepr(0l));
-  for (auto it = op1.begin(); it != op1.end();) {
-    auto v = complex_number(*it);
+  op1.remove_if([&value](const NodePtr &e) {
+    auto v = complex_number(e);
     if (v.second == true) {
       value = complex_mul(value, v.first);
-      it = op1.erase(it);
-    } else {
-      it++;
     }
-  }
+    return v.second;
+  });
   if (value != std::complex<NumberRepr>(NumberRepr(1l), NumberRepr(0l))) {
     // if the complex factor is a complex number, we have to insert a number and
     // "i" as elements to this factor otherwise we would obtain the tree 
@@ -174,6 +352,10 @@ void Factor::Eval(NodePtr *base, std::shared_ptr<State> state, bool numeric) {
   }
 
   simplify(op1, state);
+  if (cancelPolynomial()) {
+    Eval(base, state, numeric);
+    return;
+  }
 
   if (base && op1.size() == 1) {
     *base = op1.front();
@@ -181,7 +363,7 @@ void Factor::Eval(NodePtr *base, std::shared_ptr<State> state, bool numeric) {
   }
 
   if (base && op1.size() == 0) {
-    base->reset(new Number(1l));
+    *base = new_node<Number>(1l);
     return;
   }
   op1.sort(comparator);
@@ -191,6 +373,8 @@ void Factor::Eval(NodePtr *base, std::shared_ptr<State> state, bool numeric) {
       op1.pop_front();
     }
   }
+  // the operands were modified in place.
+  invalidateHash();
 }
 
 static std::string latex_denom(NodePtr e) {
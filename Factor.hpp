@@ -34,10 +34,11 @@ public:
 
   bool HasFactor(NodePtr f) { return false; }
 
-  virtual NodePtr clone() const { return std::make_shared<Factor>(*this); }
+  virtual NodePtr clone() const { return new_node<Factor>(*this); }
 
 private:
-  void simplify(std::list<NodePtr> &op, std::shared_ptr<State> state);
+  void simplify(NodeList &op, std::shared_ptr<State> state);
+  bool cancelPolynomial();
 };
 
 } // namespace Equation
@@ -11,6 +11,7 @@
 using namespace Equation;
 
 void Function::Eval(NodePtr *base, std::shared_ptr<State> state, bool numeric) {
+  invalidateHash();
   for (auto &e : args) {
     e->Eval(&e, state, false);
   }
@@ -18,6 +19,10 @@ void Function::Eval(NodePtr *base, std::shared_ptr<State> state, bool numeric) {
   if (state && state->IsFunction(fname)) {
     auto result = state->EvalFunction(fname, args, numeric);
     if (result) {
+      if (numeric) {
+        // exact values such as sin(pi/3) = 3^(1/2)/2 are not numbers yet.
+        result->Eval(&result, state, true);
+      }
       *base = result;
       return;
     }
@@ -32,6 +37,13 @@ void Function::Eval(NodePtr *base, std::shared_ptr<State> state, bool numeric) {
       *base = result;
       return;
     }
+    return;
+  }
+  if (numeric) {
+    // e.g. the entries of vector(...) and matrix(...).
+    for (auto &e : args) {
+      e->Eval(&e, state, true);
+    }
   }
 }
 
@@ -86,7 +98,7 @@ void Function::ToLatex(std::ostream &s) {
   s << "\\right)";
 }
 
-bool Function::equals(NodePtr n) const {
+bool Function::equalTo(const NodePtr &n) const {
   if (n->Type() != Node::Type_t::Function) {
     return false;
   }
@@ -108,3 +120,12 @@ bool Function::equals(NodePtr n) const {
   }
   return true;
 }
+
+std::size_t Function::hash() const {
+  std::size_t h = static_cast<std::size_t>(Type());
+  hash_combine(h, std::hash<std::string>()(fname));
+  for (const auto &a : args) {
+    hash_combine(h, a->Hash());
+  }
+  return h;
+}
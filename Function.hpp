@@ -13,7 +13,7 @@ class Function : public Node {
 public:
   Function(std::string n) : fname(n) {}
 
-  Function(const std::string &n, const std::list<NodePtr> a) {
+  Function(const std::string &n, const NodeList &a) {
     fname = n;
     for (auto &e : a) {
       args.push_back(e->clone());
@@ -23,7 +23,10 @@ public:
   virtual void Eval(NodePtr *base, std::shared_ptr<State> state,
                     bool numeric = false);
 
-  void AddArg(NodePtr ptr) { args.push_back(ptr); }
+  void AddArg(NodePtr ptr) {
+    invalidateHash();
+    args.push_back(ptr);
+  }
 
   virtual enum Type_t Type() const { return Node::Type_t::Function; }
 
@@ -35,17 +38,20 @@ public:
 
   virtual bool IsNumber() const { return false; }
 
-  virtual bool equals(NodePtr n) const;
-
   virtual NodePtr clone() const {
-    return std::make_shared<Function>(fname, args);
+    return new_node<Function>(fname, args);
   }
 
   virtual std::string Name() const { return fname; }
-  virtual const std::list<NodePtr> &Args() const { return args; }
+  virtual const NodeList &Args() const { return args; }
+
+protected:
+  virtual bool equalTo(const NodePtr &n) const;
+
+  virtual std::size_t hash() const;
 
 private:
-  std::list<NodePtr> args;
+  NodeList args;
   std::string fname;
 };
 } // namespace Equation
@@ -0,0 +1,406 @@
+//
+//  Copyright © 2017 Lennart Oymanns. All rights reserved.
+//
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <map>
+
+#include "Error.h"
+#include "JitProgram.hpp"
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__))
+#define CALCULATOR_JIT 1
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace Equation {
+
+#ifdef CALCULATOR_JIT
+
+namespace {
+
+double call_pow(double a, double b) { return std::pow(a, b); }
+double call_exp(double x) { return std::exp(x); }
+double call_log(double x) { return std::log(x); }
+double call_sin(double x) { return std::sin(x); }
+double call_cos(double x) { return std::cos(x); }
+double call_tan(double x) { return std::tan(x); }
+double call_asin(double x) { return std::asin(x); }
+double call_acos(double x) { return std::acos(x); }
+double call_atan(double x) { return std::atan(x); }
+double call_sinh(double x) { return std::sinh(x); }
+double call_cosh(double x) { return std::cosh(x); }
+double call_tanh(double x) { return std::tanh(x); }
+double call_asinh(double x) { return std::asinh(x); }
+double call_acosh(double x) { return std::acosh(x); }
+double call_atanh(double x) { return std::atanh(x); }
+
+/** library_function returns the C library function for op or nullptr if op
+ is translated to instructions. */
+double (*library_function(Program::Op op))(double) {
+  switch (op) {
+  case Program::Op::Exp:
+    return call_exp;
+  case Program::Op::Log:
+    return call_log;
+  case Program::Op::Sin:
+    return call_sin;
+  case Program::Op::Cos:
+    return call_cos;
+  case Program::Op::Tan:
+    return call_tan;
+  case Program::Op::ASin:
+    return call_asin;
+  case Program::Op::ACos:
+    return call_acos;
+  case Program::Op::ATan:
+    return call_atan;
+  case Program::Op::Sinh:
+    return call_sinh;
+  case Program::Op::Cosh:
+    return call_cosh;
+  case Program::Op::Tanh:
+    return call_tanh;
+  case Program::Op::ASinh:
+    return call_asinh;
+  case Program::Op::ACosh:
+    return call_acosh;
+  case Program::Op::ATanh:
+    return call_atanh;
+  default:
+    return nullptr;
+  }
+}
+
+/** X86Emitter generates the machine code of a JitProgram.
+
+ The generated function has the signature double f(const double *values).
+ rbx points to the values, the temporaries of the program live in a stack
+ frame addressed by rsp and the constants are stored behind the code and
+ addressed relative to rip. All calculations are done in xmm0 and xmm1. */
+class X86Emitter {
+public:
+  explicit X86Emitter(const Program &p)
+      : prog(p), nvars(p.Variables().size()), nconsts(p.Constants().size()) {
+  }
+
+  void Generate();
+
+  /** Link returns the code followed by the constants. */
+  std::vector<std::uint8_t> Link() const;
+
+private:
+  // SSE opcodes (second byte after 0x0F)
+  enum : std::uint8_t {
+    MovLoad = 0x10,
+    MovStore = 0x11,
+    Sqrt = 0x51,
+    Add = 0x58,
+    Mul = 0x59,
+    Sub = 0x5C,
+    Div = 0x5E,
+    MovApd = 0x28,
+    XorPd = 0x57,
+  };
+
+  void byte(std::uint8_t b) { code.push_back(b); }
+  void dword(std::uint32_t d) {
+    for (int i = 0; i < 4; i++) {
+      byte(std::uint8_t(d >> (8 * i)));
+    }
+  }
+  void qword(std::uint64_t q) {
+    for (int i = 0; i < 8; i++) {
+      byte(std::uint8_t(q >> (8 * i)));
+    }
+  }
+
+  /** sse emits an instruction with xmm register xmm and the program register
+   reg as memory operand. */
+  void sse(std::uint8_t prefix, std::uint8_t opcode, int xmm,
+           std::uint32_t reg);
+  /** sse_const is like sse with a constant (given by its bits) as operand. */
+  void sse_const(std::uint8_t prefix, std::uint8_t opcode, int xmm,
+                 std::uint64_t bits);
+  /** sse_rr emits an instruction with two xmm registers. */
+  void sse_rr(std::uint8_t prefix, std::uint8_t opcode, int dst, int src);
+
+  void load(std::uint32_t reg);
+  void store(std::uint32_t reg);
+  void powInt(std::int32_t e);
+  void call(const void *f);
+
+  std::uint32_t constantIndex(std::uint64_t bits);
+
+  const Program &prog;
+  std::size_t nvars;
+  std::size_t nconsts;
+  std::vector<std::uint8_t> code;
+  std::vector<std::uint64_t> pool;
+  std::map<std::uint64_t, std::uint32_t> pool_index;
+  // positions of rip relative displacements and the referenced constant
+  std::vector<std::pair<std::size_t, std::uint32_t>> fixups;
+  // the program register which is held by xmm0 or -1
+  std::int64_t cached = -1;
+};
+
+std::uint64_t bits_of(double d) {
+  std::uint64_t u;
+  std::memcpy(&u, &d, sizeof(d));
+  return u;
+}
+
+std::uint32_t X86Emitter::constantIndex(std::uint64_t bits) {
+  auto it = pool_index.find(bits);
+  if (it != pool_index.end()) {
+    return it->second;
+  }
+  auto index = std::uint32_t(pool.size());
+  pool.push_back(bits);
+  pool_index[bits] = index;
+  return index;
+}
+
+void X86Emitter::sse(std::uint8_t prefix, std::uint8_t opcode, int xmm,
+                     std::uint32_t reg) {
+  if (reg >= nvars && reg < nvars + nconsts) {
+    sse_const(prefix, opcode, xmm,
+              bits_of(prog.Constants()[reg - nvars].real()));
+    return;
+  }
+  byte(prefix);
+  byte(0x0F);
+  byte(opcode);
+  if (reg < nvars) {
+    // [rbx + disp32]
+    byte(std::uint8_t(0x80 | (xmm << 3) | 3));
+    dword(std::uint32_t(8 * reg));
+    return;
+  }
+  // [rsp + disp32]
+  byte(std::uint8_t(0x80 | (xmm << 3) | 4));
+  byte(0x24);
+  dword(std::uint32_t(8 * (reg - nvars - nconsts)));
+}
+
+void X86Emitter::sse_const(std::uint8_t prefix, std::uint8_t opcode, int xmm,
+                           std::uint64_t bits) {
+  byte(prefix);
+  byte(0x0F);
+  byte(opcode);
+  // [rip + disp32], the displacement is filled in by Link
+  byte(std::uint8_t((xmm << 3) | 5));
+  fixups.emplace_back(code.size(), constantIndex(bits));
+  dword(0);
+}
+
+void X86Emitter::sse_rr(std::uint8_t prefix, std::uint8_t opcode, int dst,
+                        int src) {
+  byte(prefix);
+  byte(0x0F);
+  byte(opcode);
+  byte(std::uint8_t(0xC0 | (dst << 3) | src));
+}
+
+void X86Emitter::load(std::uint32_t reg) {
+  if (cached == std::int64_t(reg)) {
+    return;
+  }
+  sse(0xF2, MovLoad, 0, reg);
+  cached = reg;
+}
+
+void X86Emitter::store(std::uint32_t reg) {
+  sse(0xF2, MovStore, 0, reg);
+  cached = reg;
+}
+
+void X86Emitter::call(const void *f) {
+  // mov rax, imm64; call rax
+  byte(0x48);
+  byte(0xB8);
+  qword(reinterpret_cast<std::uintptr_t>(f));
+  byte(0xFF);
+  byte(0xD0);
+}
+
+/** powInt computes xmm0 = xmm0^e by square-and-multiply. */
+void X86Emitter::powInt(std::int32_t e) {
+  std::uint32_t k = e < 0 ? std::uint32_t(-std::int64_t(e)) : e;
+  if (k == 0) {
+    sse_const(0xF2, MovLoad, 0, bits_of(1.0));
+    return;
+  }
+  bool have_result = false;
+  while (k > 0) {
+    if (k & 1) {
+      if (have_result) {
+        sse_rr(0xF2, Mul, 1, 0);
+      } else {
+        sse_rr(0x66, MovApd, 1, 0);
+        have_result = true;
+      }
+    }
+    k >>= 1;
+    if (k > 0) {
+      sse_rr(0xF2, Mul, 0, 0);
+    }
+  }
+  if (e < 0) {
+    sse_const(0xF2, MovLoad, 0, bits_of(1.0));
+    sse_rr(0xF2, Div, 0, 1);
+  } else {
+    sse_rr(0x66, MovApd, 0, 1);
+  }
+}
+
+void X86Emitter::Generate() {
+  auto temps = prog.NumRegisters() - nvars - nconsts;
+  // after the return address and two pushes, rsp is 8 mod 16. The frame
+  // restores the 16 byte alignment which is required for calls.
+  std::uint32_t frame = std::uint32_t(8 * temps);
+  if (frame % 16 == 0) {
+    frame += 8;
+  }
+
+  byte(0x55); // push rbp
+  byte(0x48); // mov rbp, rsp
+  byte(0x89);
+  byte(0xE5);
+  byte(0x53); // push rbx
+  byte(0x48); // sub rsp, frame
+  byte(0x81);
+  byte(0xEC);
+  dword(frame);
+  byte(0x48); // mov rbx, rdi
+  byte(0x89);
+  byte(0xFB);
+
+  for (const auto &in : prog.Code()) {
+    switch (in.op) {
+    case Program::Op::Add:
+      load(in.a);
+      sse(0xF2, Add, 0, std::uint32_t(in.b));
+      break;
+    case Program::Op::Sub:
+      load(in.a);
+      sse(0xF2, Sub, 0, std::uint32_t(in.b));
+      break;
+    case Program::Op::Mul:
+      load(in.a);
+      sse(0xF2, Mul, 0, std::uint32_t(in.b));
+      break;
+    case Program::Op::Div:
+      load(in.a);
+      sse(0xF2, Div, 0, std::uint32_t(in.b));
+      break;
+    case Program::Op::Neg:
+      load(in.a);
+      sse_const(0xF2, MovLoad, 1, 0x8000000000000000ull);
+      sse_rr(0x66, XorPd, 0, 1);
+      break;
+    case Program::Op::Sqrt:
+      load(in.a);
+      sse_rr(0xF2, Sqrt, 0, 0);
+      break;
+    case Program::Op::PowInt:
+      load(in.a);
+      powInt(in.b);
+      break;
+    case Program::Op::Pow:
+      load(in.a);
+      sse(0xF2, MovLoad, 1, std::uint32_t(in.b));
+      call(reinterpret_cast<const void *>(call_pow));
+      break;
+    default:
+      load(in.a);
+      call(reinterpret_cast<const void *>(library_function(in.op)));
+      break;
+    }
+    // xmm0 holds the result; only the store updates the cached register.
+    cached = -1;
+    store(in.dst);
+  }
+  load(prog.Result());
+
+  byte(0x48); // add rsp, frame
+  byte(0x81);
+  byte(0xC4);
+  dword(frame);
+  byte(0x5B); // pop rbx
+  byte(0x5D); // pop rbp
+  byte(0xC3); // ret
+}
+
+std::vector<std::uint8_t> X86Emitter::Link() const {
+  std::vector<std::uint8_t> out = code;
+  while (out.size() % 16 != 0) {
+    out.push_back(0xCC); // int3
+  }
+  std::size_t pool_offset = out.size();
+  for (auto bits : pool) {
+    for (int i = 0; i < 8; i++) {
+      out.push_back(std::uint8_t(bits >> (8 * i)));
+    }
+  }
+  for (const auto &f : fixups) {
+    // rip points to the end of the instruction, i.e. behind the displacement
+    auto disp = std::int32_t(pool_offset + 8 * f.second - (f.first + 4));
+    std::memcpy(&out[f.first], &disp, sizeof(disp));
+  }
+  return out;
+}
+
+} // namespace
+
+bool JitProgram::Supported() { return true; }
+
+JitProgram::JitProgram(const Program &p) : variables(p.Variables()) {
+  if (!p.IsReal()) {
+    throw InputError(0, "cannot compile complex program to native code");
+  }
+  X86Emitter emitter(p);
+  emitter.Generate();
+  auto bytes = emitter.Link();
+
+  auto page = std::size_t(sysconf(_SC_PAGESIZE));
+  code_size = bytes.size();
+  mapped_size = (code_size + page - 1) / page * page;
+  memory = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED) {
+    memory = nullptr;
+    throw InputError(0, "cannot allocate memory for native code");
+  }
+  std::memcpy(memory, bytes.data(), bytes.size());
+  // the pages are never writable and executable at the same time.
+  if (mprotect(memory, mapped_size, PROT_READ | PROT_EXEC) != 0) {
+    munmap(memory, mapped_size);
+    memory = nullptr;
+    throw InputError(0, "cannot make native code executable");
+  }
+  function = reinterpret_cast<Function_t>(memory);
+}
+
+JitProgram::~JitProgram() {
+  if (memory) {
+    munmap(memory, mapped_size);
+  }
+}
+
+#else
+
+bool JitProgram::Supported() { return false; }
+
+JitProgram::JitProgram(const Program &) {
+  throw InputError(0, "native code generation is not supported");
+}
+
+JitProgram::~JitProgram() {}
+
+#endif
+
+} // namespace Equation
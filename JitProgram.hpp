@@ -0,0 +1,65 @@
+//
+//  Copyright © 2017 Lennart Oymanns. All rights reserved.
+//
+
+#ifndef JitProgram_hpp
+#define JitProgram_hpp
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "Program.hpp"
+
+namespace Equation {
+
+/** JitProgram translates a real Program to native x86-64 machine code.
+
+ The generated function uses SSE2 scalar instructions for arithmetic and
+ square roots and calls the C library for all other functions. The code is
+ written to pages which are mapped with mmap and made executable (and read
+ only) afterwards. A JitProgram can be evaluated by several threads at the
+ same time.
+
+ The JIT is only available on x86-64 Linux and macOS (see Supported()). */
+class JitProgram {
+public:
+  /** JitProgram compiles the program p. It throws an InputError if p is not
+   real or the JIT is not supported on this platform. */
+  explicit JitProgram(const Program &p);
+  ~JitProgram();
+
+  JitProgram(const JitProgram &) = delete;
+  JitProgram &operator=(const JitProgram &) = delete;
+
+  /** Supported returns true if the JIT can be used on this platform. */
+  static bool Supported();
+
+  /** Variables returns the names of the inputs (see Program::Variables). */
+  const std::vector<std::string> &Variables() const { return variables; }
+
+  /** Evaluate evaluates the program. values must contain a value for each
+   variable. */
+  double Evaluate(const double *values) const { return function(values); }
+
+  double Evaluate(const std::vector<double> &values) const {
+    return function(values.data());
+  }
+
+  /** CodeSize returns the size of the generated code and constants in
+   bytes. */
+  std::size_t CodeSize() const { return code_size; }
+
+private:
+  typedef double (*Function_t)(const double *);
+
+  std::vector<std::string> variables;
+  Function_t function = nullptr;
+  void *memory = nullptr;
+  std::size_t mapped_size = 0;
+  std::size_t code_size = 0;
+};
+
+} // namespace Equation
+
+#endif /* JitProgram_hpp */
@@ -0,0 +1,114 @@
+//
+//  Copyright © 2017 Lennart Oymanns. All rights reserved.
+//
+
+#include <new>
+
+#include "LimbPool.hpp"
+
+using namespace Equation;
+
+namespace {
+
+const std::size_t MinBlockSize = 64;
+const std::size_t NumClasses = 8; // 64 bytes ... 8 KiB
+const std::size_t MaxCachedBlocks = 256;
+
+struct FreeBlock {
+  FreeBlock *next;
+};
+
+// numbers with static storage duration may release their limbs after the
+// pool of the thread has been destroyed. Those limbs bypass the pool.
+thread_local bool pool_destroyed = false;
+
+struct Pool {
+  FreeBlock *free_lists[NumClasses] = {};
+  std::size_t counts[NumClasses] = {};
+
+  ~Pool() {
+    Release();
+    pool_destroyed = true;
+  }
+
+  void Release() {
+    for (std::size_t i = 0; i < NumClasses; i++) {
+      while (free_lists[i]) {
+        auto block = free_lists[i];
+        free_lists[i] = block->next;
+        ::operator delete(block);
+      }
+      counts[i] = 0;
+    }
+  }
+};
+
+Pool &pool() {
+  static thread_local Pool p;
+  return p;
+}
+
+/** size_class returns the index of the smallest class which can hold size
+ bytes or NumClasses if size is too large for the pool. */
+std::size_t size_class(std::size_t size) {
+  std::size_t block = MinBlockSize;
+  for (std::size_t i = 0; i < NumClasses; i++) {
+    if (size <= block) {
+      return i;
+    }
+    block *= 2;
+  }
+  return NumClasses;
+}
+
+} // namespace
+
+void *LimbPool::Allocate(std::size_t size) {
+  auto c = size_class(size);
+  if (c == NumClasses || pool_destroyed) {
+    return ::operator new(size);
+  }
+  auto &p = pool();
+  if (p.free_lists[c]) {
+    auto block = p.free_lists[c];
+    p.free_lists[c] = block->next;
+    p.counts[c]--;
+    return block;
+  }
+  return ::operator new(MinBlockSize << c);
+}
+
+void LimbPool::Deallocate(void *ptr, std::size_t size) {
+  auto c = size_class(size);
+  if (c == NumClasses || pool_destroyed) {
+    ::operator delete(ptr);
+    return;
+  }
+  auto &p = pool();
+  if (p.counts[c] >= MaxCachedBlocks) {
+    ::operator delete(ptr);
+    return;
+  }
+  auto block = static_cast<FreeBlock *>(ptr);
+  block->next = p.free_lists[c];
+  p.free_lists[c] = block;
+  p.counts[c]++;
+}
+
+void LimbPool::Release() {
+  if (!pool_destroyed) {
+    pool().Release();
+  }
+}
+
+std::size_t LimbPool::Cached() {
+  if (pool_destroyed) {
+    return 0;
+  }
+  auto &p = pool();
+  std::size_t bytes = 0;
+  for (std::size_t i = 0; i < NumClasses; i++) {
+    bytes += p.counts[i] * (MinBlockSize << i);
+  }
+  return bytes;
+}
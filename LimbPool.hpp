@@ -0,0 +1,67 @@
+//
+//  Copyright © 2017 Lennart Oymanns. All rights reserved.
+//
+
+#ifndef LimbPool_hpp
+#define LimbPool_hpp
+
+#include <cstddef>
+
+namespace Equation {
+
+/** LimbPool caches the limb buffers of arbitrary precision numbers.
+
+ Every thread has its own pool, so allocating and freeing limbs never takes a
+ lock. Freed buffers are kept in a free list per size class and are reused by
+ the next allocation of the same class. Each buffer is a separate heap block,
+ so a buffer may be freed by another thread than the one which allocated it;
+ it is then cached by the freeing thread. */
+class LimbPool {
+public:
+  /** Allocate returns a buffer of at least size bytes. */
+  static void *Allocate(std::size_t size);
+
+  /** Deallocate returns the buffer p of size bytes to the pool of the calling
+   thread. */
+  static void Deallocate(void *p, std::size_t size);
+
+  /** Release frees all buffers which are cached by the pool of the calling
+   thread. */
+  static void Release();
+
+  /** Cached returns the number of bytes cached by the pool of the calling
+   thread. */
+  static std::size_t Cached();
+};
+
+/** LimbAllocator is a stateless standard allocator using the LimbPool. */
+template <class T> class LimbAllocator {
+public:
+  typedef T value_type;
+
+  LimbAllocator() {}
+
+  template <class U> LimbAllocator(const LimbAllocator<U> &) {}
+
+  T *allocate(std::size_t n) {
+    return static_cast<T *>(LimbPool::Allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T *p, std::size_t n) {
+    LimbPool::Deallocate(p, n * sizeof(T));
+  }
+};
+
+template <class T, class U>
+bool operator==(const LimbAllocator<T> &, const LimbAllocator<U> &) {
+  return true;
+}
+
+template <class T, class U>
+bool operator!=(const LimbAllocator<T> &, const LimbAllocator<U> &) {
+  return false;
+}
+
+} // namespace Equation
+
+#endif /* LimbPool_hpp */
@@ -1,17 +1,28 @@
 #include "MathFunction.hpp"
+#include "Canonical.hpp"
 #include "ComplexNumber.hpp"
 #include "Node.hpp"
 #include "Number.hpp"
 #include "Power.hpp"
+#include "TrigValues.hpp"
 
 namespace Equation {
 
-bool MathFunction::SpecialValues(const std::list<NodePtr> &args,
+NodePtr MathFunction::Eval(const NodeList &args, bool numeric) {
+  NodePtr result;
+  if (SpecialValues(args, &result)) {
+    return result->clone();
+  }
+  return evalNumbers(args, numeric);
+}
+
+bool MathFunction::SpecialValues(const NodeList &args,
                                  NodePtr *result) {
-  NodePtr arg0 = *(args.begin());
-  for (auto &s : svalues) {
-    if (s.first->equals(arg0)) {
-      *result = make_node(s.second);
+  const NodePtr &arg0 = *(args.begin());
+  auto range = svalues.equal_range(arg0->Hash());
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second.first->equals(arg0)) {
+      *result = it->second.second;
       return true;
     }
   }
@@ -19,17 +30,19 @@ bool MathFunction::SpecialValues(const std::list<NodePtr> &args,
 }
 
 void MathFunction::AddSpecialValue(NodePtr n, const std::string &s) {
-  svalues.push_back(std::pair<NodePtr, std::string>(n, s));
+  auto value = make_node(s);
+  // the functions are shared between threads (see Builtins), so the cached
+  // hashes and orders must not be written during a lookup.
+  cache_canonical(n);
+  cache_canonical(value);
+  svalues.insert(std::make_pair(n->Hash(), std::make_pair(n, value)));
 }
 
 // -- sin ---
 
-FuncSin::FuncSin() {
-  AddSpecialValue(UserFunction::make_node("0"), "0");
-  AddSpecialValue(UserFunction::make_node("pi"), "0");
-  AddSpecialValue(UserFunction::make_node("2*pi"), "0");
-  AddSpecialValue(UserFunction::make_node("1/2*pi"), "1");
-  AddSpecialValue(UserFunction::make_node("3*pi/2"), "-1");
+bool FuncSin::SpecialValues(const NodeList &args, NodePtr *result) {
+  *result = trig_value(Trig::Sin, *args.begin());
+  return *result != nullptr;
 }
 
 NodePtr FuncSin::EvalNum(const std::vector<std::complex<NumberRepr>> &args) {
@@ -40,12 +53,9 @@ NodePtr FuncSin::EvalNum(const std::vector<std::complex<NumberRepr>> &args) {
 
 // --- cos --------------
 
-FuncCos::FuncCos() {
-  AddSpecialValue(UserFunction::make_node("0"), "1");
-  AddSpecialValue(UserFunction::make_node("pi"), "-1");
-  AddSpecialValue(UserFunction::make_node("2*pi"), "1");
-  AddSpecialValue(UserFunction::make_node("1/2*pi"), "0");
-  AddSpecialValue(UserFunction::make_node("3*pi/2"), "0");
+bool FuncCos::SpecialValues(const NodeList &args, NodePtr *result) {
+  *result = trig_value(Trig::Cos, *args.begin());
+  return *result != nullptr;
 }
 
 NodePtr FuncCos::EvalNum(const std::vector<std::complex<NumberRepr>> &args) {
@@ -62,7 +72,10 @@ NodePtr FuncTan::EvalNum(const std::vector<std::complex<NumberRepr>> &args) {
   return node_from_complex(std::tan(value));
 }
 
-FuncTan::FuncTan() { AddSpecialValue(UserFunction::make_node("0"), "0"); }
+bool FuncTan::SpecialValues(const NodeList &args, NodePtr *result) {
+  *result = trig_value(Trig::Tan, *args.begin());
+  return *result != nullptr;
+}
 
 // --- asin --------------
 
@@ -152,14 +165,13 @@ FuncSqrt::FuncSqrt(){
 
 };
 
-NodePtr FuncSqrt::Eval(const std::list<NodePtr> &args, bool numeric) {
-  auto ret = UserFunction::Eval(args, numeric);
+NodePtr FuncSqrt::Eval(const NodeList &args, bool numeric) {
+  auto ret = MathFunction::Eval(args, numeric);
   if (ret) {
     return ret;
   }
   auto it = args.begin();
-  NodePtr result = std::make_shared<Power>(
-      *it, std::make_shared<Number>(NumberRepr(1l, 2l)));
+  NodePtr result = new_node<Power>(*it, new_node<Number>(NumberRepr(1l, 2l)));
   result->Eval(&result, std::make_shared<DefaultState>());
   return result;
 }
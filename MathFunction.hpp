@@ -5,39 +5,56 @@
 #ifndef MathFunction_hpp
 #define MathFunction_hpp
 
-#include <list>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "UserFunction.hpp"
 
 namespace Equation {
 
+/** MathFunction is a function of one argument with a table of exact values.
+
+ The tables are shared between threads (see Builtins), so SpecialValues
+ returns the table entry itself, which must not be modified. Eval returns a
+ copy, because the caller evaluates the result in place. */
 class MathFunction : public UserFunction {
 public:
-  virtual bool SpecialValues(const std::list<NodePtr> &args, NodePtr *result);
+  virtual NodePtr Eval(const NodeList &args, bool numeric = false);
+  virtual bool SpecialValues(const NodeList &args, NodePtr *result);
   virtual size_t NumArgs() const { return 1; }
 
+  /** AddSpecialValue adds the exact value s of this function at argument
+   n. */
   void AddSpecialValue(NodePtr n, const std::string &s);
 
 private:
-  std::list<std::pair<NodePtr, std::string>> svalues;
+  /** svalues maps the hash of an argument to the argument and the value of
+   this function. */
+  std::unordered_multimap<std::size_t, std::pair<NodePtr, NodePtr>> svalues;
 };
 
 class FuncSin : public MathFunction {
 public:
-  FuncSin();
+  /** SpecialValues evaluates sin exactly at rational multiples of pi (see
+   trig_value). */
+  virtual bool SpecialValues(const NodeList &args, NodePtr *result);
   virtual NodePtr EvalNum(const std::vector<std::complex<NumberRepr>> &args);
 };
 
 class FuncCos : public MathFunction {
 public:
-  FuncCos();
+  /** SpecialValues evaluates cos exactly at rational multiples of pi (see
+   trig_value). */
+  virtual bool SpecialValues(const NodeList &args, NodePtr *result);
   virtual NodePtr EvalNum(const std::vector<std::complex<NumberRepr>> &args);
 };
 
 class FuncTan : public MathFunction {
 public:
-  FuncTan();
+  /** SpecialValues evaluates tan exactly at rational multiples of pi (see
+   trig_value). */
+  virtual bool SpecialValues(const NodeList &args, NodePtr *result);
   virtual NodePtr EvalNum(const std::vector<std::complex<NumberRepr>> &args);
 };
 
@@ -75,7 +92,7 @@ class FuncSqrt : public MathFunction {
 public:
   FuncSqrt();
   virtual NodePtr EvalNum(const std::vector<std::complex<NumberRepr>> &args);
-  virtual NodePtr Eval(const std::list<NodePtr> &args, bool numeric = false);
+  virtual NodePtr Eval(const NodeList &args, bool numeric = false);
 };
 
 class FuncSinh : public MathFunction {
@@ -5,12 +5,15 @@
 #ifndef Node_hpp
 #define Node_hpp
 
+#include <cstddef>
 #include <iostream>
 #include <list>
 #include <memory>
 #include <sstream>
 #include <string>
+#include <utility>
 
+#include "NodeArena.hpp"
 #include "State.hpp"
 
 namespace Equation {
@@ -88,13 +91,85 @@ public:
   bool operator==(const NodePtr n) const { return equals(n); }
 
   /** equals returns true if this node and Node n are equal (e.g. same type
-   * etc.). */
-  virtual bool equals(NodePtr n) const = 0;
+   * etc.).
+
+   Identical nodes and nodes with different hashes are decided without
+   looking at the children. */
+  bool equals(const NodePtr &n) const {
+    if (n.get() == this) {
+      return true;
+    }
+    if (Hash() != n->Hash()) {
+      return false;
+    }
+    return equalTo(n);
+  }
+
+  /** Hash returns a structural hash of this node, i.e. equal nodes have equal
+   hashes. The hash is computed once and cached until the node is modified. */
+  std::size_t Hash() const {
+    if (!hash_valid) {
+      hash_value = hash();
+      hash_valid = true;
+    }
+    return hash_value;
+  }
 
   /** clone returns a shared pointer to a new Node with the same content as this
    * Node. */
   virtual NodePtr clone() const = 0;
+
+protected:
+  /** equalTo compares this node and n structurally. It is called by equals()
+   if the hashes of both nodes are equal. */
+  virtual bool equalTo(const NodePtr &n) const = 0;
+
+  /** hash computes the structural hash of this node. Nodes which are equal
+   (see equalTo) must return the same value. */
+  virtual std::size_t hash() const = 0;
+
+  /** invalidateHash has to be called whenever this node or one of its
+   children is modified. It also invalidates the cached canonical order of
+   the children of sums and products (see TwoOp::CanonicalOrder). */
+  void invalidateHash() {
+    hash_valid = false;
+    order_valid = false;
+  }
+
+  /** order_valid is true while a cached order of the children is valid. */
+  mutable bool order_valid = false;
+
+private:
+  mutable std::size_t hash_value = 0;
+  mutable bool hash_valid = false;
 };
+
+/** hash_combine mixes the hash value h into seed. */
+inline void hash_combine(std::size_t &seed, std::size_t h) {
+  seed ^= h + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+}
+
+/** hash_mix scrambles the bits of h. It is used for hashes which are summed up,
+ e.g. the operands of a commutative operation. */
+inline std::size_t hash_mix(std::size_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb93f6e7ed85bull;
+  h ^= h >> 33;
+  return h;
+}
+
+/** new_node creates a node of type T. The node is allocated from the current
+ NodeArena of this thread if there is one, otherwise from the heap. */
+template <class T, class... Args> std::shared_ptr<T> new_node(Args &&... args) {
+  NodeArena *arena = NodeArena::Current().get();
+  if (arena) {
+    return std::allocate_shared<T>(ArenaAllocator<T>(arena),
+                                   std::forward<Args>(args)...);
+  }
+  return std::make_shared<T>(std::forward<Args>(args)...);
+}
 } // namespace Equation
 
 #endif /* Node_hpp */
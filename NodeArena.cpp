@@ -0,0 +1,76 @@
+//
+//  Copyright © 2017 Lennart Oymanns. All rights reserved.
+//
+
+#include <new>
+
+#include "NodeArena.hpp"
+
+using namespace Equation;
+
+namespace {
+
+NodeArenaPtr &current_arena() {
+  static thread_local NodeArenaPtr arena;
+  return arena;
+}
+
+} // namespace
+
+NodeArena::~NodeArena() {
+  for (auto c : chunks) {
+    ::operator delete(c);
+  }
+}
+
+void *NodeArena::Allocate(std::size_t size) {
+  // every block keeps the arena alive until it is deallocated.
+  if (size > MaxBlockSize) {
+    auto block = ::operator new(size);
+    ++refs;
+    return block;
+  }
+  size = (size + Granularity - 1) / Granularity * Granularity;
+  auto &head = free_lists[size / Granularity - 1];
+  if (head) {
+    auto block = head;
+    head = block->next;
+    ++refs;
+    return block;
+  }
+  if (pos + size > end) {
+    // the rest of the current chunk is dropped, it is released together with
+    // the chunk.
+    pos = static_cast<char *>(::operator new(ChunkSize));
+    end = pos + ChunkSize;
+    chunks.push_back(pos);
+  }
+  auto block = pos;
+  pos += size;
+  ++refs;
+  return block;
+}
+
+void NodeArena::Deallocate(void *p, std::size_t size) {
+  if (size > MaxBlockSize) {
+    ::operator delete(p);
+  } else {
+    size = (size + Granularity - 1) / Granularity * Granularity;
+    auto &head = free_lists[size / Granularity - 1];
+    auto block = static_cast<FreeBlock *>(p);
+    block->next = head;
+    head = block;
+  }
+  intrusive_ptr_release(this);
+}
+
+const NodeArenaPtr &NodeArena::Current() {
+  return current_arena();
+}
+
+NodeArena::Scope::Scope(const NodeArenaPtr &arena)
+    : previous(current_arena()) {
+  current_arena() = arena;
+}
+
+NodeArena::Scope::~Scope() { current_arena() = previous; }
@@ -0,0 +1,124 @@
+//
+//  Copyright © 2017 Lennart Oymanns. All rights reserved.
+//
+
+#ifndef NodeArena_hpp
+#define NodeArena_hpp
+
+#include <cstddef>
+#include <vector>
+
+#include <boost/intrusive_ptr.hpp>
+
+namespace Equation {
+
+class NodeArena;
+
+/** NodeArenaPtr owns a reference to a NodeArena. */
+typedef boost::intrusive_ptr<NodeArena> NodeArenaPtr;
+
+/** NodeArena is a pool allocator for the nodes of an equation tree.
+
+ Nodes are carved out of large chunks instead of being allocated one by one
+ from the heap. Freed blocks are kept in free lists (one per block size) and
+ are reused by later allocations. The nodes are still destroyed one by one;
+ only the chunks are returned to the heap together.
+
+ The arena is reference counted: every NodeArenaPtr and every block which is
+ not yet deallocated holds a reference. The count is a plain integer, so the
+ allocators of the nodes do not touch a shared atomic counter. The arena is
+ deleted when the last reference is gone, i.e. nodes can outlive the Equation
+ which created the arena.
+
+ A NodeArena is not thread-safe. It is meant to be used by a single Equation
+ which is evaluated by one thread at a time. */
+class NodeArena {
+public:
+  NodeArena() {}
+  NodeArena(const NodeArena &) = delete;
+  NodeArena &operator=(const NodeArena &) = delete;
+  ~NodeArena();
+
+  /** Allocate returns a block of at least size bytes. */
+  void *Allocate(std::size_t size);
+
+  /** Deallocate returns the block p of size bytes to the arena. */
+  void Deallocate(void *p, std::size_t size);
+
+  /** Current returns the arena which is used by new_node in this thread. If
+   no arena is active, the returned pointer is empty and nodes are allocated
+   from the heap. */
+  static const NodeArenaPtr &Current();
+
+  /** Scope makes arena the current arena of this thread until the Scope is
+   destroyed. Scopes can be nested. */
+  class Scope {
+  public:
+    explicit Scope(const NodeArenaPtr &arena);
+    ~Scope();
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+  private:
+    NodeArenaPtr previous;
+  };
+
+private:
+  friend void intrusive_ptr_add_ref(NodeArena *a) { ++a->refs; }
+  friend void intrusive_ptr_release(NodeArena *a) {
+    if (--a->refs == 0) {
+      delete a;
+    }
+  }
+
+  static const std::size_t ChunkSize = 64 * 1024;
+  static const std::size_t Granularity = 16;
+  static const std::size_t MaxBlockSize = 512;
+
+  struct FreeBlock {
+    FreeBlock *next;
+  };
+
+  std::vector<char *> chunks;
+  char *pos = nullptr;
+  char *end = nullptr;
+  FreeBlock *free_lists[MaxBlockSize / Granularity] = {};
+  std::size_t refs = 0;
+};
+
+/** ArenaAllocator is a standard allocator which allocates from a NodeArena.
+
+ The allocator only stores a pointer to the arena. The arena is kept alive by
+ the blocks allocated from it, not by the allocators. */
+template <class T> class ArenaAllocator {
+public:
+  typedef T value_type;
+
+  explicit ArenaAllocator(NodeArena *a) : arena(a) {}
+
+  template <class U>
+  ArenaAllocator(const ArenaAllocator<U> &o) : arena(o.arena) {}
+
+  T *allocate(std::size_t n) {
+    return static_cast<T *>(arena->Allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T *p, std::size_t n) { arena->Deallocate(p, n * sizeof(T)); }
+
+  NodeArena *arena;
+};
+
+template <class T, class U>
+bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) {
+  return a.arena == b.arena;
+}
+
+template <class T, class U>
+bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) {
+  return a.arena != b.arena;
+}
+
+} // namespace Equation
+
+#endif /* NodeArena_hpp */
@@ -30,6 +30,7 @@ public:
   virtual void Eval(NodePtr *base, std::shared_ptr<State> state,
                     bool numeric = false) {
     if (numeric) {
+      invalidateHash();
       value.SetFromDouble(value.Double());
     }
   }
@@ -45,7 +46,12 @@ public:
 
   virtual bool IsNumber() const { return true; }
 
-  virtual bool equals(NodePtr n) const {
+  virtual void ToLatex(std::ostream &s) { value.ToLatex(s); }
+
+  virtual NodePtr clone() const { return new_node<Number>(value); }
+
+protected:
+  virtual bool equalTo(const NodePtr &n) const {
     if (n->Type() != Node::Type_t::Number) {
       return false;
     }
@@ -54,9 +60,11 @@ public:
     return number && value == number->value;
   }
 
-  virtual void ToLatex(std::ostream &s) { value.ToLatex(s); }
-
-  virtual NodePtr clone() const { return std::make_shared<Number>(value); }
+  virtual std::size_t hash() const {
+    std::size_t h = static_cast<std::size_t>(Type());
+    hash_combine(h, value.Hash());
+    return h;
+  }
 
 private:
   NumberRepr value; ///< actual number
@@ -2,38 +2,157 @@
 //  Created by Lennart Oymanns on 03.05.17.
 //
 
+#include <functional>
+#include <limits>
+#include <stdexcept>
+
 #include "NumberRepr.hpp"
 
 using namespace Equation;
 
+namespace {
+
+const std::int64_t small_max = std::numeric_limits<std::int64_t>::max();
+
+/** mul sets r to a*b. It returns false if the product does not fit into
+ Wide_t. a and b are never the smallest int64. */
+bool mul(std::int64_t a, std::int64_t b, Wide_t *r) {
+#if defined(__SIZEOF_INT128__)
+  *r = Wide_t(a) * b;
+  return true;
+#else
+  if (a != 0 && std::abs(b) > small_max / std::abs(a)) {
+    return false;
+  }
+  *r = a * b;
+  return true;
+#endif
+}
+
+/** add sets r to a+b. It returns false if the sum does not fit into Wide_t.
+ a and b are results of mul. */
+bool add(Wide_t a, Wide_t b, Wide_t *r) {
+#if !defined(__SIZEOF_INT128__)
+  if ((b > 0 && a > small_max - b) || (b < 0 && a < -small_max - b)) {
+    return false;
+  }
+#endif
+  // the sum of two products of 64 bit integers always fits into 128 bits.
+  *r = a + b;
+  return true;
+}
+
+Wide_t gcd(Wide_t a, Wide_t b) {
+  if (a < 0) {
+    a = -a;
+  }
+  if (b < 0) {
+    b = -b;
+  }
+  while (b != 0) {
+    Wide_t t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+/** fits_small returns true if i fits into the small representation. The
+ smallest int64 is excluded, so that negation can never overflow. */
+bool fits_small(Wide_t i) { return i <= small_max && i >= -small_max; }
+
+bool fits_small(const Integer_t &i) { return i <= small_max && i >= -small_max; }
+
+} // namespace
+
 NumberRepr::NumberRepr() {
   value_double = 0.0;
   isValid = false;
-  rational = Rational_t(0);
 }
 
 NumberRepr::NumberRepr(const std::string &s) {
   auto dot_pos = s.find_first_of("eE.");
   if (dot_pos != std::string::npos) {
-    value_double = strtod(s.c_str(), NULL);
-    isFraction = false;
-  } else {
-    rational = Integer_t(s);
-    isFraction = true;
+    SetFromDouble(strtod(s.c_str(), NULL));
+    return;
+  }
+  if (s.size() < 19) {
+    // at most 18 digits always fit into 64 bits.
+    SetFromInt(strtoll(s.c_str(), NULL, 10));
+    return;
+  }
+  try {
+    setRational(Rational_t(Integer_t(s)));
+  } catch (std::overflow_error &) {
+    isValid = false;
   }
-  isValid = true;
 }
 
-/** SetFromInt sets the value of this number to fraction num/denom. */
-void NumberRepr::SetFromInt(long num, long denom) {
+/** setSmall sets this number to the fraction num/denom if the reduced
+ fraction fits into the small representation. Otherwise, it returns false and
+ leaves this number unchanged. denom must not be zero. num and denom must be
+ at most 127 bits wide. */
+bool NumberRepr::setSmall(Wide_t num, Wide_t denom) {
+  if (denom < 0) {
+    num = -num;
+    denom = -denom;
+  }
+  Wide_t g = gcd(num, denom);
+  if (g > 1) {
+    num /= g;
+    denom /= g;
+  }
+  if (!fits_small(num) || !fits_small(denom)) {
+    return false;
+  }
   isFraction = true;
-  rational = Rational_t(num, denom);
+  isSmall = true;
+  small_num = static_cast<std::int64_t>(num);
+  small_denom = static_cast<std::int64_t>(denom);
+  rational.reset();
+  return true;
+}
 
+/** setRational sets this number to the fraction rat. If possible, the number
+ is stored in the small representation. */
+void NumberRepr::setRational(const Rational_t &rat) {
+  isFraction = true;
+  const auto &num = boost::multiprecision::numerator(rat);
+  const auto &denom = boost::multiprecision::denominator(rat);
+  if (fits_small(num) && fits_small(denom)) {
+    isSmall = true;
+    small_num = num.convert_to<std::int64_t>();
+    small_denom = denom.convert_to<std::int64_t>();
+    rational.reset();
+    return;
+  }
+  isSmall = false;
+  rational = std::make_shared<const Rational_t>(rat);
+}
+
+/** toRational returns the fraction as arbitrary precision rational. */
+Rational_t NumberRepr::toRational() const {
+  if (isSmall) {
+    return Rational_t(Integer_t(small_num), Integer_t(small_denom));
+  }
+  return *rational;
+}
+
+/** SetFromInt sets the value of this number to fraction num/denom. */
+void NumberRepr::SetFromInt(long num, long denom) {
   value_double = 0.0;
   if (denom == 0) {
+    isFraction = true;
+    isSmall = true;
+    small_num = 0;
+    small_denom = 1;
     isValid = false;
-  } else {
-    isValid = true;
+    return;
+  }
+  isValid = true;
+  if (!fits_small(Wide_t(num)) || !fits_small(Wide_t(denom)) ||
+      !setSmall(num, denom)) {
+    setRational(Rational_t(num, denom));
   }
 }
 
@@ -44,7 +163,17 @@ NumberRepr &NumberRepr::operator*=(const NumberRepr &rhs) {
     isValid = false;
   }
   if (rhs.isFraction && isFraction) {
-    rational *= rhs.rational;
+    Wide_t num, denom;
+    if (isSmall && rhs.isSmall && mul(small_num, rhs.small_num, &num) &&
+        mul(small_denom, rhs.small_denom, &denom) && setSmall(num, denom)) {
+      return *this;
+    }
+    try {
+      setRational(toRational() * rhs.toRational());
+    } catch (std::overflow_error &) {
+      // the result does not fit into a fixed precision backend.
+      isValid = false;
+    }
     return *this;
   }
   SetFromDouble(Double() * rhs.Double());
@@ -59,11 +188,21 @@ NumberRepr &NumberRepr::operator/=(const NumberRepr &rhs) {
     isValid = false;
   }
   if (isFraction && rhs.isFraction) {
-    if (rhs.rational == Rational_t(0)) {
+    if (rhs.isSmall ? rhs.small_num == 0 : *rhs.rational == Rational_t(0)) {
       isValid = false;
       return *this;
     }
-    rational /= rhs.rational;
+    Wide_t num, denom;
+    if (isSmall && rhs.isSmall && mul(small_num, rhs.small_denom, &num) &&
+        mul(small_denom, rhs.small_num, &denom) && setSmall(num, denom)) {
+      return *this;
+    }
+    try {
+      setRational(toRational() / rhs.toRational());
+    } catch (std::overflow_error &) {
+      // the result does not fit into a fixed precision backend.
+      isValid = false;
+    }
     return *this;
   }
   SetFromDouble(Double() / rhs.Double());
@@ -77,7 +216,18 @@ NumberRepr &NumberRepr::operator+=(const NumberRepr &rhs) {
     isValid = false;
   }
   if (rhs.isFraction && isFraction) {
-    rational += rhs.rational;
+    Wide_t a, b, num, denom;
+    if (isSmall && rhs.isSmall && mul(small_num, rhs.small_denom, &a) &&
+        mul(rhs.small_num, small_denom, &b) && add(a, b, &num) &&
+        mul(small_denom, rhs.small_denom, &denom) && setSmall(num, denom)) {
+      return *this;
+    }
+    try {
+      setRational(toRational() + rhs.toRational());
+    } catch (std::overflow_error &) {
+      // the result does not fit into a fixed precision backend.
+      isValid = false;
+    }
     return *this;
   }
   SetFromDouble(Double() + rhs.Double());
@@ -91,7 +241,18 @@ NumberRepr &NumberRepr::operator-=(const NumberRepr &rhs) {
     isValid = false;
   }
   if (rhs.isFraction && isFraction) {
-    rational -= rhs.rational;
+    Wide_t a, b, num, denom;
+    if (isSmall && rhs.isSmall && mul(small_num, rhs.small_denom, &a) &&
+        mul(-rhs.small_num, small_denom, &b) && add(a, b, &num) &&
+        mul(small_denom, rhs.small_denom, &denom) && setSmall(num, denom)) {
+      return *this;
+    }
+    try {
+      setRational(toRational() - rhs.toRational());
+    } catch (std::overflow_error &) {
+      // the result does not fit into a fixed precision backend.
+      isValid = false;
+    }
     return *this;
   }
   SetFromDouble(Double() - rhs.Double());
@@ -132,18 +293,47 @@ NumberRepr NumberRepr::Pow(const NumberRepr &base, const NumberRepr &exp) {
     }
 
     unsigned e = abs_enum.convert_to<unsigned>();
-    auto rat = base.rational;
-    Rational_t result_num =
-        boost::multiprecision::pow(boost::multiprecision::numerator(rat), e);
-    Rational_t result_denom =
-        boost::multiprecision::pow(boost::multiprecision::denominator(rat), e);
-
-    if (exp.Numerator() >= Integer_t(0)) {
-      Rational_t res = result_num / result_denom;
+    if (base.isSmall) {
+      // binary powering stays in the small representation as long as the
+      // intermediate results fit.
+      NumberRepr result(1l);
+      NumberRepr b = base;
+      for (unsigned i = e; i > 0; i >>= 1) {
+        if (i & 1) {
+          result *= b;
+        }
+        if (i > 1) {
+          b *= b;
+        }
+      }
+      if (exp.Numerator() >= Integer_t(0)) {
+        return result;
+      }
+      if (result.isSmall && result.small_num == 0) {
+        // same error as the division of the big rationals.
+        throw std::overflow_error("Divide by zero.");
+      }
+      return NumberRepr(1l) / result;
+    }
+    try {
+      const auto &rat = *base.rational;
+      Rational_t result_num =
+          boost::multiprecision::pow(boost::multiprecision::numerator(rat), e);
+      Rational_t result_denom = boost::multiprecision::pow(
+          boost::multiprecision::denominator(rat), e);
+
+      if (exp.Numerator() >= Integer_t(0)) {
+        Rational_t res = result_num / result_denom;
+        return NumberRepr(res);
+      }
+      Rational_t res = result_denom / result_num;
       return NumberRepr(res);
+    } catch (std::overflow_error &) {
+      // the result does not fit into a fixed precision backend.
+      auto inv = NumberRepr(0l);
+      inv.isValid = false;
+      return inv;
     }
-    Rational_t res = result_denom / result_num;
-    return NumberRepr(res);
   }
   // calculate nth root numerically
   auto inv = NumberRepr(pow(base.Double(), exp.Double()));
@@ -151,10 +341,29 @@ NumberRepr NumberRepr::Pow(const NumberRepr &base, const NumberRepr &exp) {
   return inv;
 }
 
+const char *NumberRepr::Backend() {
+#if defined(CALCULATOR_BIGNUM_GMP)
+  return "gmp";
+#elif defined(CALCULATOR_BIGNUM_CHECKED)
+  return "checked";
+#else
+  return "cpp_int";
+#endif
+}
+
 /** Double returns a floating point representation of the number. */
 double NumberRepr::Double() const {
   if (isFraction) {
-    return rational.convert_to<double>();
+    if (isSmall) {
+      const std::int64_t exact = std::int64_t(1) << 53;
+      if (small_num < exact && small_num > -exact && small_denom < exact) {
+        // both values are exact doubles, so the division is rounded
+        // correctly.
+        return double(small_num) / double(small_denom);
+      }
+      return toRational().convert_to<double>();
+    }
+    return rational->convert_to<double>();
   }
   return value_double;
 }
@@ -164,6 +373,12 @@ std::string NumberRepr::String() const {
   if (!isValid) {
     return "nan";
   }
+  if (isSmall && isFraction) {
+    if (small_denom == 1) {
+      return std::to_string(small_num);
+    }
+    return std::to_string(small_num) + " / " + std::to_string(small_denom);
+  }
   std::stringstream ss;
   if (isFraction) {
     ss << Numerator().str();
@@ -181,7 +396,14 @@ bool NumberRepr::operator==(const NumberRepr &n) const {
     return false;
   }
   if (isFraction && n.isFraction) {
-    return rational == n.rational;
+    if (isSmall != n.isSmall) {
+      // fractions are stored in the small form whenever possible.
+      return false;
+    }
+    if (isSmall) {
+      return small_num == n.small_num && small_denom == n.small_denom;
+    }
+    return *rational == *n.rational;
   }
   if (!isFraction && !n.isFraction) {
     return Double() == n.Double();
@@ -189,6 +411,21 @@ bool NumberRepr::operator==(const NumberRepr &n) const {
   return false;
 }
 
+std::size_t NumberRepr::Hash() const {
+  if (!isValid) {
+    // invalid numbers are never equal to anything.
+    return 0;
+  }
+  if (isFraction) {
+    if (isSmall) {
+      std::size_t h = std::hash<std::int64_t>()(small_num);
+      return h * 31 + std::hash<std::int64_t>()(small_denom);
+    }
+    return std::hash<Rational_t>()(*rational);
+  }
+  return std::hash<double>()(value_double);
+}
+
 /** ToLatex writes a latex representation of this number to stream s. */
 void NumberRepr::ToLatex(std::ostream &s) const {
   if (IsFraction()) {
@@ -202,17 +439,23 @@ void NumberRepr::ToLatex(std::ostream &s) const {
   s << std::setprecision(17) << Double();
 }
 
-bool NumberRepr::operator<(const NumberRepr &n) {
+bool NumberRepr::operator<(const NumberRepr &n) const {
   if (!isValid || !n.isValid) {
     return false;
   }
   if (isFraction && n.isFraction) {
-    return rational < n.rational;
+    Wide_t a, b;
+    if (isSmall && n.isSmall && mul(small_num, n.small_denom, &a) &&
+        mul(n.small_num, small_denom, &b)) {
+      // denominators are positive.
+      return a < b;
+    }
+    return toRational() < n.toRational();
   }
   return Double() < n.Double();
 }
 
-bool NumberRepr::operator>(const NumberRepr &n) {
+bool NumberRepr::operator>(const NumberRepr &n) const {
   if (*this < n) {
     return false;
   }
@@ -228,5 +471,6 @@ void NumberRepr::SetFromDouble(double l) {
   isFraction = false;
   value_double = l;
   isValid = true;
-  rational = boost::multiprecision::cpp_rational(0);
+  isSmall = false;
+  rational.reset();
 }
@@ -6,38 +6,80 @@
 #define NumberRepr_hpp
 
 #include <cmath>
+#include <cstdint>
 #include <cstdlib>
 #include <iomanip>
+#include <memory>
 #include <sstream>
 #include <string>
 
+#if defined(CALCULATOR_BIGNUM_GMP)
+#include <boost/multiprecision/gmp.hpp>
+#else
 #include <boost/multiprecision/cpp_int.hpp>
+#endif
+
+#include "LimbPool.hpp"
 
 namespace Equation {
 
-using Integer_t = boost::multiprecision::cpp_int;
-using Rational_t = boost::multiprecision::cpp_rational;
+// The backend of the arbitrary precision numbers is selected at build time
+// (see BIGNUM_BACKEND in CMakeLists.txt).
+#if defined(CALCULATOR_BIGNUM_GMP)
+using Integer_t = boost::multiprecision::mpz_int;
+using Rational_t = boost::multiprecision::mpq_rational;
+#elif defined(CALCULATOR_BIGNUM_CHECKED)
+// fixed precision integers which throw std::overflow_error instead of
+// growing beyond 1024 bits.
+using IntegerBackend_t = boost::multiprecision::cpp_int_backend<
+    1024, 1024, boost::multiprecision::signed_magnitude,
+    boost::multiprecision::checked, void>;
+using Integer_t = boost::multiprecision::number<IntegerBackend_t>;
+using Rational_t = boost::multiprecision::number<
+    boost::multiprecision::rational_adaptor<IntegerBackend_t>>;
+#else
+// cpp_int with its limbs allocated from the thread-local LimbPool.
+using IntegerBackend_t = boost::multiprecision::cpp_int_backend<
+    0, 0, boost::multiprecision::signed_magnitude,
+    boost::multiprecision::unchecked,
+    LimbAllocator<boost::multiprecision::limb_type>>;
+using Integer_t = boost::multiprecision::number<IntegerBackend_t>;
+using Rational_t = boost::multiprecision::number<
+    boost::multiprecision::rational_adaptor<IntegerBackend_t>>;
+#endif
+
+#if defined(__SIZEOF_INT128__)
+/** Wide_t holds the intermediate results of the arithmetic with small
+ fractions. Products of two 64 bit integers always fit. */
+using Wide_t = __int128;
+#else
+// without a 128 bit integer type the intermediate results are checked for
+// overflow and computed with Rational_t if they do not fit.
+using Wide_t = std::int64_t;
+#endif
 
 /** NumberRepr represents an actual number.
 
  A number is either a fraction with denominator and numerator (with arbitrary
  precision) or it is a floating point number.
+
+ Fractions whose numerator and denominator fit into 64 bits are stored inline
+ and calculated with overflow-checked machine arithmetic. Only if a result
+ does not fit, it is promoted to a Rational_t, which is allocated only then
+ and shared between copies. A fraction is always stored in the small form if
+ possible, so equal numbers have the same representation.
  */
 class NumberRepr {
 public:
   explicit NumberRepr();
   explicit NumberRepr(const std::string &s);
   explicit NumberRepr(long num, long denom = 1l) { SetFromInt(num, denom); }
-  explicit NumberRepr(const Rational_t &rat) {
-    isFraction = true;
-    isValid = true;
-    rational = rat;
+  explicit NumberRepr(const Rational_t &rat) : isValid(true) {
+    setRational(rat);
   }
 
-  explicit NumberRepr(const Integer_t &i) {
-    isFraction = true;
-    isValid = true;
-    rational = i;
+  explicit NumberRepr(const Integer_t &i) : isValid(true) {
+    setRational(Rational_t(i));
   }
 
   explicit NumberRepr(double l) { SetFromDouble(l); }
@@ -67,31 +109,57 @@ public:
 
    Note, the result is only useful if IsFraction() is true. */
   Integer_t Numerator() const {
-    return boost::multiprecision::numerator(rational);
+    if (isSmall) {
+      return Integer_t(small_num);
+    }
+    return boost::multiprecision::numerator(*rational);
   }
 
   /** Denominator returns the denominator of the fraction.
 
    Note, the result is only useful if IsFraction() is true. */
   Integer_t Denominator() const {
-    return boost::multiprecision::denominator(rational);
+    if (isSmall) {
+      return Integer_t(small_denom);
+    }
+    return boost::multiprecision::denominator(*rational);
   }
 
+  /** IsSmall returns true if this number is a fraction which is stored with
+   64 bit numerator and denominator. */
+  bool IsSmall() const { return isFraction && isSmall; }
+
   bool operator==(const NumberRepr &n) const;
   bool operator!=(const NumberRepr &n) const { return !(*this == n); }
 
-  bool operator<(const NumberRepr &n);
-  bool operator>(const NumberRepr &n);
+  bool operator<(const NumberRepr &n) const;
+  bool operator>(const NumberRepr &n) const;
+
+  /** Hash returns a hash value of this number. Numbers which are equal have
+   the same hash. */
+  std::size_t Hash() const;
 
   static NumberRepr Pow(const NumberRepr &base, const NumberRepr &exp);
 
+  /** Backend returns the name of the arbitrary precision backend. */
+  static const char *Backend();
+
   void ToLatex(std::ostream &s) const;
 
 private:
+  Rational_t toRational() const;
+  void setRational(const Rational_t &rat);
+  bool setSmall(Wide_t num, Wide_t denom);
+
   double value_double;     ///< if isFraction==false, the value of this number
   bool isFraction = false; ///< determines if this number is a fration or not
   bool isValid = true;     ///< determines if the number is valid
-  Rational_t rational;     ///< if isFraction==true, the value of this number
+  bool isSmall = false;    ///< determines if the fraction is stored inline
+  std::int64_t small_num = 0;   ///< if isSmall==true, the numerator
+  std::int64_t small_denom = 1; ///< if isSmall==true, the denominator
+  /// if isFraction==true and isSmall==false, the value. It is never modified,
+  /// so copies of this number share it.
+  std::shared_ptr<const Rational_t> rational;
 };
 
 inline NumberRepr operator+(NumberRepr lhs, const NumberRepr &rhs) {
@@ -40,7 +40,7 @@ NodePtr Parser::Parse(const std::string &expr) {
 
 NodePtr Parser::parseSummand() {
   auto first = parseFactor();
-  auto summand = std::make_shared<Summand>(first);
+  auto summand = new_node<Summand>(first);
 
   bool valid = false;
   auto token = readNextToken();
@@ -50,7 +50,7 @@ NodePtr Parser::parseSummand() {
     if (token.Value == "+") {
       summand->AddOp1(next);
     } else {
-      auto m = std::make_shared<UnaryMinus>(next);
+      auto m = new_node<UnaryMinus>(next);
       summand->AddOp1(m);
     }
     valid = true;
@@ -66,7 +66,7 @@ NodePtr Parser::parseSummand() {
 
 NodePtr Parser::parseFactor() {
   auto first = parsePower();
-  auto factor = std::make_shared<Factor>(first);
+  auto factor = new_node<Factor>(first);
 
   bool valid = false;
   auto token = readNextToken();
@@ -76,7 +76,7 @@ NodePtr Parser::parseFactor() {
     if (token.Value == "*") {
       factor->AddOp1(next);
     } else {
-      auto d = std::make_shared<Power>(next, std::make_shared<Number>(-1l));
+      auto d = new_node<Power>(next, new_node<Number>(-1l));
       factor->AddOp1(d);
       // factor->AddOp2(next);
     }
@@ -97,7 +97,7 @@ NodePtr Parser::parsePower() {
   auto token = readNextToken();
   if (token.Type == Token::Type_t::Operator && token.Value == "^") {
     auto exponent = parseNumber();
-    auto power = std::make_shared<Power>(base, exponent);
+    auto power = new_node<Power>(base, exponent);
     return power;
   }
   unreadToken();
@@ -117,7 +117,7 @@ NodePtr Parser::parseNumber() {
     return v;
   }
   if (token.Type == Token::Type_t::Operator && token.Value == "-") {
-    return std::make_shared<UnaryMinus>(parsePower());
+    return new_node<UnaryMinus>(parsePower());
   }
 
   if (token.Type == Token::Type_t::String) {
@@ -128,12 +128,12 @@ NodePtr Parser::parseNumber() {
       unreadToken(); // unread function name
       return parseFunction();
     }
-    return std::make_shared<Variable>(token.Value);
+    return new_node<Variable>(token.Value);
   }
 
   if (token.Type == Token::Type_t::Number) {
     try {
-      return std::make_shared<Number>(Number(token.Value));
+      return new_node<Number>(Number(token.Value));
     } catch (const std::exception &e) {
       throw InputEquationError(token.pos, e.what());
     }
@@ -158,7 +158,7 @@ NodePtr Parser::parseFunction() {
   }
 
   auto first = parseSummand();
-  auto fun = std::make_shared<Function>(name.Value);
+  auto fun = new_node<Function>(name.Value);
   fun->AddArg(first);
 
   auto token = readNextToken();
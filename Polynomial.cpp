@@ -0,0 +1,1299 @@
+//
+//  Copyright © 2017 Lennart Oymanns. All rights reserved.
+//
+#include <algorithm>
+#include <cstring>
+
+#include "Error.h"
+#include "Factor.hpp"
+#include "Number.hpp"
+#include "Polynomial.hpp"
+#include "Power.hpp"
+#include "Summand.hpp"
+#include "UnaryMinus.hpp"
+#include "Variable.hpp"
+
+using namespace Equation;
+
+namespace {
+
+/** kronecker_min_pairs is the smallest number of pairs of terms of a product
+ which is computed by Kronecker substitution. */
+const std::size_t kronecker_min_pairs = 1024;
+
+/** kronecker_density is the smallest ratio of pairs of terms to slots of a
+ product which is computed by Kronecker substitution. */
+const std::size_t kronecker_density = 4;
+
+/** heuristic_gcd_points is the number of evaluation points which are tried
+ by heuristic_gcd. */
+const int heuristic_gcd_points = 6;
+
+std::size_t hash_words(const std::uint64_t *w, std::size_t n) {
+  std::size_t h = 0;
+  for (std::size_t i = 0; i < n; i++) {
+    hash_combine(h, hash_mix(w[i]));
+  }
+  return h;
+}
+
+/** TermTable accumulates the coefficients of terms with the same packed
+ exponents. It is an open addressing hash table of term indices. */
+class TermTable {
+public:
+  TermTable(std::size_t words, std::size_t expected) : words(words) {
+    std::size_t capacity = 16;
+    while (capacity < 2 * expected) {
+      capacity *= 2;
+    }
+    slots.assign(capacity, 0);
+    keys.reserve(expected * words);
+    values.reserve(expected);
+  }
+
+  /** Get returns the coefficient of the term with exponents key. A new term
+   has the coefficient 0. */
+  Integer_t &Get(const std::uint64_t *key) {
+    auto mask = slots.size() - 1;
+    for (auto i = hash_words(key, words) & mask;; i = (i + 1) & mask) {
+      auto s = slots[i];
+      if (s == 0) {
+        slots[i] = values.size() + 1;
+        keys.insert(keys.end(), key, key + words);
+        values.emplace_back(0);
+        if (2 * values.size() > slots.size()) {
+          grow();
+        }
+        return values.back();
+      }
+      if (std::memcmp(&keys[(s - 1) * words], key,
+                      words * sizeof(std::uint64_t)) == 0) {
+        return values[s - 1];
+      }
+    }
+  }
+
+  std::size_t Size() const { return values.size(); }
+  const std::uint64_t *Key(std::size_t i) const { return &keys[i * words]; }
+  const Integer_t &Value(std::size_t i) const { return values[i]; }
+
+private:
+  void grow() {
+    slots.assign(2 * slots.size(), 0);
+    auto mask = slots.size() - 1;
+    for (std::size_t k = 0; k < values.size(); k++) {
+      auto i = hash_words(Key(k), words) & mask;
+      while (slots[i] != 0) {
+        i = (i + 1) & mask;
+      }
+      slots[i] = k + 1;
+    }
+  }
+
+  std::size_t words;
+  std::vector<std::size_t> slots; ///< index + 1 of the term, 0 if empty
+  std::vector<std::uint64_t> keys;
+  std::vector<Integer_t> values;
+};
+
+/** integer_coefficients returns the coefficients of p multiplied by the
+ least common multiple den of their denominators. */
+std::vector<Integer_t> integer_coefficients(const Polynomial &p,
+                                            Integer_t *den) {
+  *den = 1;
+  for (std::size_t t = 0; t < p.NumTerms(); t++) {
+    const auto &d = boost::multiprecision::denominator(p.Coefficient(t));
+    if (d != 1) {
+      *den = boost::multiprecision::lcm(*den, d);
+    }
+  }
+  std::vector<Integer_t> c;
+  c.reserve(p.NumTerms());
+  for (std::size_t t = 0; t < p.NumTerms(); t++) {
+    const auto &r = p.Coefficient(t);
+    if (*den == 1) {
+      c.push_back(boost::multiprecision::numerator(r));
+    } else {
+      c.push_back(boost::multiprecision::numerator(r) *
+                  (*den / boost::multiprecision::denominator(r)));
+    }
+  }
+  return c;
+}
+
+std::size_t max_bits(const std::vector<Integer_t> &c) {
+  std::size_t bits = 0;
+  for (const auto &i : c) {
+    if (i != 0) {
+      bits = std::max<std::size_t>(bits, msb(Integer_t(abs(i))) + 1);
+    }
+  }
+  return bits;
+}
+
+/** to_limbs writes the magnitude of i to the 64 bit words starting at
+ limbs, least significant word first. There must be enough space. */
+void to_limbs(const Integer_t &i, std::uint64_t *limbs) {
+#if defined(CALCULATOR_BIGNUM_GMP)
+  mpz_export(limbs, nullptr, -1, sizeof(std::uint64_t), 0, 0,
+             i.backend().data());
+#else
+  // export_bits writes the magnitude.
+  export_bits(i, limbs, 64, false);
+#endif
+}
+
+/** from_limbs returns the integer of n 64 bit words, least significant word
+ first. */
+Integer_t from_limbs(const std::uint64_t *limbs, std::size_t n) {
+  Integer_t i;
+#if defined(CALCULATOR_BIGNUM_GMP)
+  mpz_import(i.backend().data(), n, -1, sizeof(std::uint64_t), 0, 0, limbs);
+#else
+  import_bits(i, limbs, limbs + n, 64, false);
+#endif
+  return i;
+}
+
+/** kronecker_slots returns the number of slots of the Kronecker substitution
+ of a*b (see Polynomial::multiplyKronecker) or 0 if the product should be
+ computed term by term. Kronecker substitution pays off if there are many
+ more pairs of terms than slots, i.e. if the product is dense. */
+std::size_t kronecker_slots(const Polynomial &a, const Polynomial &b) {
+#if defined(CALCULATOR_BIGNUM_CHECKED)
+  // the packed integers do not fit into fixed precision integers.
+  return 0;
+#else
+  auto pairs = a.NumTerms() * b.NumTerms();
+  if (pairs < kronecker_min_pairs) {
+    return 0;
+  }
+  std::size_t slots = 1;
+  for (std::size_t v = 0; v < a.NumVariables(); v++) {
+    slots *= a.Degree(v) + b.Degree(v) + 1;
+    if (slots > pairs / kronecker_density) {
+      return 0;
+    }
+  }
+  return slots;
+#endif
+}
+
+/** IntegerPolynomial is a polynomial with integer coefficients and the
+ terms of a Polynomial. The heuristic gcd works with these, since it only
+ needs integers and rational arithmetic is much slower. */
+struct IntegerPolynomial {
+  IntegerPolynomial(std::size_t vars)
+      : vars(vars), words(Polynomial::Words(vars)) {}
+
+  /** IntegerPolynomial returns p, whose coefficients have to be integers. */
+  explicit IntegerPolynomial(const Polynomial &p)
+      : IntegerPolynomial(p.NumVariables()) {
+    exps.reserve(p.NumTerms() * words);
+    coeffs.reserve(p.NumTerms());
+    for (std::size_t t = 0; t < p.NumTerms(); t++) {
+      append(p.Monomial(t), boost::multiprecision::numerator(p.Coefficient(t)));
+    }
+  }
+
+  std::size_t NumTerms() const { return coeffs.size(); }
+  bool IsZero() const { return coeffs.empty(); }
+  const std::uint64_t *Monomial(std::size_t t) const {
+    return exps.data() + t * words;
+  }
+  unsigned Exponent(std::size_t t, std::size_t var) const {
+    return Polynomial::GetExponent(Monomial(t), var);
+  }
+  unsigned Degree(std::size_t var) const {
+    unsigned d = 0;
+    for (std::size_t t = 0; t < NumTerms(); t++) {
+      d = std::max(d, Exponent(t, var));
+    }
+    return d;
+  }
+  void append(const std::uint64_t *e, const Integer_t &c) {
+    exps.insert(exps.end(), e, e + words);
+    coeffs.push_back(c);
+  }
+
+  std::size_t vars;
+  std::size_t words;
+  std::vector<std::uint64_t> exps;
+  std::vector<Integer_t> coeffs;
+};
+
+int compare_words(const std::uint64_t *a, const std::uint64_t *b,
+                  std::size_t words) {
+  for (std::size_t i = 0; i < words; i++) {
+    if (a[i] != b[i]) {
+      return a[i] < b[i] ? -1 : 1;
+    }
+  }
+  return 0;
+}
+
+Integer_t content(const IntegerPolynomial &p) {
+  Integer_t c = 0;
+  for (std::size_t t = 0; t < p.NumTerms() && c != 1; t++) {
+    c = gcd(c, p.coeffs[t]);
+  }
+  return c;
+}
+
+/** max_norm returns the largest magnitude of the coefficients of p. */
+Integer_t max_norm(const IntegerPolynomial &p) {
+  Integer_t norm = 0;
+  for (const auto &c : p.coeffs) {
+    if (abs(c) > norm) {
+      norm = abs(c);
+    }
+  }
+  return norm;
+}
+
+void divide_coefficients(IntegerPolynomial *p, const Integer_t &d) {
+  if (d != 1) {
+    for (auto &c : p->coeffs) {
+      c /= d;
+    }
+  }
+}
+
+/** evaluate returns p with the variable var replaced by x. */
+IntegerPolynomial evaluate(const IntegerPolynomial &p, std::size_t var,
+                           const Integer_t &x) {
+  auto degree = p.Degree(var);
+  if (degree == 0) {
+    return p;
+  }
+  std::vector<Integer_t> powers(degree + 1);
+  powers[0] = 1;
+  for (unsigned k = 1; k <= degree; k++) {
+    powers[k] = powers[k - 1] * x;
+  }
+
+  // the terms without var are not sorted any more, so equal terms are
+  // collected after sorting.
+  auto words = p.words;
+  std::vector<std::uint64_t> keys(p.exps);
+  std::vector<std::size_t> order(p.NumTerms());
+  for (std::size_t t = 0; t < order.size(); t++) {
+    Polynomial::SetExponent(&keys[t * words], var, 0);
+    order[t] = t;
+  }
+  std::sort(order.begin(), order.end(),
+            [&keys, words](std::size_t a, std::size_t b) {
+              return compare_words(&keys[a * words], &keys[b * words],
+                                   words) > 0;
+            });
+  IntegerPolynomial result(p.vars);
+  for (std::size_t i = 0; i < order.size();) {
+    const auto *key = &keys[order[i] * words];
+    Integer_t c = 0;
+    for (; i < order.size() &&
+           compare_words(&keys[order[i] * words], key, words) == 0;
+         i++) {
+      c += p.coeffs[order[i]] * powers[p.Exponent(order[i], var)];
+    }
+    if (c != 0) {
+      result.append(key, c);
+    }
+  }
+  return result;
+}
+
+/** interpolate returns the polynomial in var whose coefficients are the
+ digits of the coefficients of h in base x, e.g. 7*y+12 with x = 10 becomes
+ (var+1)*y + var + 2. The digits are in (-x/2, x/2]. */
+IntegerPolynomial interpolate(IntegerPolynomial h, const Integer_t &x,
+                              std::size_t var) {
+  IntegerPolynomial result(h.vars);
+  Integer_t half = x / 2;
+  std::vector<std::uint64_t> e(h.words);
+  // the digits of higher powers of var come first.
+  std::vector<IntegerPolynomial> digits;
+  while (!h.IsZero() && digits.size() <= Polynomial::MaxExponent) {
+    IntegerPolynomial digit(h.vars), rest(h.vars);
+    for (std::size_t t = 0; t < h.NumTerms(); t++) {
+      const auto &c = h.coeffs[t];
+      Integer_t r = c % x;
+      if (r < 0) {
+        r += x;
+      }
+      if (r > half) {
+        r -= x;
+      }
+      if (r != 0) {
+        std::copy(h.Monomial(t), h.Monomial(t) + h.words, e.begin());
+        Polynomial::SetExponent(e.data(), var, digits.size());
+        digit.append(e.data(), r);
+      }
+      if (c != r) {
+        rest.append(h.Monomial(t), Integer_t((c - r) / x));
+      }
+    }
+    digits.push_back(std::move(digit));
+    h = std::move(rest);
+  }
+  for (auto it = digits.rbegin(); it != digits.rend(); it++) {
+    result.exps.insert(result.exps.end(), it->exps.begin(), it->exps.end());
+    result.coeffs.insert(result.coeffs.end(), it->coeffs.begin(),
+                         it->coeffs.end());
+  }
+  return result;
+}
+
+/** divides returns true if d divides p. The coefficients of the quotient
+ are integers if d is primitive (Gauss's lemma). As in Polynomial::Divide,
+ the leading term of d has to divide the leading term of every remainder. */
+bool divides(const IntegerPolynomial &d, const IntegerPolynomial &p) {
+  auto vars = p.vars, words = p.words;
+  std::vector<unsigned> degree(vars), lead(vars), extra(vars);
+  for (std::size_t v = 0; v < vars; v++) {
+    degree[v] = p.Degree(v);
+    lead[v] = d.Exponent(0, v);
+    extra[v] = d.Degree(v);
+    if (degree[v] < extra[v]) {
+      return false;
+    }
+  }
+  IntegerPolynomial r = p;
+  std::vector<std::uint64_t> e(words), de(words);
+  Integer_t q, rem;
+  while (!r.IsZero()) {
+    for (std::size_t v = 0; v < vars; v++) {
+      auto k = r.Exponent(0, v);
+      if (k < lead[v] || k - lead[v] + extra[v] > degree[v]) {
+        return false;
+      }
+    }
+    divide_qr(r.coeffs[0], d.coeffs[0], q, rem);
+    if (rem != 0) {
+      return false;
+    }
+    // no exponent borrows from its neighbour.
+    for (std::size_t w = 0; w < words; w++) {
+      e[w] = r.Monomial(0)[w] - d.Monomial(0)[w];
+    }
+    // r - q * x^e * d; the leading terms cancel.
+    IntegerPolynomial next(vars);
+    std::size_t i = 1, j = 1;
+    while (i < r.NumTerms() || j < d.NumTerms()) {
+      int c = 1;
+      if (j < d.NumTerms()) {
+        for (std::size_t w = 0; w < words; w++) {
+          de[w] = d.Monomial(j)[w] + e[w];
+        }
+        c = i < r.NumTerms() ? compare_words(r.Monomial(i), de.data(), words)
+                             : -1;
+      }
+      if (c > 0) {
+        next.append(r.Monomial(i), r.coeffs[i]);
+        i++;
+      } else if (c < 0) {
+        next.append(de.data(), Integer_t(-q * d.coeffs[j]));
+        j++;
+      } else {
+        Integer_t sum = r.coeffs[i] - q * d.coeffs[j];
+        if (sum != 0) {
+          next.append(de.data(), sum);
+        }
+        i++;
+        j++;
+      }
+    }
+    r = std::move(next);
+  }
+  return true;
+}
+
+/** heuristic_gcd returns the gcd of the non-zero polynomials f and g which
+ do not depend on the variables before var.
+
+ The polynomials are evaluated at an integer x of variable var, which is
+ larger than twice the coefficients of the gcd, and the gcd h of the values
+ is computed recursively. The coefficients of the gcd are then the digits of
+ h in base x (see interpolate). The candidate is the gcd if it divides f and
+ g; otherwise a larger x is tried. found is false if all points fail. This
+ is the algorithm of Char, Geddes and Gonnet. */
+IntegerPolynomial heuristic_gcd(IntegerPolynomial f, IntegerPolynomial g,
+                                std::size_t var, bool *found) {
+  while (var < f.vars && f.Degree(var) == 0 && g.Degree(var) == 0) {
+    var++;
+  }
+  if (var == f.vars) {
+    *found = true;
+    IntegerPolynomial c(f.vars);
+    c.append(f.Monomial(0), gcd(f.coeffs[0], g.coeffs[0]));
+    return c;
+  }
+
+  Integer_t common = gcd(content(f), content(g));
+  divide_coefficients(&f, common);
+  divide_coefficients(&g, common);
+  Integer_t nf = max_norm(f), ng = max_norm(g);
+  Integer_t bound = 2 * (nf < ng ? nf : ng) + 29;
+  Integer_t root = 99 * sqrt(bound);
+  Integer_t x = bound < root ? bound : root;
+  Integer_t lf = nf / abs(f.coeffs[0]);
+  Integer_t lg = ng / abs(g.coeffs[0]);
+  Integer_t lower = 2 * (lf < lg ? lf : lg) + 2;
+  if (x < lower) {
+    x = lower;
+  }
+
+  for (int i = 0; i < heuristic_gcd_points; i++) {
+    auto ff = evaluate(f, var, x);
+    auto gg = evaluate(g, var, x);
+    if (!ff.IsZero() && !gg.IsZero()) {
+      bool ok = false;
+      auto h = heuristic_gcd(std::move(ff), std::move(gg), var + 1, &ok);
+      if (ok) {
+        h = interpolate(std::move(h), x, var);
+        divide_coefficients(&h, content(h));
+        if (divides(h, f) && divides(h, g)) {
+          *found = true;
+          for (auto &c : h.coeffs) {
+            c *= common;
+          }
+          return h;
+        }
+      }
+    }
+    x = Integer_t(x * 73794 * sqrt(sqrt(x)) / 27011);
+  }
+  *found = false;
+  return IntegerPolynomial(f.vars);
+}
+
+Rational_t rational(const NumberRepr &n) {
+  return Rational_t(n.Numerator(), n.Denominator());
+}
+
+/** integer_exponent returns the exponent of the power n if it is an integer
+ in [-MaxExponent, MaxExponent], otherwise 0. */
+int integer_exponent(const NodePtr &n) {
+  if (n->Type() != Node::Type_t::Power) {
+    return 0;
+  }
+  const auto &e = std::static_pointer_cast<Power>(n)->Exponent();
+  if (e->Type() != Node::Type_t::Number) {
+    return 0;
+  }
+  auto v = std::static_pointer_cast<Number>(e)->GetValue();
+  if (!v.IsFraction() || v.Denominator() != 1 ||
+      abs(v.Numerator()) > Polynomial::MaxExponent) {
+    return 0;
+  }
+  return v.Numerator().convert_to<int>();
+}
+
+/** natural_exponent returns the exponent of the power n if it is an integer
+ in [1, MaxExponent], otherwise 0. */
+unsigned natural_exponent(const NodePtr &n) {
+  auto e = integer_exponent(n);
+  return e > 0 ? unsigned(e) : 0;
+}
+
+/** power returns g^e. Numerical exponents of g are multiplied, e.g.
+ (x^(1/2))^2 = x. */
+NodePtr power(const NodePtr &g, unsigned e) {
+  if (g->Type() == Node::Type_t::Power) {
+    auto p = std::static_pointer_cast<Power>(g);
+    if (p->Exponent()->Type() == Node::Type_t::Number) {
+      auto r = std::static_pointer_cast<Number>(p->Exponent())->GetValue() *
+               NumberRepr(long(e));
+      if (r == NumberRepr(1l)) {
+        return p->Base()->clone();
+      }
+      return new_node<Power>(p->Base()->clone(), new_node<Number>(r));
+    }
+  }
+  return new_node<Power>(g->clone(), new_node<Number>(long(e)));
+}
+
+bool is_fraction(const NodePtr &n) {
+  return std::static_pointer_cast<Number>(n)->GetValue().IsFraction();
+}
+
+} // namespace
+
+const unsigned Polynomial::MaxExponent;
+
+Polynomial Polynomial::Constant(const Rational_t &c, std::size_t variables) {
+  std::vector<std::uint64_t> e(Words(variables), 0);
+  return Term(e.data(), c, variables);
+}
+
+Polynomial Polynomial::Generator(std::size_t var, std::size_t variables) {
+  std::vector<std::uint64_t> e(Words(variables), 0);
+  SetExponent(e.data(), var, 1);
+  return Term(e.data(), Rational_t(1), variables);
+}
+
+Polynomial Polynomial::Term(const std::uint64_t *e, const Rational_t &c,
+                            std::size_t variables) {
+  Polynomial p(variables);
+  if (c != 0) {
+    p.append(e, c);
+  }
+  return p;
+}
+
+unsigned Polynomial::Degree(std::size_t var) const {
+  unsigned d = 0;
+  for (std::size_t t = 0; t < NumTerms(); t++) {
+    d = std::max(d, Exponent(t, var));
+  }
+  return d;
+}
+
+bool Polynomial::IsConstant() const {
+  if (NumTerms() > 1) {
+    return false;
+  }
+  for (std::size_t w = 0; w < exps.size(); w++) {
+    if (exps[w] != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+Rational_t Polynomial::Content() const {
+  if (IsZero()) {
+    return Rational_t(0);
+  }
+  Integer_t num = 0, den = 1;
+  for (const auto &c : coeffs) {
+    num = gcd(num, Integer_t(boost::multiprecision::numerator(c)));
+    const auto &d = boost::multiprecision::denominator(c);
+    if (d != 1) {
+      den = boost::multiprecision::lcm(den, d);
+    }
+  }
+  Rational_t content(num, den);
+  return coeffs[0] < 0 ? Rational_t(-content) : content;
+}
+
+/** Divide divides the leading terms until the remainder is zero. If d
+ divides this polynomial, every remainder is a multiple of d, so the leading
+ term of d divides the leading term of the remainder and no variable has a
+ larger degree than in this polynomial. */
+bool Polynomial::Divide(const Polynomial &d, Polynomial *q) const {
+  if (d.IsConstant()) {
+    *q = *this * (Rational_t(1) / d.coeffs[0]);
+    return true;
+  }
+  std::vector<unsigned> degree(vars), lead(vars);
+  for (std::size_t v = 0; v < vars; v++) {
+    degree[v] = Degree(v);
+    lead[v] = d.Exponent(0, v);
+    if (!IsZero() && degree[v] < d.Degree(v)) {
+      return false;
+    }
+  }
+  std::vector<unsigned> extra(vars);
+  for (std::size_t v = 0; v < vars; v++) {
+    extra[v] = d.Degree(v);
+  }
+
+  Polynomial quotient(vars);
+  Polynomial r = *this;
+  std::vector<std::uint64_t> e(words);
+  while (!r.IsZero()) {
+    for (std::size_t v = 0; v < vars; v++) {
+      auto k = r.Exponent(0, v);
+      if (k < lead[v] || k - lead[v] + extra[v] > degree[v]) {
+        return false;
+      }
+    }
+    // no exponent borrows from its neighbour.
+    for (std::size_t w = 0; w < words; w++) {
+      e[w] = r.Monomial(0)[w] - d.Monomial(0)[w];
+    }
+    auto t = Term(e.data(), r.coeffs[0] / d.coeffs[0], vars);
+    quotient.append(e.data(), t.coeffs[0]);
+    r = r - t * d;
+  }
+  *q = quotient;
+  return true;
+}
+
+Polynomial Polynomial::Gcd(const Polynomial &a, const Polynomial &b) {
+  if (a.IsZero()) {
+    return b.IsZero() ? b : b * (Rational_t(1) / b.Content());
+  }
+  if (b.IsZero()) {
+    return a * (Rational_t(1) / a.Content());
+  }
+  if (a.IsConstant() || b.IsConstant()) {
+    return Constant(Rational_t(1), a.vars);
+  }
+  if (a.NumTerms() == 1 || b.NumTerms() == 1) {
+    // the gcd with a monomial is the monomial of the smallest exponents.
+    std::vector<std::uint64_t> e(a.Monomial(0), a.Monomial(0) + a.words);
+    for (const auto *p : {&a, &b}) {
+      for (std::size_t t = 0; t < p->NumTerms(); t++) {
+        for (std::size_t v = 0; v < a.vars; v++) {
+          if (p->Exponent(t, v) < GetExponent(e.data(), v)) {
+            SetExponent(e.data(), v, p->Exponent(t, v));
+          }
+        }
+      }
+    }
+    return Term(e.data(), Rational_t(1), a.vars);
+  }
+  bool common = false;
+  for (std::size_t v = 0; v < a.vars && !common; v++) {
+    common = a.Degree(v) > 0 && b.Degree(v) > 0;
+  }
+  if (!common) {
+    return Constant(Rational_t(1), a.vars);
+  }
+  auto pa = a * (Rational_t(1) / a.Content());
+  auto pb = b * (Rational_t(1) / b.Content());
+  if (pa == pb) {
+    return pa;
+  }
+  bool found = false;
+  auto g = heuristic_gcd(IntegerPolynomial(pa), IntegerPolynomial(pb), 0,
+                         &found);
+  if (!found) {
+    return Constant(Rational_t(1), a.vars);
+  }
+  // g is primitive; its sign follows the leading coefficient.
+  Polynomial result(a.vars);
+  bool negative = g.coeffs[0] < 0;
+  for (std::size_t t = 0; t < g.NumTerms(); t++) {
+    result.append(g.Monomial(t),
+                  Rational_t(negative ? Integer_t(-g.coeffs[t]) : g.coeffs[t]));
+  }
+  return result;
+}
+
+int Polynomial::compare(const std::uint64_t *a, const std::uint64_t *b) const {
+  for (std::size_t i = 0; i < words; i++) {
+    if (a[i] != b[i]) {
+      return a[i] < b[i] ? -1 : 1;
+    }
+  }
+  return 0;
+}
+
+void Polynomial::append(const std::uint64_t *e, const Rational_t &c) {
+  exps.insert(exps.end(), e, e + words);
+  coeffs.push_back(c);
+}
+
+void Polynomial::checkDegree(const Polynomial &p) const {
+  for (std::size_t v = 0; v < vars; v++) {
+    if (Degree(v) + p.Degree(v) > MaxExponent) {
+      throw InputError(0, "exponent of polynomial too large");
+    }
+  }
+}
+
+Polynomial Polynomial::operator+(const Polynomial &p) const {
+  Polynomial result(vars);
+  result.exps.reserve(exps.size() + p.exps.size());
+  result.coeffs.reserve(coeffs.size() + p.coeffs.size());
+  std::size_t i = 0, j = 0;
+  while (i < NumTerms() && j < p.NumTerms()) {
+    int c = compare(Monomial(i), p.Monomial(j));
+    if (c > 0) {
+      result.append(Monomial(i), coeffs[i]);
+      i++;
+    } else if (c < 0) {
+      result.append(p.Monomial(j), p.coeffs[j]);
+      j++;
+    } else {
+      Rational_t sum = coeffs[i] + p.coeffs[j];
+      if (sum != 0) {
+        result.append(Monomial(i), sum);
+      }
+      i++;
+      j++;
+    }
+  }
+  for (; i < NumTerms(); i++) {
+    result.append(Monomial(i), coeffs[i]);
+  }
+  for (; j < p.NumTerms(); j++) {
+    result.append(p.Monomial(j), p.coeffs[j]);
+  }
+  return result;
+}
+
+Polynomial Polynomial::operator-() const {
+  Polynomial result(*this);
+  for (auto &c : result.coeffs) {
+    c = -c;
+  }
+  return result;
+}
+
+Polynomial Polynomial::operator-(const Polynomial &p) const {
+  return *this + (-p);
+}
+
+Polynomial Polynomial::operator*(const Rational_t &c) const {
+  if (c == 0) {
+    return Polynomial(vars);
+  }
+  Polynomial result(*this);
+  if (c != 1) {
+    for (auto &k : result.coeffs) {
+      k *= c;
+    }
+  }
+  return result;
+}
+
+/** operator* multiplies this polynomial with p. Products with a single term
+ shift the exponents of the other polynomial. Dense products with many terms
+ are multiplied by Kronecker substitution, all other products term by term
+ (see multiplyTable and multiplyKronecker). */
+Polynomial Polynomial::operator*(const Polynomial &p) const {
+  Polynomial result(vars);
+  if (IsZero() || p.IsZero()) {
+    return result;
+  }
+  checkDegree(p);
+  const Polynomial &a = NumTerms() >= p.NumTerms() ? *this : p;
+  const Polynomial &b = NumTerms() >= p.NumTerms() ? p : *this;
+
+  if (b.NumTerms() == 1) {
+    // adding the same exponents to all terms keeps their order.
+    std::vector<std::uint64_t> e(words);
+    result.exps.reserve(a.exps.size());
+    result.coeffs.reserve(a.coeffs.size());
+    for (std::size_t t = 0; t < a.NumTerms(); t++) {
+      for (std::size_t w = 0; w < words; w++) {
+        e[w] = a.Monomial(t)[w] + b.Monomial(0)[w];
+      }
+      result.append(e.data(), a.coeffs[t] * b.coeffs[0]);
+    }
+    return result;
+  }
+  if (kronecker_slots(a, b) > 0) {
+    return multiplyKronecker(a, b);
+  }
+  return multiplyTable(a, b);
+}
+
+/** multiplyTable multiplies every term of a with every term of b. The
+ products are accumulated in a hash table with integer coefficients (both
+ polynomials are scaled by the common denominators of their coefficients)
+ and sorted once at the end. */
+Polynomial Polynomial::multiplyTable(const Polynomial &a,
+                                     const Polynomial &b) {
+  auto words = a.words;
+  Integer_t da, db;
+  auto ca = integer_coefficients(a, &da);
+  auto cb = integer_coefficients(b, &db);
+  TermTable table(words, a.NumTerms() * 2);
+  std::vector<std::uint64_t> e(words);
+  for (std::size_t i = 0; i < a.NumTerms(); i++) {
+    for (std::size_t j = 0; j < b.NumTerms(); j++) {
+      for (std::size_t w = 0; w < words; w++) {
+        e[w] = a.Monomial(i)[w] + b.Monomial(j)[w];
+      }
+      table.Get(e.data()) += ca[i] * cb[j];
+    }
+  }
+
+  std::vector<std::size_t> order(table.Size());
+  for (std::size_t k = 0; k < order.size(); k++) {
+    order[k] = k;
+  }
+  std::sort(order.begin(), order.end(),
+            [&a, &table](std::size_t x, std::size_t y) {
+              return a.compare(table.Key(x), table.Key(y)) > 0;
+            });
+  Polynomial result(a.vars);
+  Integer_t den = da * db;
+  result.exps.reserve(order.size() * words);
+  result.coeffs.reserve(order.size());
+  for (auto k : order) {
+    const auto &c = table.Value(k);
+    if (c == 0) {
+      continue;
+    }
+    result.append(table.Key(k), den == 1 ? Rational_t(c) : Rational_t(c, den));
+  }
+  return result;
+}
+
+/** multiplyKronecker maps the polynomials to integers and multiplies them.
+
+ With the degree bounds d_i = deg_i(a) + deg_i(b) + 1, a term x^e becomes
+ the slot k = sum e_i * s_i with the strides s_i = d_(i+1) * ... * d_(n-1),
+ i.e. the exponents of the product do not overlap. Every slot has L limbs,
+ enough for any coefficient of the product with a sign bit; the polynomial
+ is the integer sum c_k * 2^(64 L k). The big integer multiplication (which
+ is sub-quadratic for large numbers) then computes all coefficients at
+ once. Negative coefficients borrow from the next slot, so the slots of the
+ product are read as signed digits. */
+Polynomial Polynomial::multiplyKronecker(const Polynomial &a,
+                                         const Polynomial &b) {
+  auto vars = a.vars;
+  std::vector<std::size_t> stride(vars);
+  std::size_t slots = 1;
+  for (std::size_t v = vars; v-- > 0;) {
+    stride[v] = slots;
+    slots *= a.Degree(v) + b.Degree(v) + 1;
+  }
+  auto slot = [&stride, vars](const std::uint64_t *e) {
+    std::size_t k = 0;
+    for (std::size_t v = 0; v < vars; v++) {
+      k += GetExponent(e, v) * stride[v];
+    }
+    return k;
+  };
+
+  Integer_t da, db;
+  auto ca = integer_coefficients(a, &da);
+  auto cb = integer_coefficients(b, &db);
+  std::size_t bits = max_bits(ca) + max_bits(cb) +
+                     msb(Integer_t(std::min(a.NumTerms(), b.NumTerms()))) + 2;
+  std::size_t limbs = (bits + 63) / 64;
+
+  auto pack = [&slot, slots, limbs](const Polynomial &p,
+                                    const std::vector<Integer_t> &c) {
+    std::vector<std::uint64_t> positive(slots * limbs), negative(slots * limbs);
+    for (std::size_t t = 0; t < p.NumTerms(); t++) {
+      auto &digits = c[t] < 0 ? negative : positive;
+      to_limbs(c[t], &digits[slot(p.Monomial(t)) * limbs]);
+    }
+    return from_limbs(positive.data(), positive.size()) -
+           from_limbs(negative.data(), negative.size());
+  };
+  Integer_t product = pack(a, ca) * pack(b, cb);
+
+  bool negative = product < 0;
+  if (negative) {
+    product = -product;
+  }
+  std::vector<std::uint64_t> digits(slots * limbs + 1);
+  to_limbs(product, digits.data());
+
+  // the coefficients of the slots in increasing order.
+  const Integer_t base = Integer_t(1) << (64 * limbs);
+  const Integer_t half = base >> 1;
+  std::vector<std::pair<std::size_t, Integer_t>> terms;
+  bool carry = false;
+  for (std::size_t k = 0; k < slots; k++) {
+    auto c = from_limbs(&digits[k * limbs], limbs);
+    if (carry) {
+      c += 1;
+    }
+    carry = c >= half;
+    if (carry) {
+      c -= base;
+    }
+    if (c != 0) {
+      terms.emplace_back(k, negative ? Integer_t(-c) : c);
+    }
+  }
+
+  Polynomial result(vars);
+  Integer_t den = da * db;
+  std::vector<std::uint64_t> e(result.words);
+  result.exps.reserve(terms.size() * result.words);
+  result.coeffs.reserve(terms.size());
+  for (auto it = terms.rbegin(); it != terms.rend(); it++) {
+    auto k = it->first;
+    for (std::size_t v = 0; v < vars; v++) {
+      SetExponent(e.data(), v, k / stride[v]);
+      k %= stride[v];
+    }
+    result.append(e.data(), den == 1 ? Rational_t(it->second)
+                                     : Rational_t(it->second, den));
+  }
+  return result;
+}
+
+Polynomial Polynomial::Pow(unsigned e) const {
+  Polynomial result = Constant(Rational_t(1), vars);
+  Polynomial base = *this;
+  while (e > 0) {
+    if (e & 1) {
+      result = result * base;
+    }
+    e >>= 1;
+    if (e > 0) {
+      base = base * base;
+    }
+  }
+  return result;
+}
+
+RationalFunction::RationalFunction(const Polynomial &num)
+    : num(num),
+      den(Polynomial::Constant(Rational_t(1), num.NumVariables())) {}
+
+RationalFunction::RationalFunction(const Polynomial &n, const Polynomial &d) {
+  if (d.IsZero()) {
+    throw InputError(0, "division by zero");
+  }
+  auto g = Polynomial::Gcd(n, d);
+  if (g.IsConstant()) {
+    num = n;
+    den = d;
+  } else {
+    n.Divide(g, &num);
+    d.Divide(g, &den);
+  }
+  normalize();
+}
+
+void RationalFunction::normalize() {
+  auto c = den.Content();
+  if (c != 1) {
+    c = Rational_t(1) / c;
+    num = num * c;
+    den = den * c;
+  }
+}
+
+/** operator+ only multiplies with the parts of the denominators which are
+ not common, i.e. a/(x*y) + b/(x*z) = (a*z + b*y)/(x*y*z). */
+RationalFunction RationalFunction::operator+(const RationalFunction &f) const {
+  if (den == f.den) {
+    if (den.IsConstant()) {
+      RationalFunction sum;
+      sum.num = num + f.num;
+      sum.den = den;
+      return sum;
+    }
+    return RationalFunction(num + f.num, den);
+  }
+  auto g = Polynomial::Gcd(den, f.den);
+  Polynomial a, b;
+  den.Divide(g, &a);
+  f.den.Divide(g, &b);
+  return RationalFunction(num * b + f.num * a, den * b);
+}
+
+RationalFunction RationalFunction::operator-() const {
+  RationalFunction f(*this);
+  f.num = -num;
+  return f;
+}
+
+/** operator* cancels the common factors of each numerator with the other
+ denominator before multiplying. */
+RationalFunction RationalFunction::operator*(const RationalFunction &f) const {
+  auto g1 = Polynomial::Gcd(num, f.den);
+  auto g2 = Polynomial::Gcd(f.num, den);
+  Polynomial a, b, c, d;
+  num.Divide(g1, &a);
+  f.den.Divide(g1, &d);
+  f.num.Divide(g2, &b);
+  den.Divide(g2, &c);
+  RationalFunction product;
+  product.num = a * b;
+  product.den = c * d;
+  product.normalize();
+  return product;
+}
+
+RationalFunction RationalFunction::Pow(int e) const {
+  RationalFunction f;
+  unsigned k = e < 0 ? unsigned(-e) : unsigned(e);
+  if (e >= 0) {
+    f.num = num.Pow(k);
+    f.den = den.Pow(k);
+    return f;
+  }
+  if (num.IsZero()) {
+    throw InputError(0, "division by zero");
+  }
+  f.num = den.Pow(k);
+  f.den = num.Pow(k);
+  f.normalize();
+  return f;
+}
+
+std::size_t PolynomialRing::find(const NodePtr &n) const {
+  auto range = index.equal_range(n->Hash());
+  for (auto it = range.first; it != range.second; it++) {
+    if (generators[it->second]->equals(n)) {
+      return it->second;
+    }
+  }
+  return generators.size();
+}
+
+void PolynomialRing::addGenerator(const NodePtr &n) {
+  if (find(n) == generators.size()) {
+    index.emplace(n->Hash(), generators.size());
+    generators.push_back(n);
+  }
+}
+
+bool PolynomialRing::HasOnlyVariables() const {
+  for (const auto &g : generators) {
+    if (g->Type() != Node::Type_t::Variable ||
+        std::static_pointer_cast<Variable>(g)->Name() == "i") {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool PolynomialRing::Add(const NodePtr &n) {
+  switch (n->Type()) {
+  case Node::Type_t::Number:
+    return is_fraction(n);
+  case Node::Type_t::Summand:
+    for (const auto &e : std::static_pointer_cast<Summand>(n)->Data()) {
+      if (!Add(e)) {
+        return false;
+      }
+    }
+    return true;
+  case Node::Type_t::UnaryMinus:
+    return Add(std::static_pointer_cast<UnaryMinus>(n)->Data());
+  case Node::Type_t::Factor:
+    for (const auto &e : std::static_pointer_cast<Factor>(n)->Data()) {
+      if (!addFactor(e)) {
+        return false;
+      }
+    }
+    return true;
+  default:
+    return addFactor(n);
+  }
+}
+
+bool PolynomialRing::addFactor(const NodePtr &n) {
+  switch (n->Type()) {
+  case Node::Type_t::Number:
+    return is_fraction(n);
+  case Node::Type_t::Summand:
+  case Node::Type_t::Factor:
+  case Node::Type_t::UnaryMinus:
+    return Add(n);
+  case Node::Type_t::Power: {
+    auto e = integer_exponent(n);
+    if (e > 0 || (fractions && e < 0)) {
+      return addFactor(std::static_pointer_cast<Power>(n)->Base());
+    }
+    addGenerator(n);
+    return true;
+  }
+  default:
+    addGenerator(n);
+    return true;
+  }
+}
+
+bool PolynomialRing::Monomial(const NodePtr &n, std::uint64_t *words,
+                              NumberRepr *coeff) const {
+  std::fill(words, words + Polynomial::Words(generators.size()), 0);
+  *coeff = NumberRepr(1l);
+  if (n->Type() == Node::Type_t::UnaryMinus) {
+    if (!Monomial(std::static_pointer_cast<UnaryMinus>(n)->Data(), words,
+                  coeff)) {
+      return false;
+    }
+    *coeff *= NumberRepr(-1l);
+    return true;
+  }
+  auto factor = [this, words, coeff](const NodePtr &e) {
+    if (e->Type() == Node::Type_t::Number) {
+      *coeff *= std::static_pointer_cast<Number>(e)->GetValue();
+      return true;
+    }
+    NodePtr base = e;
+    unsigned exp = natural_exponent(e);
+    if (exp > 0) {
+      base = std::static_pointer_cast<Power>(e)->Base();
+    } else {
+      exp = 1;
+    }
+    auto var = find(base);
+    if (var == generators.size()) {
+      return false;
+    }
+    exp += Polynomial::GetExponent(words, var);
+    if (exp > Polynomial::MaxExponent) {
+      return false;
+    }
+    Polynomial::SetExponent(words, var, exp);
+    return true;
+  };
+  if (n->Type() != Node::Type_t::Factor) {
+    return factor(n);
+  }
+  for (const auto &e : std::static_pointer_cast<Factor>(n)->Data()) {
+    if (!factor(e)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+Polynomial PolynomialRing::generator(const NodePtr &n) const {
+  auto var = find(n);
+  if (var == generators.size()) {
+    throw InputError(0, "unknown generator of polynomial");
+  }
+  return Polynomial::Generator(var, generators.size());
+}
+
+Polynomial PolynomialRing::FromNode(const NodePtr &n) const {
+  auto vars = generators.size();
+  switch (n->Type()) {
+  case Node::Type_t::Number:
+    return Polynomial::Constant(
+        rational(std::static_pointer_cast<Number>(n)->GetValue()), vars);
+  case Node::Type_t::Summand: {
+    Polynomial sum(vars);
+    for (const auto &e : std::static_pointer_cast<Summand>(n)->Data()) {
+      sum = sum + FromNode(e);
+    }
+    return sum;
+  }
+  case Node::Type_t::UnaryMinus:
+    return -FromNode(std::static_pointer_cast<UnaryMinus>(n)->Data());
+  case Node::Type_t::Factor: {
+    std::vector<std::uint64_t> words(Polynomial::Words(vars));
+    NumberRepr c;
+    if (Monomial(n, words.data(), &c)) {
+      return Polynomial::Term(words.data(), rational(c), vars);
+    }
+    auto product = Polynomial::Constant(Rational_t(1), vars);
+    for (const auto &e : std::static_pointer_cast<Factor>(n)->Data()) {
+      product = product * fromFactor(e);
+    }
+    return product;
+  }
+  default:
+    return fromFactor(n);
+  }
+}
+
+Polynomial PolynomialRing::fromFactor(const NodePtr &n) const {
+  switch (n->Type()) {
+  case Node::Type_t::Number:
+  case Node::Type_t::Summand:
+  case Node::Type_t::Factor:
+  case Node::Type_t::UnaryMinus:
+    return FromNode(n);
+  case Node::Type_t::Power: {
+    auto e = natural_exponent(n);
+    if (e == 0) {
+      return generator(n);
+    }
+    return fromFactor(std::static_pointer_cast<Power>(n)->Base()).Pow(e);
+  }
+  default:
+    return generator(n);
+  }
+}
+
+NodePtr PolynomialRing::ToNode(const Polynomial &p) const {
+  if (p.IsZero()) {
+    return new_node<Number>(0l);
+  }
+  auto sum = new_node<Summand>();
+  for (std::size_t t = 0; t < p.NumTerms(); t++) {
+    auto term = new_node<Factor>();
+    NumberRepr c(p.Coefficient(t));
+    if (c != NumberRepr(1l)) {
+      term->AddOp1(new_node<Number>(c));
+    }
+    for (std::size_t v = 0; v < generators.size(); v++) {
+      auto e = p.Exponent(t, v);
+      if (e == 1) {
+        term->AddOp1(generators[v]->clone());
+      } else if (e > 1) {
+        term->AddOp1(power(generators[v], e));
+      }
+    }
+    if (term->Data().size() == 0) {
+      sum->AddOp1(new_node<Number>(c));
+    } else if (term->Data().size() == 1) {
+      sum->AddOp1(term->Data().front());
+    } else {
+      sum->AddOp1(term);
+    }
+  }
+  if (sum->Data().size() == 1) {
+    return sum->Data().front();
+  }
+  return sum;
+}
+
+RationalFunction PolynomialRing::FractionFromNode(const NodePtr &n) const {
+  auto vars = generators.size();
+  switch (n->Type()) {
+  case Node::Type_t::Summand: {
+    RationalFunction sum((Polynomial(vars)));
+    for (const auto &e : std::static_pointer_cast<Summand>(n)->Data()) {
+      sum = sum + FractionFromNode(e);
+    }
+    return sum;
+  }
+  case Node::Type_t::UnaryMinus:
+    return -FractionFromNode(std::static_pointer_cast<UnaryMinus>(n)->Data());
+  case Node::Type_t::Factor: {
+    RationalFunction product(Polynomial::Constant(Rational_t(1), vars));
+    for (const auto &e : std::static_pointer_cast<Factor>(n)->Data()) {
+      product = product * FractionFromNode(e);
+    }
+    return product;
+  }
+  case Node::Type_t::Power: {
+    auto e = integer_exponent(n);
+    if (e == 0) {
+      return RationalFunction(generator(n));
+    }
+    return FractionFromNode(std::static_pointer_cast<Power>(n)->Base()).Pow(e);
+  }
+  default:
+    return RationalFunction(FromNode(n));
+  }
+}
+
+NodePtr PolynomialRing::ToNode(const RationalFunction &f) const {
+  auto num = ToNode(f.Numerator());
+  if (f.Denominator().IsConstant()) {
+    return num;
+  }
+  auto quotient = new_node<Factor>();
+  quotient->AddOp1(num);
+  quotient->AddOp1(new_node<Power>(ToNode(f.Denominator()),
+                                   new_node<Number>(-1l)));
+  return quotient;
+}
+
+NodePtr FuncExpand::Eval(const NodeList &args, bool numeric) {
+  PolynomialRing ring;
+  if (!ring.Add(args[0])) {
+    // floating point numbers are not expanded.
+    return args[0]->clone();
+  }
+  auto result = ring.ToNode(ring.FromNode(args[0]));
+  if (!ring.HasOnlyVariables()) {
+    result->Eval(&result, std::make_shared<DefaultState>());
+  }
+  return result;
+}
+
+NodePtr FuncNormal::Eval(const NodeList &args, bool numeric) {
+  PolynomialRing ring(true);
+  if (!ring.Add(args[0])) {
+    // floating point numbers are not normalized.
+    return args[0]->clone();
+  }
+  auto f = ring.FractionFromNode(args[0]);
+  auto result = ring.ToNode(f);
+  if (!ring.HasOnlyVariables() || !f.Denominator().IsConstant()) {
+    result->Eval(&result, std::make_shared<DefaultState>());
+  }
+  return result;
+}
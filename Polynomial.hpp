@@ -0,0 +1,275 @@
+//
+//  Copyright © 2017 Lennart Oymanns. All rights reserved.
+//
+
+#ifndef Polynomial_hpp
+#define Polynomial_hpp
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "Node.hpp"
+#include "NumberRepr.hpp"
+#include "UserFunction.hpp"
+
+namespace Equation {
+
+/** Polynomial is a sparse multivariate polynomial with rational coefficients.
+
+ The variables are numbered 0, 1, ... (see PolynomialRing for the nodes they
+ stand for). The exponents of a term are packed into 64 bit words with 16
+ bits per variable, variable 0 in the highest bits. Multiplying two terms adds
+ their words and comparing two terms compares their words, i.e. neither
+ depends on the number of variables in a word. The terms are sorted in
+ decreasing lexicographic order of their exponents and all coefficients are
+ non-zero. */
+class Polynomial {
+public:
+  /** MaxExponent is the largest exponent of a variable. */
+  static const unsigned MaxExponent = 0xffff;
+
+  /** Words returns the number of words of the exponents of a term. */
+  static std::size_t Words(std::size_t variables) {
+    return (variables + 3) / 4;
+  }
+
+  /** SetExponent sets the exponent of variable var in the packed words. */
+  static void SetExponent(std::uint64_t *words, std::size_t var, unsigned e) {
+    auto shift = 16 * (3 - var % 4);
+    words[var / 4] &= ~(std::uint64_t(0xffff) << shift);
+    words[var / 4] |= std::uint64_t(e) << shift;
+  }
+
+  /** GetExponent returns the exponent of variable var in the packed words. */
+  static unsigned GetExponent(const std::uint64_t *words, std::size_t var) {
+    return (words[var / 4] >> (16 * (3 - var % 4))) & 0xffff;
+  }
+
+  /** Polynomial returns the zero polynomial in the given number of
+   variables. */
+  explicit Polynomial(std::size_t variables = 0)
+      : vars(variables), words(Words(variables)) {}
+
+  /** Constant returns the constant polynomial c. */
+  static Polynomial Constant(const Rational_t &c, std::size_t variables);
+
+  /** Term returns the polynomial c * x^e with the packed exponents e. */
+  static Polynomial Term(const std::uint64_t *e, const Rational_t &c,
+                         std::size_t variables);
+
+  /** Generator returns the polynomial which is the variable var. */
+  static Polynomial Generator(std::size_t var, std::size_t variables);
+
+  std::size_t NumVariables() const { return vars; }
+
+  std::size_t NumTerms() const { return coeffs.size(); }
+
+  std::size_t NumWords() const { return words; }
+
+  bool IsZero() const { return coeffs.empty(); }
+
+  /** Coefficient returns the coefficient of term t. */
+  const Rational_t &Coefficient(std::size_t t) const { return coeffs[t]; }
+
+  /** Monomial returns the packed exponents of term t. */
+  const std::uint64_t *Monomial(std::size_t t) const {
+    return exps.data() + t * words;
+  }
+
+  /** Exponent returns the exponent of variable var in term t. */
+  unsigned Exponent(std::size_t t, std::size_t var) const {
+    return GetExponent(Monomial(t), var);
+  }
+
+  /** Degree returns the highest exponent of variable var. */
+  unsigned Degree(std::size_t var) const;
+
+  /** IsConstant returns true if the polynomial has no term with a variable. */
+  bool IsConstant() const;
+
+  /** Content returns the number c such that this polynomial divided by c has
+   coprime integer coefficients and a positive leading coefficient. The
+   content of the zero polynomial is 0. */
+  Rational_t Content() const;
+
+  /** Divide sets q to this polynomial divided by d and returns true if d
+   divides this polynomial. d must not be zero. */
+  bool Divide(const Polynomial &d, Polynomial *q) const;
+
+  /** Gcd returns the greatest common divisor of a and b. It has coprime
+   integer coefficients and a positive leading coefficient; Gcd(0, 0) = 0.
+
+   Gcd uses the heuristic gcd: the polynomials are evaluated at a large
+   integer, the gcd of the values is mapped back to a polynomial and checked
+   by division. In the rare case that no evaluation point works, the result
+   is 1, i.e. the common factor is not found. */
+  static Polynomial Gcd(const Polynomial &a, const Polynomial &b);
+
+  Polynomial operator+(const Polynomial &p) const;
+  Polynomial operator-(const Polynomial &p) const;
+  Polynomial operator-() const;
+  Polynomial operator*(const Polynomial &p) const;
+  Polynomial operator*(const Rational_t &c) const;
+
+  /** Pow returns this polynomial to the power of e. */
+  Polynomial Pow(unsigned e) const;
+
+  bool operator==(const Polynomial &p) const {
+    return vars == p.vars && exps == p.exps && coeffs == p.coeffs;
+  }
+  bool operator!=(const Polynomial &p) const { return !(*this == p); }
+
+private:
+  /** compare compares packed exponents like strcmp. */
+  int compare(const std::uint64_t *a, const std::uint64_t *b) const;
+
+  static Polynomial multiplyTable(const Polynomial &a, const Polynomial &b);
+  static Polynomial multiplyKronecker(const Polynomial &a,
+                                      const Polynomial &b);
+
+  /** append appends a term; the caller keeps the order of the terms. */
+  void append(const std::uint64_t *e, const Rational_t &c);
+
+  /** checkDegree throws an InputError if the product of this polynomial and
+   p has an exponent larger than MaxExponent. */
+  void checkDegree(const Polynomial &p) const;
+
+  std::size_t vars;
+  std::size_t words;
+  std::vector<std::uint64_t> exps;
+  std::vector<Rational_t> coeffs;
+};
+
+/** RationalFunction is a quotient of two polynomials without a common
+ factor. The denominator has coprime integer coefficients and a positive
+ leading coefficient, so equal rational functions have equal numerators and
+ denominators. */
+class RationalFunction {
+public:
+  explicit RationalFunction(const Polynomial &num);
+
+  /** RationalFunction returns num/den with the common factors cancelled. It
+   throws an InputError if den is zero. */
+  RationalFunction(const Polynomial &num, const Polynomial &den);
+
+  const Polynomial &Numerator() const { return num; }
+  const Polynomial &Denominator() const { return den; }
+
+  RationalFunction operator+(const RationalFunction &f) const;
+  RationalFunction operator-() const;
+  RationalFunction operator*(const RationalFunction &f) const;
+
+  /** Pow returns this function to the power of e. Negative exponents invert
+   the function. */
+  RationalFunction Pow(int e) const;
+
+private:
+  RationalFunction() {}
+
+  /** normalize divides the numerator and the denominator by the content of
+   the denominator. */
+  void normalize();
+
+  Polynomial num;
+  Polynomial den;
+};
+
+/** PolynomialRing converts between nodes and polynomials.
+
+ The variables of the polynomials (generators) are the parts of an
+ expression which are neither numbers nor sums, products or powers with a
+ natural exponent, e.g. x, sin(y) or x^(1/2). Products and powers of sums
+ are multiplied out.
+
+ All generators have to be added with Add before the nodes are converted, so
+ the polynomials of a ring have the same number of variables.
+
+ A ring for fractions also takes the bases of powers with negative integer
+ exponents apart, e.g. 1/(x+1) has the generator x instead of (x+1)^(-1).
+ Its nodes are converted with FractionFromNode. */
+class PolynomialRing {
+public:
+  explicit PolynomialRing(bool fractions = false) : fractions(fractions) {}
+
+  /** Add adds the generators of n. It returns false if n contains a number
+   which is not a fraction. */
+  bool Add(const NodePtr &n);
+
+  const std::vector<NodePtr> &Generators() const { return generators; }
+
+  /** HasOnlyVariables returns true if all generators are variables other
+   than the imaginary unit i. */
+  bool HasOnlyVariables() const;
+
+  /** Monomial sets the packed exponents words (Polynomial::Words of the
+   number of generators) and the coefficient of n if n is a monomial, e.g.
+   3*x^2*y. It returns false if n is not a monomial of the generators. */
+  bool Monomial(const NodePtr &n, std::uint64_t *words,
+                NumberRepr *coeff) const;
+
+  /** FromNode returns the polynomial of n. It throws an InputError if an
+   exponent is larger than Polynomial::MaxExponent. */
+  Polynomial FromNode(const NodePtr &n) const;
+
+  /** ToNode returns the sum of the terms of p, e.g. 3*x^2*y + 1. The result
+   has to be evaluated unless HasOnlyVariables is true. */
+  NodePtr ToNode(const Polynomial &p) const;
+
+  /** FractionFromNode returns the rational function of n. It throws an
+   InputError if an exponent is larger than Polynomial::MaxExponent or if n
+   divides by zero. */
+  RationalFunction FractionFromNode(const NodePtr &n) const;
+
+  /** ToNode returns the quotient of the sums of the numerator and the
+   denominator of f. The result has to be evaluated unless the denominator is
+   1 and HasOnlyVariables is true. */
+  NodePtr ToNode(const RationalFunction &f) const;
+
+private:
+  bool addFactor(const NodePtr &n);
+  void addGenerator(const NodePtr &n);
+  std::size_t find(const NodePtr &n) const;
+  Polynomial fromFactor(const NodePtr &n) const;
+  Polynomial generator(const NodePtr &n) const;
+
+  bool fractions;
+  std::vector<NodePtr> generators;
+  std::unordered_multimap<std::size_t, std::size_t> index;
+};
+
+/** FuncExpand is the function expand(f) which multiplies out all products
+ and natural powers of sums in f, e.g. expand((x+1)^2) = x^2 + 2*x + 1. The
+ arguments of functions are not expanded. */
+class FuncExpand : public UserFunction {
+public:
+  virtual size_t NumArgs() const { return 1; }
+  virtual NodePtr Eval(const NodeList &args, bool numeric = false);
+
+  virtual NodePtr EvalNum(const std::vector<std::complex<NumberRepr>> &args) {
+    return 0;
+  }
+  virtual bool SpecialValues(const NodeList &args, NodePtr *result) {
+    return false;
+  }
+};
+
+/** FuncNormal is the function normal(f) which writes f as a quotient of
+ polynomials without a common factor, e.g. normal(1/x + 1/(x*(x+1))) =
+ (x+2)/(x^2+x) and normal((x^2-1)/(x-1)) = x+1. */
+class FuncNormal : public UserFunction {
+public:
+  virtual size_t NumArgs() const { return 1; }
+  virtual NodePtr Eval(const NodeList &args, bool numeric = false);
+
+  virtual NodePtr EvalNum(const std::vector<std::complex<NumberRepr>> &args) {
+    return 0;
+  }
+  virtual bool SpecialValues(const NodeList &args, NodePtr *result) {
+    return false;
+  }
+};
+
+} // namespace Equation
+
+#endif /* Polynomial_hpp */
@@ -73,6 +73,7 @@ void Power::writeTreeToStream(std::ostream &s, const std::string &name) {
 }
 
 void Power::Eval(NodePtr *ba, std::shared_ptr<State> state, bool numeric) {
+  invalidateHash();
   base->Eval(&base, state, numeric);
   exponent->Eval(&exponent, state, numeric);
   // evaluate (x^s)^r
@@ -90,7 +91,7 @@ void Power::Eval(NodePtr *ba, std::shared_ptr<State> state, bool numeric) {
             boost::multiprecision::abs(ns.Denominator()) % Integer_t(2) ==
                 Integer_t(1)) {
           base = b->Base();
-          exponent = std::make_shared<Number>(nr * ns);
+          exponent = new_node<Number>(nr * ns);
         }
       }
     }
@@ -105,7 +106,7 @@ void Power::Eval(NodePtr *ba, std::shared_ptr<State> state, bool numeric) {
 
     auto newnumber = NumberRepr::Pow(a, b);
     if (newnumber.IsValid()) {
-      ba->reset(new Number(newnumber));
+      *ba = new_node<Number>(newnumber);
       return;
     }
   }
@@ -116,13 +117,12 @@ void Power::Eval(NodePtr *ba, std::shared_ptr<State> state, bool numeric) {
     auto e = std::static_pointer_cast<Number>(exponent);
     auto ex = e->GetValue();
     if (var->Name() == "i" && ex.IsFraction() && ex.Denominator() == 1l) {
-      auto numabs = boost::multiprecision::abs(ex.Numerator());
+      Integer_t numabs = boost::multiprecision::abs(ex.Numerator());
       NodePtr imag;
       if (ex.Numerator() > Integer_t(0)) {
-        imag = std::make_shared<Variable>("i");
+        imag = new_node<Variable>("i");
       } else {
-        imag = std::make_shared<Power>(std::make_shared<Variable>("i"),
-                                       std::make_shared<Number>(-1l));
+        imag = new_node<Power>(new_node<Variable>("i"), new_node<Number>(-1l));
       }
 
       Integer_t tmp = (numabs - Integer_t(1)) % Integer_t(4);
@@ -131,19 +131,19 @@ void Power::Eval(NodePtr *ba, std::shared_ptr<State> state, bool numeric) {
         return;
       }
       if (tmp == Integer_t(2)) {
-        auto newfactor = std::make_shared<Factor>();
-        newfactor->AddOp1(std::make_shared<Number>(-1l));
+        auto newfactor = new_node<Factor>();
+        newfactor->AddOp1(new_node<Number>(-1l));
         newfactor->AddOp1(imag);
         *ba = newfactor;
         return;
       }
 
       if (tmp == Integer_t(1)) {
-        *ba = std::make_shared<Number>(-1l);
+        *ba = new_node<Number>(-1l);
         return;
       }
       if (tmp == Integer_t(3)) {
-        *ba = std::make_shared<Number>(1l);
+        *ba = new_node<Number>(1l);
         return;
       }
     }
@@ -154,7 +154,7 @@ void Power::Eval(NodePtr *ba, std::shared_ptr<State> state, bool numeric) {
     auto e = std::static_pointer_cast<Number>(exponent);
     auto b = std::static_pointer_cast<Number>(base);
     if (b->GetValue() == NumberRepr(1l)) {
-      *ba = std::make_shared<Number>(1l);
+      *ba = new_node<Number>(1l);
       return;
     }
     if (e->GetValue().IsFraction() && b->GetValue().IsFraction()) {
@@ -184,24 +184,24 @@ void Power::Eval(NodePtr *ba, std::shared_ptr<State> state, bool numeric) {
         auto base_num = root_n(b_num, d);
         auto base_denom = root_n(b_denom, d);
 
-        auto factor = std::make_shared<Number>(
+        auto factor = new_node<Number>(
             Rational_t(base_num.first, base_denom.first));
-        auto root = std::make_shared<Number>(
+        auto root = new_node<Number>(
             Rational_t(base_num.second, base_denom.second));
         if (base_num.first == base_denom.first && !add_imag) {
           // can not calculate root of base
           return;
         }
 
-        auto newpower_exp = std::make_shared<Number>(e->GetValue().Numerator());
-        auto newfactor = std::make_shared<Factor>();
-        newfactor->AddOp1(std::make_shared<Power>(factor, newpower_exp));
-        newfactor->AddOp1(std::make_shared<Power>(root, exponent->clone()));
+        auto newpower_exp = new_node<Number>(e->GetValue().Numerator());
+        auto newfactor = new_node<Factor>();
+        newfactor->AddOp1(new_node<Power>(factor, newpower_exp));
+        newfactor->AddOp1(new_node<Power>(root, exponent->clone()));
         if (add_imag) {
-          newfactor->AddOp1(std::make_shared<Variable>("i"));
+          newfactor->AddOp1(new_node<Variable>("i"));
         }
         if (add_neg) {
-          newfactor->AddOp1(std::make_shared<Number>(-1l));
+          newfactor->AddOp1(new_node<Number>(-1l));
         }
         auto eval = std::static_pointer_cast<Node>(newfactor);
         eval->Eval(&eval, state, numeric);
@@ -213,9 +213,9 @@ void Power::Eval(NodePtr *ba, std::shared_ptr<State> state, bool numeric) {
   // split (x*y)^n to x^n*y^n
   if (base->Type() == Node::Type_t::Factor) {
     auto factor = std::static_pointer_cast<Factor>(base);
-    auto newfactor = std::make_shared<Factor>();
+    auto newfactor = new_node<Factor>();
     for (auto &f : factor->Data()) {
-      auto pow = std::make_shared<Power>(f, exponent->clone());
+      auto pow = new_node<Power>(f, exponent->clone());
       auto parent = std::static_pointer_cast<Node>(pow);
       parent->Eval(&parent, state, numeric);
       newfactor->AddOp1(parent);
@@ -325,7 +325,7 @@ void Power::ToLatex(std::ostream &s) {
   }
 }
 
-bool Power::equals(NodePtr n) const {
+bool Power::equalTo(const NodePtr &n) const {
   if (n->Type() != Node::Type_t::Power) {
     return false;
   }
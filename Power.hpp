@@ -27,13 +27,21 @@ public:
     return base->IsNumber() && exponent->IsNumber();
   }
 
-  virtual bool equals(NodePtr n) const;
-
   NodePtr Base() { return base; }
   NodePtr Exponent() { return exponent; }
 
   virtual NodePtr clone() const {
-    return std::make_shared<Power>(base->clone(), exponent->clone());
+    return new_node<Power>(base->clone(), exponent->clone());
+  }
+
+protected:
+  virtual bool equalTo(const NodePtr &n) const;
+
+  virtual std::size_t hash() const {
+    std::size_t h = static_cast<std::size_t>(Type());
+    hash_combine(h, base->Hash());
+    hash_combine(h, exponent->Hash());
+    return h;
   }
 
 private:
@@ -0,0 +1,815 @@
+//
+//  Copyright © 2017 Lennart Oymanns. All rights reserved.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <unordered_map>
+
+#include "Error.h"
+#include "Factor.hpp"
+#include "Function.hpp"
+#include "Number.hpp"
+#include "Power.hpp"
+#include "Program.hpp"
+#include "Summand.hpp"
+#include "UnaryMinus.hpp"
+#include "Variable.hpp"
+#include "VectorMath.hpp"
+
+namespace Equation {
+
+namespace {
+
+// While compiling, operands are tagged with their kind because the number of
+// variables and constants is only known at the end.
+const std::uint32_t ConstTag = 1u << 29;
+const std::uint32_t TempTag = 1u << 30;
+const std::uint32_t IndexMask = ConstTag - 1;
+
+/** MaxPowInt is the largest integer exponent which is evaluated by
+ multiplication instead of pow(). */
+const long MaxPowInt = 64;
+
+const struct {
+  const char *name;
+  Program::Op op;
+} function_ops[] = {
+    {"sqrt", Program::Op::Sqrt},   {"exp", Program::Op::Exp},
+    {"log", Program::Op::Log},     {"sin", Program::Op::Sin},
+    {"cos", Program::Op::Cos},     {"tan", Program::Op::Tan},
+    {"asin", Program::Op::ASin},   {"acos", Program::Op::ACos},
+    {"atan", Program::Op::ATan},   {"sinh", Program::Op::Sinh},
+    {"cosh", Program::Op::Cosh},   {"tanh", Program::Op::Tanh},
+    {"arsinh", Program::Op::ASinh}, {"arcosh", Program::Op::ACosh},
+    {"artanh", Program::Op::ATanh},
+};
+
+/** reads_b returns true if operand b of op is a register. */
+bool reads_b(Program::Op op) {
+  switch (op) {
+  case Program::Op::Add:
+  case Program::Op::Sub:
+  case Program::Op::Mul:
+  case Program::Op::Div:
+  case Program::Op::Pow:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/** is_negative returns true if c is a negative real number. */
+bool is_negative(const std::complex<double> &c) {
+  return c.imag() == 0.0 && c.real() < 0.0;
+}
+
+template <class T> T pow_int(T x, std::int32_t n) {
+  bool invert = n < 0;
+  std::uint32_t e = invert ? -std::int64_t(n) : n;
+  T result(1.0);
+  while (e > 0) {
+    if (e & 1) {
+      result *= x;
+    }
+    e >>= 1;
+    if (e > 0) {
+      x *= x;
+    }
+  }
+  if (invert) {
+    return T(1.0) / result;
+  }
+  return result;
+}
+
+/** run executes program p with the registers regs. The variables and
+ constants have to be loaded already. record(in, regs, r) is called for every
+ instruction in with its result r before r is stored. */
+template <class T, class Record>
+T run(const Program &p, T *regs, Record record) {
+  // the functions for Dual are found by argument dependent lookup.
+  using std::acos;
+  using std::acosh;
+  using std::asin;
+  using std::asinh;
+  using std::atan;
+  using std::atanh;
+  using std::cos;
+  using std::cosh;
+  using std::exp;
+  using std::log;
+  using std::pow;
+  using std::sin;
+  using std::sinh;
+  using std::sqrt;
+  using std::tan;
+  using std::tanh;
+  for (const auto &in : p.Code()) {
+    T a = regs[in.a];
+    T r = T(0.0);
+    switch (in.op) {
+    case Program::Op::Add:
+      r = a + regs[in.b];
+      break;
+    case Program::Op::Sub:
+      r = a - regs[in.b];
+      break;
+    case Program::Op::Mul:
+      r = a * regs[in.b];
+      break;
+    case Program::Op::Div:
+      r = a / regs[in.b];
+      break;
+    case Program::Op::Neg:
+      r = -a;
+      break;
+    case Program::Op::PowInt:
+      r = pow_int(a, in.b);
+      break;
+    case Program::Op::Pow:
+      r = pow(a, regs[in.b]);
+      break;
+    case Program::Op::Sqrt:
+      r = sqrt(a);
+      break;
+    case Program::Op::Exp:
+      r = exp(a);
+      break;
+    case Program::Op::Log:
+      r = log(a);
+      break;
+    case Program::Op::Sin:
+      r = sin(a);
+      break;
+    case Program::Op::Cos:
+      r = cos(a);
+      break;
+    case Program::Op::Tan:
+      r = tan(a);
+      break;
+    case Program::Op::ASin:
+      r = asin(a);
+      break;
+    case Program::Op::ACos:
+      r = acos(a);
+      break;
+    case Program::Op::ATan:
+      r = atan(a);
+      break;
+    case Program::Op::Sinh:
+      r = sinh(a);
+      break;
+    case Program::Op::Cosh:
+      r = cosh(a);
+      break;
+    case Program::Op::Tanh:
+      r = tanh(a);
+      break;
+    case Program::Op::ASinh:
+      r = asinh(a);
+      break;
+    case Program::Op::ACosh:
+      r = acosh(a);
+      break;
+    case Program::Op::ATanh:
+      r = atanh(a);
+      break;
+    }
+    record(in, regs, r);
+    regs[in.dst] = r;
+  }
+  return regs[p.Result()];
+}
+
+/** partials sets da and db to the partial derivatives of the result r of
+ the instruction in with respect to its operands a and b. */
+void partials(const Program::Instr &in, double a, double b, double r,
+              double *da, double *db) {
+  *db = 0;
+  switch (in.op) {
+  case Program::Op::Add:
+    *da = 1;
+    *db = 1;
+    break;
+  case Program::Op::Sub:
+    *da = 1;
+    *db = -1;
+    break;
+  case Program::Op::Mul:
+    *da = b;
+    *db = a;
+    break;
+  case Program::Op::Div:
+    *da = 1 / b;
+    *db = -r / b;
+    break;
+  case Program::Op::Neg:
+    *da = -1;
+    break;
+  case Program::Op::PowInt:
+    *da = in.b == 0 ? 0 : in.b * pow_int(a, in.b - 1);
+    break;
+  case Program::Op::Pow:
+    *da = b * std::pow(a, b - 1);
+    // r = 0 for a = 0 and b > 0, where log(a) is -inf.
+    *db = r == 0 ? 0 : r * std::log(a);
+    break;
+  case Program::Op::Sqrt:
+    *da = 0.5 / r;
+    break;
+  case Program::Op::Exp:
+    *da = r;
+    break;
+  case Program::Op::Log:
+    *da = 1 / a;
+    break;
+  case Program::Op::Sin:
+    *da = std::cos(a);
+    break;
+  case Program::Op::Cos:
+    *da = -std::sin(a);
+    break;
+  case Program::Op::Tan:
+    *da = 1 + r * r;
+    break;
+  case Program::Op::ASin:
+    *da = 1 / std::sqrt(1 - a * a);
+    break;
+  case Program::Op::ACos:
+    *da = -1 / std::sqrt(1 - a * a);
+    break;
+  case Program::Op::ATan:
+    *da = 1 / (1 + a * a);
+    break;
+  case Program::Op::Sinh:
+    *da = std::cosh(a);
+    break;
+  case Program::Op::Cosh:
+    *da = std::sinh(a);
+    break;
+  case Program::Op::Tanh:
+    *da = 1 - r * r;
+    break;
+  case Program::Op::ASinh:
+    *da = 1 / std::sqrt(a * a + 1);
+    break;
+  case Program::Op::ACosh:
+    *da = 1 / std::sqrt(a * a - 1);
+    break;
+  case Program::Op::ATanh:
+    *da = 1 / (1 - a * a);
+    break;
+  }
+}
+
+template <class T> T run(const Program &p, T *regs) {
+  return run(p, regs, [](const Program::Instr &, const T *, T) {});
+}
+
+/** Tape records the partial derivatives of instruction k with respect to its
+ operands in tape[2k] and tape[2k+1]. */
+struct Tape {
+  double *tape;
+
+  void operator()(const Program::Instr &in, const double *regs, double r) {
+    double b = reads_b(in.op) ? regs[in.b] : 0.0;
+    partials(in, regs[in.a], b, r, tape, tape + 1);
+    tape += 2;
+  }
+};
+
+double scalar_asin(double x) { return std::asin(x); }
+double scalar_acos(double x) { return std::acos(x); }
+double scalar_atan(double x) { return std::atan(x); }
+double scalar_sinh(double x) { return std::sinh(x); }
+double scalar_cosh(double x) { return std::cosh(x); }
+double scalar_tanh(double x) { return std::tanh(x); }
+double scalar_asinh(double x) { return std::asinh(x); }
+double scalar_acosh(double x) { return std::acosh(x); }
+double scalar_atanh(double x) { return std::atanh(x); }
+
+} // namespace
+
+/** ProgramCompiler translates a tree of nodes into a Program. */
+class ProgramCompiler {
+public:
+  ProgramCompiler(Program &p, StatePtr s) : prog(p), state(s) {}
+
+  void AddVariable(const std::string &name) { variable(name); }
+
+  void Finish(std::uint32_t result);
+
+  std::uint32_t Compile(const NodePtr &n);
+
+private:
+  std::uint32_t compileNode(const NodePtr &n);
+  std::uint32_t compileVariable(const std::string &name);
+  std::uint32_t compileSummand(const std::shared_ptr<const Summand> &s);
+  std::uint32_t compileFactor(const std::shared_ptr<const Factor> &f,
+                              bool negate);
+  std::uint32_t compilePower(const NodePtr &base, const NumberRepr &exponent);
+  std::uint32_t compileFunction(const std::shared_ptr<Function> &f);
+  std::uint32_t product(const std::vector<std::uint32_t> &regs);
+
+  std::uint32_t emit(Program::Op op, std::uint32_t a, std::int32_t b = 0);
+  std::uint32_t constant(std::complex<double> c);
+  std::uint32_t variable(const std::string &name);
+
+  Program &prog;
+  StatePtr state;
+  std::map<std::string, std::uint32_t> var_index;
+  std::map<std::pair<std::uint64_t, std::uint64_t>, std::uint32_t>
+      const_index;
+  std::unordered_multimap<std::size_t, std::pair<NodePtr, std::uint32_t>>
+      memo;
+};
+
+std::uint32_t ProgramCompiler::emit(Program::Op op, std::uint32_t a,
+                                    std::int32_t b) {
+  auto dst = TempTag | std::uint32_t(prog.code.size());
+  prog.code.push_back(Program::Instr{op, dst, a, b});
+  return dst;
+}
+
+std::uint32_t ProgramCompiler::constant(std::complex<double> c) {
+  // constants are compared bitwise, so that NaN can be used as key.
+  std::pair<std::uint64_t, std::uint64_t> key;
+  double re = c.real();
+  double im = c.imag();
+  std::memcpy(&key.first, &re, sizeof(re));
+  std::memcpy(&key.second, &im, sizeof(im));
+  auto it = const_index.find(key);
+  if (it != const_index.end()) {
+    return it->second;
+  }
+  auto index = ConstTag | std::uint32_t(prog.constants.size());
+  prog.constants.push_back(c);
+  if (im != 0.0) {
+    prog.real = false;
+  }
+  const_index[key] = index;
+  return index;
+}
+
+std::uint32_t ProgramCompiler::variable(const std::string &name) {
+  auto it = var_index.find(name);
+  if (it != var_index.end()) {
+    return it->second;
+  }
+  auto index = std::uint32_t(prog.variables.size());
+  prog.variables.push_back(name);
+  var_index[name] = index;
+  return index;
+}
+
+/** Compile compiles n. Equal subexpressions are only compiled once. */
+std::uint32_t ProgramCompiler::Compile(const NodePtr &n) {
+  auto h = n->Hash();
+  auto range = memo.equal_range(h);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second.first->equals(n)) {
+      return it->second.second;
+    }
+  }
+  auto reg = compileNode(n);
+  memo.emplace(h, std::make_pair(n, reg));
+  return reg;
+}
+
+std::uint32_t ProgramCompiler::compileNode(const NodePtr &n) {
+  switch (n->Type()) {
+  case Node::Type_t::Number: {
+    auto value = std::static_pointer_cast<Number>(n)->GetValue();
+    if (!value.IsValid()) {
+      return constant(std::numeric_limits<double>::quiet_NaN());
+    }
+    return constant(value.Double());
+  }
+  case Node::Type_t::Variable:
+    return compileVariable(std::static_pointer_cast<Variable>(n)->Name());
+  case Node::Type_t::UnaryMinus:
+    return emit(Program::Op::Neg,
+                Compile(std::static_pointer_cast<const UnaryMinus>(n)->Data()));
+  case Node::Type_t::Summand:
+    return compileSummand(std::static_pointer_cast<const Summand>(n));
+  case Node::Type_t::Factor:
+    return compileFactor(std::static_pointer_cast<const Factor>(n), false);
+  case Node::Type_t::Power: {
+    auto p = std::static_pointer_cast<Power>(n);
+    if (p->Exponent()->Type() == Node::Type_t::Number) {
+      auto e = std::static_pointer_cast<Number>(p->Exponent())->GetValue();
+      return compilePower(p->Base(), e);
+    }
+    return emit(Program::Op::Pow, Compile(p->Base()), Compile(p->Exponent()));
+  }
+  case Node::Type_t::Function:
+    return compileFunction(std::static_pointer_cast<Function>(n));
+  }
+  throw InputError(0, "cannot compile node");
+}
+
+std::uint32_t ProgramCompiler::compileVariable(const std::string &name) {
+  if (var_index.count(name) > 0) {
+    return var_index[name];
+  }
+  if (name == "i") {
+    return constant(std::complex<double>(0.0, 1.0));
+  }
+  if (state->IsVariable(name)) {
+    return Compile(state->GetVariable(name));
+  }
+  return variable(name);
+}
+
+std::uint32_t
+ProgramCompiler::compileSummand(const std::shared_ptr<const Summand> &s) {
+  std::uint32_t acc = 0;
+  bool first = true;
+  for (const auto &op : s->Data()) {
+    // negative terms are subtracted instead of being negated first.
+    std::uint32_t term;
+    bool negative = false;
+    if (op->Type() == Node::Type_t::UnaryMinus) {
+      term = Compile(std::static_pointer_cast<const UnaryMinus>(op)->Data());
+      negative = true;
+    } else if (op->Type() == Node::Type_t::Factor) {
+      auto f = std::static_pointer_cast<const Factor>(op);
+      std::complex<double> coeff(1.0);
+      for (const auto &e : f->Data()) {
+        if (e->Type() == Node::Type_t::Number) {
+          coeff *= std::static_pointer_cast<Number>(e)->GetValue().Double();
+        }
+      }
+      negative = is_negative(coeff);
+      term = negative ? compileFactor(f, true) : Compile(op);
+    } else {
+      term = Compile(op);
+    }
+    if (first) {
+      acc = negative ? emit(Program::Op::Neg, term) : term;
+      first = false;
+      continue;
+    }
+    acc = emit(negative ? Program::Op::Sub : Program::Op::Add, acc, term);
+  }
+  if (first) {
+    return constant(0.0);
+  }
+  return acc;
+}
+
+/** compileFactor compiles the product f (or -f if negate is true). Factors
+ with negative exponents are collected in a denominator, so that the product
+ needs at most one division. */
+std::uint32_t
+ProgramCompiler::compileFactor(const std::shared_ptr<const Factor> &f,
+                               bool negate) {
+  std::complex<double> coeff(negate ? -1.0 : 1.0);
+  std::vector<std::uint32_t> num;
+  std::vector<std::uint32_t> denom;
+  for (const auto &op : f->Data()) {
+    if (op->Type() == Node::Type_t::Number) {
+      coeff *= std::static_pointer_cast<Number>(op)->GetValue().Double();
+      continue;
+    }
+    if (op->Type() == Node::Type_t::Power) {
+      auto p = std::static_pointer_cast<Power>(op);
+      if (p->Exponent()->Type() == Node::Type_t::Number) {
+        auto e = std::static_pointer_cast<Number>(p->Exponent())->GetValue();
+        if (e.IsValid() && e < NumberRepr(0l)) {
+          denom.push_back(compilePower(p->Base(), NumberRepr(0l) - e));
+          continue;
+        }
+      }
+    }
+    num.push_back(Compile(op));
+  }
+  std::uint32_t reg;
+  if (num.empty()) {
+    reg = constant(coeff);
+  } else {
+    reg = product(num);
+    if (coeff == std::complex<double>(-1.0)) {
+      reg = emit(Program::Op::Neg, reg);
+    } else if (coeff != std::complex<double>(1.0)) {
+      reg = emit(Program::Op::Mul, constant(coeff), reg);
+    }
+  }
+  if (!denom.empty()) {
+    reg = emit(Program::Op::Div, reg, product(denom));
+  }
+  return reg;
+}
+
+std::uint32_t
+ProgramCompiler::product(const std::vector<std::uint32_t> &regs) {
+  auto reg = regs[0];
+  for (std::size_t i = 1; i < regs.size(); i++) {
+    reg = emit(Program::Op::Mul, reg, regs[i]);
+  }
+  return reg;
+}
+
+std::uint32_t ProgramCompiler::compilePower(const NodePtr &base,
+                                            const NumberRepr &exponent) {
+  if (exponent.IsValid() && exponent.IsFraction()) {
+    if (exponent.Denominator() == 1) {
+      auto n = exponent.Numerator();
+      if (n == 1) {
+        return Compile(base);
+      }
+      if (n >= -MaxPowInt && n <= MaxPowInt) {
+        return emit(Program::Op::PowInt, Compile(base),
+                    n.convert_to<std::int32_t>());
+      }
+    }
+    if (exponent == NumberRepr(1l, 2l)) {
+      return emit(Program::Op::Sqrt, Compile(base));
+    }
+    if (exponent == NumberRepr(-1l, 2l)) {
+      return emit(Program::Op::Div, constant(1.0),
+                  emit(Program::Op::Sqrt, Compile(base)));
+    }
+  }
+  auto e = std::static_pointer_cast<Node>(new_node<Number>(exponent));
+  return emit(Program::Op::Pow, Compile(base), Compile(e));
+}
+
+std::uint32_t
+ProgramCompiler::compileFunction(const std::shared_ptr<Function> &f) {
+  for (const auto &entry : function_ops) {
+    if (f->Name() == entry.name && f->Args().size() == 1) {
+      return emit(entry.op, Compile(f->Args()[0]));
+    }
+  }
+  throw InputError(0, "cannot compile function '" + f->Name() + "'");
+}
+
+/** Finish assigns the registers. Temporaries share a register if their
+ lifetimes do not overlap. */
+void ProgramCompiler::Finish(std::uint32_t result) {
+  auto nvars = std::uint32_t(prog.variables.size());
+  auto nconsts = std::uint32_t(prog.constants.size());
+  auto &code = prog.code;
+
+  // last_use[t] is the index of the last instruction which reads temporary t.
+  std::vector<std::size_t> last_use(code.size(), 0);
+  std::vector<bool> used(code.size(), false);
+  auto mark = [&](std::uint32_t reg, std::size_t k) {
+    if (reg & TempTag) {
+      last_use[reg & IndexMask] = k;
+      used[reg & IndexMask] = true;
+    }
+  };
+  for (std::size_t k = 0; k < code.size(); k++) {
+    mark(code[k].a, k);
+    if (reads_b(code[k].op)) {
+      mark(code[k].b, k);
+    }
+  }
+  if (result & TempTag) {
+    last_use[result & IndexMask] = code.size();
+    used[result & IndexMask] = true;
+  }
+
+  std::vector<std::uint32_t> phys(code.size(), 0);
+  std::vector<std::uint32_t> free_regs;
+  std::uint32_t num_temps = 0;
+  auto resolve = [&](std::uint32_t reg) -> std::uint32_t {
+    if (reg & TempTag) {
+      return nvars + nconsts + phys[reg & IndexMask];
+    }
+    if (reg & ConstTag) {
+      return nvars + (reg & IndexMask);
+    }
+    return reg;
+  };
+  auto release = [&](std::uint32_t reg, std::size_t k) {
+    if ((reg & TempTag) && last_use[reg & IndexMask] == k) {
+      free_regs.push_back(phys[reg & IndexMask]);
+      last_use[reg & IndexMask] = code.size() + 1; // release only once
+    }
+  };
+  for (std::size_t k = 0; k < code.size(); k++) {
+    auto &in = code[k];
+    auto a = in.a;
+    auto b = in.b;
+    in.a = resolve(a);
+    if (reads_b(in.op)) {
+      in.b = resolve(std::uint32_t(b));
+    }
+    // the operands are read before dst is written, so dst may reuse the
+    // register of an operand which dies here.
+    release(a, k);
+    if (reads_b(in.op)) {
+      release(std::uint32_t(b), k);
+    }
+    if (free_regs.empty()) {
+      phys[k] = num_temps++;
+    } else {
+      phys[k] = free_regs.back();
+      free_regs.pop_back();
+    }
+    in.dst = nvars + nconsts + phys[k];
+    if (!used[k]) {
+      free_regs.push_back(phys[k]);
+    }
+  }
+  prog.result = resolve(result);
+  prog.num_registers = nvars + nconsts + num_temps;
+}
+
+Program Program::Compile(const NodePtr &n,
+                         const std::vector<std::string> &variables,
+                         StatePtr state) {
+  Program p;
+  ProgramCompiler compiler(p, state);
+  for (const auto &v : variables) {
+    compiler.AddVariable(v);
+  }
+  compiler.Finish(compiler.Compile(n));
+  return p;
+}
+
+double Program::Evaluate(const double *values) const {
+  if (!real) {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+  static thread_local std::vector<double> regs;
+  regs.resize(num_registers);
+  std::copy(values, values + variables.size(), regs.begin());
+  for (std::size_t i = 0; i < constants.size(); i++) {
+    regs[variables.size() + i] = constants[i].real();
+  }
+  return run(*this, regs.data());
+}
+
+Dual Program::Evaluate(const Dual *values) const {
+  if (!real) {
+    return Dual(std::numeric_limits<double>::quiet_NaN(),
+                std::numeric_limits<double>::quiet_NaN());
+  }
+  static thread_local std::vector<Dual> regs;
+  regs.resize(num_registers);
+  std::copy(values, values + variables.size(), regs.begin());
+  for (std::size_t i = 0; i < constants.size(); i++) {
+    regs[variables.size() + i] = Dual(constants[i].real());
+  }
+  return run(*this, regs.data());
+}
+
+std::complex<double>
+Program::Evaluate(const std::complex<double> *values) const {
+  static thread_local std::vector<std::complex<double>> regs;
+  regs.resize(num_registers);
+  std::copy(values, values + variables.size(), regs.begin());
+  std::copy(constants.begin(), constants.end(),
+            regs.begin() + variables.size());
+  return run(*this, regs.data());
+}
+
+double Program::Gradient(const double *values, double *gradient) const {
+  auto nvars = variables.size();
+  if (!real) {
+    std::fill(gradient, gradient + nvars,
+              std::numeric_limits<double>::quiet_NaN());
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+  static thread_local std::vector<double> regs;
+  static thread_local std::vector<double> tape;
+  regs.resize(num_registers);
+  tape.resize(2 * code.size());
+  std::copy(values, values + nvars, regs.begin());
+  for (std::size_t i = 0; i < constants.size(); i++) {
+    regs[nvars + i] = constants[i].real();
+  }
+
+  // forward sweep: evaluate the program and record the partial derivatives
+  // of every instruction.
+  run(*this, regs.data(), Tape{tape.data()});
+
+  // backward sweep: propagate the adjoints from the result to the inputs.
+  // A register can hold several values one after another, so the adjoint of
+  // dst is cleared after it was passed on to the operands.
+  double value = regs[result];
+  std::fill(regs.begin(), regs.end(), 0.0);
+  regs[result] = 1;
+  for (std::size_t k = code.size(); k-- > 0;) {
+    const auto &in = code[k];
+    double adj = regs[in.dst];
+    regs[in.dst] = 0;
+    regs[in.a] += adj * tape[2 * k];
+    if (reads_b(in.op)) {
+      regs[in.b] += adj * tape[2 * k + 1];
+    }
+  }
+  std::copy(regs.begin(), regs.begin() + nvars, gradient);
+  return value;
+}
+
+void Program::EvaluateBatch(const double *const *columns, std::size_t n,
+                            double *out) const {
+  if (!real) {
+    std::fill(out, out + n, std::numeric_limits<double>::quiet_NaN());
+    return;
+  }
+  const std::size_t block = 256;
+  auto nvars = variables.size();
+  // the constants and temporaries of a block are stored one after another.
+  static thread_local std::vector<double> scratch;
+  scratch.resize((num_registers - nvars) * block);
+  std::vector<const double *> src(num_registers);
+  for (std::size_t r = nvars; r < num_registers; r++) {
+    src[r] = scratch.data() + (r - nvars) * block;
+  }
+  for (std::size_t c = 0; c < constants.size(); c++) {
+    double *dst = scratch.data() + c * block;
+    std::fill(dst, dst + block, constants[c].real());
+  }
+
+  for (std::size_t start = 0; start < n; start += block) {
+    std::size_t m = std::min(block, n - start);
+    for (std::size_t v = 0; v < nvars; v++) {
+      src[v] = columns[v] + start;
+    }
+    for (const auto &in : code) {
+      double *r = scratch.data() + (in.dst - nvars) * block;
+      const double *a = src[in.a];
+      switch (in.op) {
+      case Op::Add:
+        vec_add(a, src[in.b], r, m);
+        break;
+      case Op::Sub:
+        vec_sub(a, src[in.b], r, m);
+        break;
+      case Op::Mul:
+        vec_mul(a, src[in.b], r, m);
+        break;
+      case Op::Div:
+        vec_div(a, src[in.b], r, m);
+        break;
+      case Op::Neg:
+        vec_neg(a, r, m);
+        break;
+      case Op::PowInt:
+        vec_powi(a, in.b, r, m);
+        break;
+      case Op::Pow:
+        vec_pow(a, src[in.b], r, m);
+        break;
+      case Op::Sqrt:
+        vec_sqrt(a, r, m);
+        break;
+      case Op::Exp:
+        vec_exp(a, r, m);
+        break;
+      case Op::Log:
+        vec_log(a, r, m);
+        break;
+      case Op::Sin:
+        vec_sin(a, r, m);
+        break;
+      case Op::Cos:
+        vec_cos(a, r, m);
+        break;
+      case Op::Tan:
+        vec_tan(a, r, m);
+        break;
+      case Op::ASin:
+        vec_apply(scalar_asin, a, r, m);
+        break;
+      case Op::ACos:
+        vec_apply(scalar_acos, a, r, m);
+        break;
+      case Op::ATan:
+        vec_apply(scalar_atan, a, r, m);
+        break;
+      case Op::Sinh:
+        vec_apply(scalar_sinh, a, r, m);
+        break;
+      case Op::Cosh:
+        vec_apply(scalar_cosh, a, r, m);
+        break;
+      case Op::Tanh:
+        vec_apply(scalar_tanh, a, r, m);
+        break;
+      case Op::ASinh:
+        vec_apply(scalar_asinh, a, r, m);
+        break;
+      case Op::ACosh:
+        vec_apply(scalar_acosh, a, r, m);
+        break;
+      case Op::ATanh:
+        vec_apply(scalar_atanh, a, r, m);
+        break;
+      }
+    }
+    std::copy(src[result], src[result] + m, out + start);
+  }
+}
+
+} // namespace Equation
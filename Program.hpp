@@ -0,0 +1,152 @@
+//
+//  Copyright © 2017 Lennart Oymanns. All rights reserved.
+//
+
+#ifndef Program_hpp
+#define Program_hpp
+
+#include <complex>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Dual.hpp"
+#include "State.hpp"
+
+namespace Equation {
+
+/** Program is an equation compiled to register bytecode for repeated numerical
+ evaluation.
+
+ The registers of a program are laid out as follows: first the variables (in
+ the order of Variables()), then the constants, then the temporaries. Every
+ instruction reads the registers a and b and writes register dst. A program
+ is immutable after compilation, so it can be evaluated by several threads at
+ the same time.
+
+ Only evaluated equations should be compiled. Known variables of the state
+ (e.g. pi) are replaced by their numerical values, "i" is the imaginary unit
+ and every other variable becomes an input of the program. */
+class Program {
+public:
+  enum class Op : std::uint8_t {
+    Add,    ///< a + b
+    Sub,    ///< a - b
+    Mul,    ///< a * b
+    Div,    ///< a / b
+    Neg,    ///< -a
+    PowInt, ///< a ^ b, where b is the integer exponent itself
+    Pow,    ///< a ^ b
+    Sqrt,
+    Exp,
+    Log,
+    Sin,
+    Cos,
+    Tan,
+    ASin,
+    ACos,
+    ATan,
+    Sinh,
+    Cosh,
+    Tanh,
+    ASinh,
+    ACosh,
+    ATanh,
+  };
+
+  struct Instr {
+    Op op;
+    std::uint32_t dst;
+    std::uint32_t a;
+    std::int32_t b;
+  };
+
+  /** Compile compiles the node n. The inputs of the program start with the
+   given variables (even if n does not depend on them), followed by all
+   other variables of n in the order of their first occurrence. Compile throws
+   an InputError if n contains a function which cannot be compiled. */
+  static Program Compile(const NodePtr &n,
+                         const std::vector<std::string> &variables = {},
+                         StatePtr state = std::make_shared<DefaultState>());
+
+  /** Variables returns the names of the inputs of the program. */
+  const std::vector<std::string> &Variables() const { return variables; }
+
+  /** IsReal returns true if the program does not contain complex constants.
+   A real program can be evaluated with double inputs. */
+  bool IsReal() const { return real; }
+
+  /** Evaluate evaluates the program. values must contain a value for each
+   variable. If the program is not real, Evaluate returns NaN. */
+  double Evaluate(const double *values) const;
+
+  std::complex<double> Evaluate(const std::complex<double> *values) const;
+
+  /** Evaluate evaluates the program with dual numbers. The derivative part
+   of the result is the derivative in the direction of the derivative parts
+   of the inputs, e.g. with the derivative parts (1, 0, ...) it is the
+   partial derivative with respect to the first variable. If the program is
+   not real, Evaluate returns NaN. */
+  Dual Evaluate(const Dual *values) const;
+
+  double Evaluate(const std::vector<double> &values) const {
+    return Evaluate(values.data());
+  }
+
+  std::complex<double>
+  Evaluate(const std::vector<std::complex<double>> &values) const {
+    return Evaluate(values.data());
+  }
+
+  Dual Evaluate(const std::vector<Dual> &values) const {
+    return Evaluate(values.data());
+  }
+
+  /** Gradient evaluates the program and its gradient with reverse-mode
+   automatic differentiation, i.e. one forward and one backward sweep over the
+   code. gradient[j] is set to the partial derivative with respect to the
+   j-th variable. If the program is not real, the value and the gradient are
+   NaN. */
+  double Gradient(const double *values, double *gradient) const;
+
+  double Gradient(const std::vector<double> &values,
+                  std::vector<double> *gradient) const {
+    gradient->resize(variables.size());
+    return Gradient(values.data(), gradient->data());
+  }
+
+  /** EvaluateBatch evaluates the program for n points. columns[j][i] is the
+   value of the j-th variable at point i and the result for point i is
+   written to out[i]. The points are processed in blocks with vectorized
+   kernels (see VectorMath.hpp). If the program is not real, the results are
+   NaN. */
+  void EvaluateBatch(const double *const *columns, std::size_t n,
+                     double *out) const;
+
+  const std::vector<Instr> &Code() const { return code; }
+
+  const std::vector<std::complex<double>> &Constants() const {
+    return constants;
+  }
+
+  /** NumRegisters returns the size of the register file. */
+  std::size_t NumRegisters() const { return num_registers; }
+
+  /** Result returns the register which holds the result. */
+  std::uint32_t Result() const { return result; }
+
+private:
+  friend class ProgramCompiler;
+
+  std::vector<std::string> variables;
+  std::vector<std::complex<double>> constants;
+  std::vector<Instr> code;
+  std::size_t num_registers = 0;
+  std::uint32_t result = 0;
+  bool real = true;
+};
+
+} // namespace Equation
+
+#endif /* Program_hpp */
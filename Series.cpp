@@ -0,0 +1,485 @@
+//
+//  Copyright © 2017 Lennart Oymanns. All rights reserved.
+//
+#include "Series.hpp"
+#include "Error.h"
+#include "Factor.hpp"
+#include "Function.hpp"
+#include "Number.hpp"
+#include "Power.hpp"
+#include "Summand.hpp"
+#include "UnaryMinus.hpp"
+#include "Variable.hpp"
+
+using namespace Equation;
+
+namespace {
+
+typedef std::vector<NodePtr> Coefficients;
+
+/** number_value sets v to the value of n if n is a number. */
+bool number_value(const NodePtr &n, NumberRepr *v) {
+  if (n->Type() != Node::Type_t::Number) {
+    return false;
+  }
+  *v = std::static_pointer_cast<Number>(n)->GetValue();
+  return v->IsValid();
+}
+
+bool is_zero(const NodePtr &n) {
+  NumberRepr v;
+  return number_value(n, &v) && v == NumberRepr(0l);
+}
+
+bool is_one(const NodePtr &n) {
+  NumberRepr v;
+  return number_value(n, &v) && v == NumberRepr(1l);
+}
+
+/** is_integer sets i to the value of n if n is an integer which fits into a
+ long. */
+bool is_integer(const NodePtr &n, long *i) {
+  NumberRepr v;
+  if (!number_value(n, &v) || !v.IsFraction() || v.Denominator() != 1) {
+    return false;
+  }
+  auto num = v.Numerator();
+  if (num > 1000000 || num < -1000000) {
+    return false;
+  }
+  *i = num.convert_to<long>();
+  return true;
+}
+
+NodePtr number(const NumberRepr &v) { return new_node<Number>(v); }
+
+/** Sum accumulates the terms of a coefficient. Numbers are added directly,
+ all other terms are collected in a Summand which is evaluated once. */
+class Sum {
+public:
+  Sum() : constant(0l) {}
+
+  /** Add adds k*a*b. The nodes a and b are not modified. */
+  void Add(const NodePtr &a, const NodePtr &b,
+           const NumberRepr &k = NumberRepr(1l)) {
+    if (k == NumberRepr(0l) || is_zero(a) || is_zero(b)) {
+      return;
+    }
+    NumberRepr va, vb;
+    bool na = number_value(a, &va);
+    bool nb = number_value(b, &vb);
+    if (na && nb) {
+      constant += k * va * vb;
+      return;
+    }
+    auto f = new_node<Factor>();
+    NumberRepr c = k;
+    if (na) {
+      c *= va;
+    } else {
+      f->AddOp1(a->clone());
+    }
+    if (nb) {
+      c *= vb;
+    } else {
+      f->AddOp1(b->clone());
+    }
+    if (c != NumberRepr(1l)) {
+      f->AddOp1(number(c));
+    }
+    terms.push_back(f);
+  }
+
+  /** Add adds k*a. */
+  void Add(const NodePtr &a, const NumberRepr &k = NumberRepr(1l)) {
+    static const NodePtr one = std::make_shared<Number>(1l);
+    Add(a, one, k);
+  }
+
+  NodePtr Result(const StatePtr &state) {
+    if (terms.empty()) {
+      return number(constant);
+    }
+    auto s = new_node<Summand>();
+    for (const auto &t : terms) {
+      s->AddOp1(t);
+    }
+    if (constant != NumberRepr(0l)) {
+      s->AddOp1(number(constant));
+    }
+    NodePtr result = s;
+    result->Eval(&result, state);
+    return result;
+  }
+
+private:
+  NumberRepr constant;
+  std::vector<NodePtr> terms;
+};
+
+/** SeriesExpander computes the series of the nodes of an expression. All
+ series have the same length; coefficients are never modified after they
+ were computed, so they can be shared between series. */
+class SeriesExpander {
+public:
+  SeriesExpander(const std::string &variable, const NodePtr &point,
+                 std::size_t order)
+      : var(variable), x0(point), n(order + 1),
+        state(std::make_shared<DefaultState>()),
+        zero(std::make_shared<Number>(0l)), one(std::make_shared<Number>(1l)) {
+  }
+
+  Coefficients Expand(const NodePtr &node) {
+    switch (node->Type()) {
+    case Node::Type_t::Number:
+      return constant(node);
+    case Node::Type_t::Variable:
+      if (std::static_pointer_cast<Variable>(node)->Name() == var) {
+        auto c = constant(x0);
+        if (n > 1) {
+          c[1] = one;
+        }
+        return c;
+      }
+      return constant(node);
+    case Node::Type_t::Summand: {
+      auto s = std::static_pointer_cast<Summand>(node);
+      Coefficients result = constant(zero);
+      for (const auto &e : s->Data()) {
+        result = add(result, Expand(e));
+      }
+      return result;
+    }
+    case Node::Type_t::Factor: {
+      auto f = std::static_pointer_cast<Factor>(node);
+      Coefficients result = constant(one);
+      for (const auto &e : f->Data()) {
+        result = mul(result, Expand(e));
+      }
+      return result;
+    }
+    case Node::Type_t::UnaryMinus:
+      return scale(Expand(std::static_pointer_cast<UnaryMinus>(node)->Data()),
+                   NumberRepr(-1l));
+    case Node::Type_t::Power: {
+      auto p = std::static_pointer_cast<Power>(node);
+      return power(Expand(p->Base()), Expand(p->Exponent()));
+    }
+    case Node::Type_t::Function:
+      return function(*std::static_pointer_cast<Function>(node));
+    }
+    return constant(zero);
+  }
+
+private:
+  NodePtr simplify(NodePtr node) {
+    node->Eval(&node, state);
+    return node;
+  }
+
+  /** apply returns the evaluated function name at the coefficient a. */
+  NodePtr apply(const std::string &name, const NodePtr &a) {
+    auto f = new_node<Function>(name);
+    f->AddArg(a->clone());
+    return simplify(f);
+  }
+
+  /** quotient returns a / b for coefficients a and b. */
+  NodePtr quotient(const NodePtr &a, const NodePtr &b) {
+    NumberRepr va, vb;
+    if (number_value(a, &va) && number_value(b, &vb)) {
+      return number(va / vb);
+    }
+    auto f = new_node<Factor>(a->clone());
+    f->AddOp1(new_node<Power>(b->clone(), number(NumberRepr(-1l))));
+    return simplify(f);
+  }
+
+  Coefficients constant(const NodePtr &c) {
+    Coefficients result(n, zero);
+    result[0] = c->Type() == Node::Type_t::Number ? c : simplify(c->clone());
+    return result;
+  }
+
+  bool isConstant(const Coefficients &a) {
+    for (std::size_t k = 1; k < n; k++) {
+      if (!is_zero(a[k])) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  Coefficients add(const Coefficients &a, const Coefficients &b) {
+    Coefficients c(n);
+    for (std::size_t k = 0; k < n; k++) {
+      if (is_zero(a[k])) {
+        c[k] = b[k];
+      } else if (is_zero(b[k])) {
+        c[k] = a[k];
+      } else {
+        Sum s;
+        s.Add(a[k]);
+        s.Add(b[k]);
+        c[k] = s.Result(state);
+      }
+    }
+    return c;
+  }
+
+  NodePtr scale(const NodePtr &a, const NumberRepr &f) {
+    Sum s;
+    s.Add(a, f);
+    return s.Result(state);
+  }
+
+  Coefficients scale(const Coefficients &a, const NumberRepr &f) {
+    Coefficients c(n);
+    for (std::size_t k = 0; k < n; k++) {
+      c[k] = scale(a[k], f);
+    }
+    return c;
+  }
+
+  Coefficients mul(const Coefficients &a, const Coefficients &b) {
+    if (isConstant(a) && is_one(a[0])) {
+      return b;
+    }
+    Coefficients c(n);
+    for (std::size_t k = 0; k < n; k++) {
+      Sum s;
+      for (std::size_t i = 0; i <= k; i++) {
+        s.Add(a[i], b[k - i]);
+      }
+      c[k] = s.Result(state);
+    }
+    return c;
+  }
+
+  Coefficients div(const Coefficients &a, const Coefficients &b) {
+    if (is_zero(b[0])) {
+      throw InputError(0, "series does not exist (division by zero)");
+    }
+    Coefficients c(n);
+    for (std::size_t k = 0; k < n; k++) {
+      Sum s;
+      s.Add(a[k]);
+      for (std::size_t i = 1; i <= k; i++) {
+        s.Add(b[i], c[k - i], NumberRepr(-1l));
+      }
+      c[k] = quotient(s.Result(state), b[0]);
+    }
+    return c;
+  }
+
+  /** powInt returns a^m for m >= 0 by repeated squaring. */
+  Coefficients powInt(Coefficients a, long m) {
+    Coefficients result = constant(one);
+    while (m > 0) {
+      if (m & 1) {
+        result = mul(result, a);
+      }
+      m >>= 1;
+      if (m > 0) {
+        a = mul(a, a);
+      }
+    }
+    return result;
+  }
+
+  /** powNumber returns a^r for a number r. a0 must not be 0. */
+  Coefficients powNumber(const Coefficients &a, const NumberRepr &r) {
+    if (is_zero(a[0])) {
+      throw InputError(0, "series does not exist (power of zero)");
+    }
+    Coefficients p(n);
+    p[0] = simplify(new_node<Power>(a[0]->clone(), number(r)));
+    // p_k = 1/(k a0) sum_{j=1}^{k} ((r+1) j - k) a_j p_{k-j}
+    for (std::size_t k = 1; k < n; k++) {
+      Sum s;
+      for (std::size_t j = 1; j <= k; j++) {
+        NumberRepr f = (r + NumberRepr(1l)) * NumberRepr(long(j)) -
+                       NumberRepr(long(k));
+        s.Add(a[j], p[k - j], f / NumberRepr(long(k)));
+      }
+      p[k] = quotient(s.Result(state), a[0]);
+    }
+    return p;
+  }
+
+  Coefficients power(const Coefficients &a, const Coefficients &e) {
+    if (isConstant(e)) {
+      long m;
+      if (is_integer(e[0], &m)) {
+        if (m >= 0) {
+          return powInt(a, m);
+        }
+        return div(constant(one), powInt(a, -m));
+      }
+      NumberRepr r;
+      if (number_value(e[0], &r)) {
+        return powNumber(a, r);
+      }
+    }
+    // a^e = exp(e * log(a)), but the constant term is kept as a0^e0.
+    return exp(mul(e, log(a)),
+               simplify(new_node<Power>(a[0]->clone(), e[0]->clone())));
+  }
+
+  /** exp returns the series of exp(a). The constant term e0 = exp(a0) can be
+   given in another form. */
+  Coefficients exp(const Coefficients &a, const NodePtr &e0 = nullptr) {
+    Coefficients e(n);
+    e[0] = e0 ? e0 : apply("exp", a[0]);
+    // e_k = 1/k sum_{j=1}^{k} j a_j e_{k-j}
+    for (std::size_t k = 1; k < n; k++) {
+      Sum s;
+      for (std::size_t j = 1; j <= k; j++) {
+        s.Add(a[j], e[k - j], NumberRepr(long(j), long(k)));
+      }
+      e[k] = s.Result(state);
+    }
+    return e;
+  }
+
+  /** sinCos computes the series of sin(a) and cos(a), or of sinh(a) and
+   cosh(a) if hyperbolic is set. */
+  void sinCos(const Coefficients &a, bool hyperbolic, Coefficients *sin,
+              Coefficients *cos) {
+    sin->assign(n, zero);
+    cos->assign(n, zero);
+    (*sin)[0] = apply(hyperbolic ? "sinh" : "sin", a[0]);
+    (*cos)[0] = apply(hyperbolic ? "cosh" : "cos", a[0]);
+    long sign = hyperbolic ? 1 : -1;
+    for (std::size_t k = 1; k < n; k++) {
+      Sum s, c;
+      for (std::size_t j = 1; j <= k; j++) {
+        s.Add(a[j], (*cos)[k - j], NumberRepr(long(j), long(k)));
+        c.Add(a[j], (*sin)[k - j], NumberRepr(sign * long(j), long(k)));
+      }
+      (*sin)[k] = s.Result(state);
+      (*cos)[k] = c.Result(state);
+    }
+  }
+
+  /** integral returns the series of f(a) with the derivative f'(a) = g. */
+  Coefficients integral(const std::string &name, const Coefficients &a,
+                        const Coefficients &g) {
+    Coefficients da(n, zero);
+    for (std::size_t k = 0; k + 1 < n; k++) {
+      da[k] = scale(a[k + 1], NumberRepr(long(k + 1)));
+    }
+    auto t = mul(g, da);
+    Coefficients r(n);
+    r[0] = apply(name, a[0]);
+    for (std::size_t k = 1; k < n; k++) {
+      r[k] = scale(t[k - 1], NumberRepr(1l, long(k)));
+    }
+    return r;
+  }
+
+  Coefficients log(const Coefficients &a) {
+    return integral("log", a, div(constant(one), a));
+  }
+
+  /** squarePlus returns a^2 + c. */
+  Coefficients squarePlus(const Coefficients &a, long c) {
+    return add(mul(a, a), constant(number(NumberRepr(c))));
+  }
+
+  /** oneMinusSquare returns 1 - a^2. It is not built as -(a^2 - 1), because
+   a power of the latter would be split into (-1)^r * (a^2 - 1)^r. */
+  Coefficients oneMinusSquare(const Coefficients &a) {
+    return add(constant(one), scale(mul(a, a), NumberRepr(-1l)));
+  }
+
+  Coefficients function(const Function &f) {
+    const auto &name = f.Name();
+    if (f.Args().size() != 1) {
+      throw InputError(0, "cannot expand '" + name + "' as a series");
+    }
+    auto a = Expand(f.Args()[0]);
+    if (isConstant(a)) {
+      return constant(apply(name, a[0]));
+    }
+    Coefficients s, c;
+    const NumberRepr minus_half(-1l, 2l);
+    if (name == "exp") {
+      return exp(a);
+    } else if (name == "log") {
+      return log(a);
+    } else if (name == "sqrt") {
+      return powNumber(a, NumberRepr(1l, 2l));
+    } else if (name == "sin" || name == "cos" || name == "tan") {
+      sinCos(a, false, &s, &c);
+      return name == "sin" ? s : name == "cos" ? c : div(s, c);
+    } else if (name == "sinh" || name == "cosh" || name == "tanh") {
+      sinCos(a, true, &s, &c);
+      return name == "sinh" ? s : name == "cosh" ? c : div(s, c);
+    } else if (name == "asin") {
+      return integral(name, a, powNumber(oneMinusSquare(a), minus_half));
+    } else if (name == "acos") {
+      return integral(name, a,
+                      scale(powNumber(oneMinusSquare(a), minus_half),
+                            NumberRepr(-1l)));
+    } else if (name == "atan") {
+      return integral(name, a, div(constant(one), squarePlus(a, 1)));
+    } else if (name == "arsinh") {
+      return integral(name, a, powNumber(squarePlus(a, 1), minus_half));
+    } else if (name == "arcosh") {
+      return integral(name, a, powNumber(squarePlus(a, -1), minus_half));
+    } else if (name == "artanh") {
+      return integral(name, a, div(constant(one), oneMinusSquare(a)));
+    }
+    throw InputError(0, "cannot expand '" + name + "' as a series");
+  }
+
+  std::string var;
+  NodePtr x0;
+  std::size_t n;
+  StatePtr state;
+  NodePtr zero;
+  NodePtr one;
+};
+
+} // namespace
+
+Series Series::Expand(const NodePtr &f, const std::string &var,
+                      const NodePtr &x0, std::size_t order) {
+  SeriesExpander expander(var, x0, order);
+  Series s;
+  s.coefficients = expander.Expand(f);
+  return s;
+}
+
+NodePtr Series::Derivative(std::size_t k) const {
+  NumberRepr factorial(1l);
+  for (std::size_t i = 2; i <= k; i++) {
+    factorial *= NumberRepr(long(i));
+  }
+  NodePtr result = new_node<Factor>(coefficients[k]->clone());
+  std::static_pointer_cast<Factor>(result)->AddOp1(new_node<Number>(factorial));
+  result->Eval(&result, std::make_shared<DefaultState>());
+  return result;
+}
+
+NodePtr Series::Polynomial(const NodePtr &h) const {
+  auto sum = new_node<Summand>();
+  for (std::size_t k = 0; k < coefficients.size(); k++) {
+    if (is_zero(coefficients[k])) {
+      continue;
+    }
+    auto term = new_node<Factor>(coefficients[k]->clone());
+    if (k > 0) {
+      term->AddOp1(
+          new_node<Power>(h->clone(), new_node<Number>(NumberRepr(long(k)))));
+    }
+    sum->AddOp1(term);
+  }
+  NodePtr result = sum;
+  if (sum->Data().size() == 0) {
+    result = new_node<Number>(0l);
+  }
+  result->Eval(&result, std::make_shared<DefaultState>());
+  return result;
+}
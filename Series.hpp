@@ -0,0 +1,56 @@
+//
+//  Copyright © 2017 Lennart Oymanns. All rights reserved.
+//
+
+#ifndef Series_hpp
+#define Series_hpp
+
+#include <string>
+#include <vector>
+
+#include "Node.hpp"
+
+namespace Equation {
+
+/** Series is a truncated power series c0 + c1*h + ... + cn*h^n.
+
+ Expand computes the Taylor series of an expression with truncated series
+ arithmetic (Taylor-mode automatic differentiation): every node of the
+ expression becomes a series and operations on series use the usual
+ recurrences, e.g. the Cauchy product for a product. Computing n
+ coefficients costs O(n^2) coefficient operations per node, instead of the
+ exponential growth of repeated symbolic differentiation.
+
+ The coefficients are evaluated nodes. Numbers are combined directly, so a
+ series at a rational point of an expression without functions is computed
+ with exact arithmetic on numbers only. */
+class Series {
+public:
+  /** Expand returns the series of f(x0 + h) in h up to order n, where x is
+   the variable var. x0 can be any expression, e.g. the variable itself. It
+   throws an InputError if f contains a function which cannot be expanded or
+   the series does not exist, e.g. for sqrt(x) at x0 = 0. */
+  static Series Expand(const NodePtr &f, const std::string &var,
+                       const NodePtr &x0, std::size_t order);
+
+  /** Order returns the highest power of the series. */
+  std::size_t Order() const { return coefficients.size() - 1; }
+
+  /** Coefficient returns the coefficient of h^k. The node must not be
+   modified. */
+  const NodePtr &Coefficient(std::size_t k) const { return coefficients[k]; }
+
+  /** Derivative returns the k-th derivative of f at x0, i.e. k! * ck. */
+  NodePtr Derivative(std::size_t k) const;
+
+  /** Polynomial returns the evaluated polynomial c0 + c1*h + ... with the
+   expression h. */
+  NodePtr Polynomial(const NodePtr &h) const;
+
+private:
+  std::vector<NodePtr> coefficients;
+};
+
+} // namespace Equation
+
+#endif /* Series_hpp */
@@ -0,0 +1,265 @@
+//
+//  Copyright © 2017 Lennart Oymanns. All rights reserved.
+//
+
+#ifndef SmallVector_hpp
+#define SmallVector_hpp
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace Equation {
+
+/** SmallVector is a contiguous sequence container with inline storage for N
+ elements.
+
+ As long as the container holds at most N elements, no heap memory is used.
+ The interface follows std::vector. Additionally, SmallVector provides the
+ list operations which are used on operands (push_front, pop_front, sort,
+ remove_if). Iterators are invalidated by every operation which inserts or
+ erases elements. */
+template <class T, std::size_t N> class SmallVector {
+public:
+  typedef T value_type;
+  typedef std::size_t size_type;
+  typedef T &reference;
+  typedef const T &const_reference;
+  typedef T *iterator;
+  typedef const T *const_iterator;
+
+  SmallVector() : ptr(inlineData()), count(0), cap(N) {}
+
+  SmallVector(std::initializer_list<T> l) : SmallVector() {
+    reserve(l.size());
+    for (const auto &e : l) {
+      push_back(e);
+    }
+  }
+
+  template <class It,
+            class = typename std::iterator_traits<It>::iterator_category>
+  SmallVector(It first, It last) : SmallVector() {
+    for (; first != last; ++first) {
+      push_back(*first);
+    }
+  }
+
+  SmallVector(const SmallVector &o) : SmallVector() {
+    reserve(o.size());
+    for (const auto &e : o) {
+      push_back(e);
+    }
+  }
+
+  SmallVector(SmallVector &&o) : SmallVector() { steal(o); }
+
+  ~SmallVector() {
+    clear();
+    release();
+  }
+
+  SmallVector &operator=(const SmallVector &o) {
+    if (this != &o) {
+      clear();
+      reserve(o.size());
+      for (const auto &e : o) {
+        push_back(e);
+      }
+    }
+    return *this;
+  }
+
+  SmallVector &operator=(SmallVector &&o) {
+    if (this != &o) {
+      clear();
+      release();
+      ptr = inlineData();
+      cap = N;
+      steal(o);
+    }
+    return *this;
+  }
+
+  iterator begin() { return ptr; }
+  iterator end() { return ptr + count; }
+  const_iterator begin() const { return ptr; }
+  const_iterator end() const { return ptr + count; }
+
+  size_type size() const { return count; }
+  bool empty() const { return count == 0; }
+
+  reference operator[](size_type i) { return ptr[i]; }
+  const_reference operator[](size_type i) const { return ptr[i]; }
+
+  reference front() { return ptr[0]; }
+  const_reference front() const { return ptr[0]; }
+  reference back() { return ptr[count - 1]; }
+  const_reference back() const { return ptr[count - 1]; }
+
+  void reserve(size_type n) {
+    if (n > cap) {
+      grow(n);
+    }
+  }
+
+  void push_back(const T &v) {
+    if (count == cap) {
+      T tmp(v); // v might be an element of this container
+      grow(2 * cap);
+      new (ptr + count) T(std::move(tmp));
+    } else {
+      new (ptr + count) T(v);
+    }
+    count++;
+  }
+
+  void push_back(T &&v) {
+    if (count == cap) {
+      T tmp(std::move(v));
+      grow(2 * cap);
+      new (ptr + count) T(std::move(tmp));
+    } else {
+      new (ptr + count) T(std::move(v));
+    }
+    count++;
+  }
+
+  void pop_back() {
+    count--;
+    ptr[count].~T();
+  }
+
+  void push_front(const T &v) { insert(begin(), v); }
+
+  void pop_front() { erase(begin()); }
+
+  iterator insert(const_iterator pos, const T &v) {
+    size_type index = pos - begin();
+    push_back(v);
+    std::rotate(begin() + index, end() - 1, end());
+    return begin() + index;
+  }
+
+  /** insert inserts the elements [first, last) before pos. The range must not
+   be part of this container. */
+  template <class It> iterator insert(const_iterator pos, It first, It last) {
+    size_type index = pos - begin();
+    size_type old = count;
+    for (; first != last; ++first) {
+      push_back(*first);
+    }
+    std::rotate(begin() + index, begin() + old, end());
+    return begin() + index;
+  }
+
+  iterator erase(const_iterator pos) {
+    iterator p = begin() + (pos - begin());
+    std::move(p + 1, end(), p);
+    pop_back();
+    return p;
+  }
+
+  iterator erase(const_iterator first, const_iterator last) {
+    iterator f = begin() + (first - begin());
+    iterator l = begin() + (last - begin());
+    iterator e = std::move(l, end(), f);
+    while (end() != e) {
+      pop_back();
+    }
+    return f;
+  }
+
+  /** remove_if removes all elements for which pred returns true and compacts
+   the remaining elements in a single pass. pred is called exactly once for
+   each element in order, so it may have side effects (e.g. accumulate the
+   removed elements). The order of the remaining elements is preserved. */
+  template <class Pred> void remove_if(Pred pred) {
+    iterator out = begin();
+    for (iterator it = begin(); it != end(); ++it) {
+      if (!pred(*it)) {
+        if (out != it) {
+          *out = std::move(*it);
+        }
+        ++out;
+      }
+    }
+    erase(out, end());
+  }
+
+  /** sort sorts the elements. Like std::list::sort, the sort is stable. */
+  template <class Compare> void sort(Compare comp) {
+    if (count > 32) {
+      std::stable_sort(begin(), end(), comp);
+      return;
+    }
+    // short sequences are sorted by a binary insertion sort which does not
+    // need any extra memory.
+    for (iterator it = begin(); it != end(); ++it) {
+      auto pos = std::upper_bound(begin(), it, *it, comp);
+      std::rotate(pos, it, it + 1);
+    }
+  }
+
+  void clear() {
+    while (count > 0) {
+      pop_back();
+    }
+  }
+
+private:
+  T *inlineData() { return reinterpret_cast<T *>(&storage); }
+
+  bool isInline() const {
+    return ptr == reinterpret_cast<const T *>(&storage);
+  }
+
+  void grow(size_type n) {
+    T *p = static_cast<T *>(::operator new(n * sizeof(T)));
+    for (size_type i = 0; i < count; i++) {
+      new (p + i) T(std::move(ptr[i]));
+      ptr[i].~T();
+    }
+    release();
+    ptr = p;
+    cap = n;
+  }
+
+  void release() {
+    if (!isInline()) {
+      ::operator delete(ptr);
+    }
+  }
+
+  /** steal moves the elements of o to this container. This container must be
+   empty and use its inline storage. */
+  void steal(SmallVector &o) {
+    if (o.isInline()) {
+      for (size_type i = 0; i < o.count; i++) {
+        new (ptr + i) T(std::move(o.ptr[i]));
+      }
+      count = o.count;
+      o.clear();
+      return;
+    }
+    ptr = o.ptr;
+    count = o.count;
+    cap = o.cap;
+    o.ptr = o.inlineData();
+    o.count = 0;
+    o.cap = N;
+  }
+
+  typename std::aligned_storage<N * sizeof(T), alignof(T)>::type storage;
+  T *ptr;
+  size_type count;
+  size_type cap;
+};
+
+} // namespace Equation
+
+#endif /* SmallVector_hpp */
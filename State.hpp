@@ -6,26 +6,36 @@
 #define State_hpp
 
 #include <iostream>
-#include <list>
 #include <map>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include "NumberRepr.hpp"
+#include "SmallVector.hpp"
 
 namespace Equation {
 
+class Builtins;
 class UserFunction;
 class Node;
 typedef std::shared_ptr<Node> NodePtr;
 
+/** NodeList holds the operands of a node, e.g. the summands of a sum or the
+ arguments of a function. */
+typedef SmallVector<NodePtr, 6> NodeList;
+
+/** State holds the variables and functions which are known during the
+ evaluation of an equation.
+
+ Variables and functions set on a state hide the builtins (see Builtins) of
+ the same name. A plain State has no builtins. */
 class State {
 public:
   bool IsFunction(const std::string &name);
   bool IsVariable(const std::string &name);
 
-  NodePtr EvalFunction(const std::string &name, const std::list<NodePtr> &x,
+  NodePtr EvalFunction(const std::string &name, const NodeList &x,
                        bool numeric);
   NodePtr GetVariable(const std::string &name);
 
@@ -34,10 +44,15 @@ public:
   }
 
 protected:
+  UserFunction *findFunction(const std::string &name);
+
   std::map<std::string, std::shared_ptr<UserFunction>> funcs;
   std::map<std::string, NodePtr> variables;
+  const Builtins *builtins = nullptr;
 };
 
+/** DefaultState is a state with the builtin functions and constants. The
+ builtins are shared by all states, so creating a DefaultState is cheap. */
 class DefaultState : public State {
 public:
   DefaultState();
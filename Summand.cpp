@@ -3,16 +3,20 @@
 //
 
 #include <algorithm>
+#include <unordered_map>
+#include <vector>
 
 #include "ComplexNumber.hpp"
 #include "Factor.hpp"
 #include "Number.hpp"
+#include "Polynomial.hpp"
+#include "Power.hpp"
 #include "Summand.hpp"
 #include "UnaryMinus.hpp"
 
 using namespace Equation;
 
-static bool comparator_sum(NodePtr &first, NodePtr &second) {
+static bool comparator_sum(const NodePtr &first, const NodePtr &second) {
   auto cplx1 = complex_number(first);
   if (!cplx1.second) {
     return false;
@@ -37,7 +41,7 @@ void Summand::ToStream(std::ostream &s) {
         auto un = std::static_pointer_cast<UnaryMinus>(e);
         un->ToStreamAbs(s);
       } else if (e->Type() == Node::Type_t::Factor) {
-        auto factor = std::static_pointer_cast<Factor>(e);
+        auto factor = std::static_pointer_cast<const Factor>(e);
         auto pre = factor->Data().begin();
         if ((*pre)->Type() == Node::Type_t::Number) {
           auto nb = std::static_pointer_cast<Number>(*pre);
@@ -82,7 +86,7 @@ void Summand::ToLatex(std::ostream &s) {
         auto un = std::static_pointer_cast<UnaryMinus>(e);
         un->ToStreamAbs(s);
       } else if (e->Type() == Node::Type_t::Factor) {
-        auto factor = std::static_pointer_cast<Factor>(e);
+        auto factor = std::static_pointer_cast<const Factor>(e);
         auto pre = factor->Data().begin();
         if ((*pre)->Type() == Node::Type_t::Number) {
           auto nb = std::static_pointer_cast<Number>(*pre);
@@ -118,71 +122,221 @@ void Summand::ToLatex(std::ostream &s) {
   }
 }
 
-std::pair<NumberRepr, NodePtr> clone_expr_wo_coeff(NodePtr n) {
-  if (n->Type() == Node::Type_t::Factor) {
+namespace {
 
-    auto factor = std::static_pointer_cast<Factor>(n);
-    auto it_first = factor->Data().begin();
-
-    std::shared_ptr<Factor> factor_new;
-    NodePtr result;
-    auto type = (*it_first)->Type();
-    if (type == Node::Type_t::Number) {
-      factor_new = std::static_pointer_cast<Factor>(factor->clone());
-      factor_new->Data().pop_front();
-      if (factor_new->Data().size() == 1) {
-        result = factor_new->Data().front();
-      } else if (factor_new->Data().size() == 0) {
-        return std::pair<NumberRepr, NodePtr>(NumberRepr(1l),
-                                              (*it_first)->clone());
-      } else {
-        result = factor_new;
-      }
-      const auto coeff = std::static_pointer_cast<Number>(*it_first);
-      return std::pair<NumberRepr, NodePtr>(coeff->GetValue(), result);
+/** Term is a summand split into its numerical coefficient and the remaining
+ expression, e.g. 3*x*y is split into 3 and x*y. */
+struct Term {
+  NumberRepr coeff;
+  NodePtr expr;
+};
+
+/** split_coeff splits the summand n into coefficient and expression. The
+ operands of n are not copied, i.e. the expression shares its nodes with n. */
+Term split_coeff(const NodePtr &n) {
+  if (n->Type() == Node::Type_t::Factor) {
+    auto factor = std::static_pointer_cast<const Factor>(n);
+    const auto &data = factor->Data();
+    if (data.size() < 2 || data.front()->Type() != Node::Type_t::Number) {
+      return Term{NumberRepr(1l), n};
+    }
+    const auto coeff = std::static_pointer_cast<Number>(data.front());
+    if (data.size() == 2) {
+      return Term{coeff->GetValue(), data.back()};
     }
-    return std::pair<NumberRepr, NodePtr>(NumberRepr(1l), n->clone());
+    auto rest = new_node<Factor>();
+    rest->Data().insert(rest->Data().end(), data.begin() + 1, data.end());
+    return Term{coeff->GetValue(), rest};
   }
   if (n->Type() == Node::Type_t::UnaryMinus) {
-    auto un = std::static_pointer_cast<UnaryMinus>(n);
-    auto res = clone_expr_wo_coeff(un->Data());
-    res.first *= NumberRepr(-1l);
+    auto un = std::static_pointer_cast<const UnaryMinus>(n);
+    auto res = split_coeff(un->Data());
+    res.coeff *= NumberRepr(-1l);
     return res;
   }
 
-  return std::pair<NumberRepr, NodePtr>(NumberRepr(1l), n->clone());
+  return Term{NumberRepr(1l), n};
+}
+
+/** max_expanded_terms is the largest number of terms of a sum which is
+ multiplied out by Summand::cancelPolynomial. */
+const std::size_t max_expanded_terms = 64;
+
+/** has_sum returns true if the summand n is a product or power of sums. */
+bool has_sum(const NodePtr &n) {
+  switch (n->Type()) {
+  case Node::Type_t::Summand:
+    return true;
+  case Node::Type_t::UnaryMinus:
+    return has_sum(std::static_pointer_cast<UnaryMinus>(n)->Data());
+  case Node::Type_t::Power:
+    return has_sum(std::static_pointer_cast<Power>(n)->Base());
+  case Node::Type_t::Factor:
+    for (const auto &e : std::static_pointer_cast<Factor>(n)->Data()) {
+      if (has_sum(e)) {
+        return true;
+      }
+    }
+    return false;
+  default:
+    return false;
+  }
+}
+
+/** expanded_terms returns an upper bound of the number of terms of n after
+ multiplying out, or a number >= limit. */
+std::size_t expanded_terms(const NodePtr &n, std::size_t limit) {
+  switch (n->Type()) {
+  case Node::Type_t::Summand: {
+    std::size_t size = 0;
+    for (const auto &e : std::static_pointer_cast<Summand>(n)->Data()) {
+      size += expanded_terms(e, limit);
+      if (size >= limit) {
+        return limit;
+      }
+    }
+    return size;
+  }
+  case Node::Type_t::UnaryMinus:
+    return expanded_terms(std::static_pointer_cast<UnaryMinus>(n)->Data(),
+                          limit);
+  case Node::Type_t::Factor: {
+    std::size_t size = 1;
+    for (const auto &e : std::static_pointer_cast<Factor>(n)->Data()) {
+      size *= expanded_terms(e, limit);
+      if (size >= limit) {
+        return limit;
+      }
+    }
+    return size;
+  }
+  case Node::Type_t::Power: {
+    auto p = std::static_pointer_cast<Power>(n);
+    if (p->Exponent()->Type() != Node::Type_t::Number) {
+      return 1;
+    }
+    auto e = std::static_pointer_cast<Number>(p->Exponent())->GetValue();
+    if (!e.IsFraction() || e.Denominator() != 1 || e.Numerator() < 1) {
+      return 1;
+    }
+    auto k = expanded_terms(p->Base(), limit);
+    if (k <= 1) {
+      return k;
+    }
+    if (e.Numerator() >= limit) {
+      return limit;
+    }
+    // (a_1 + ... + a_k)^m has binomial(m + k - 1, k - 1) terms.
+    auto m = e.Numerator().convert_to<std::size_t>();
+    std::size_t size = 1;
+    for (std::size_t i = 1; i < k; i++) {
+      size = size * (m + i) / i;
+      if (size >= limit) {
+        return limit;
+      }
+    }
+    return size;
+  }
+  default:
+    return 1;
+  }
+}
+
+} // namespace
+
+/** cancelPolynomial multiplies out a polynomial of variables which contains
+ products or powers of sums if terms cancel, e.g. (x+1)^2 - x^2 - 1 = 2*x.
+ The expanded form is only used if it has fewer terms than the sum, i.e.
+ (x+1)^2 + 1 is kept as it is. Sums whose expansion would have more than
+ max_expanded_terms terms are not expanded. */
+bool Summand::cancelPolynomial() {
+  bool products = false;
+  std::size_t size = 0;
+  for (const auto &e : op1) {
+    products = products || has_sum(e);
+    size += expanded_terms(e, max_expanded_terms + 1);
+    if (size > max_expanded_terms) {
+      return false;
+    }
+  }
+  if (!products) {
+    return false;
+  }
+  PolynomialRing ring;
+  for (const auto &e : op1) {
+    if (!ring.Add(e)) {
+      return false;
+    }
+  }
+  if (!ring.HasOnlyVariables()) {
+    return false;
+  }
+  Polynomial p(ring.Generators().size());
+  for (const auto &e : op1) {
+    p = p + ring.FromNode(e);
+  }
+  if (p.NumTerms() >= op1.size()) {
+    return false;
+  }
+  auto expanded = ring.ToNode(p);
+  op1.clear();
+  if (expanded->Type() == Node::Type_t::Summand) {
+    op1 = std::static_pointer_cast<Summand>(expanded)->Data();
+  } else if (!p.IsZero()) {
+    op1.push_back(expanded);
+  }
+  return true;
 }
 
+/** simplify collects like terms, e.g. 2*x + y + 3*x = 5*x + y.
+
+ Terms are grouped by the hash of the expression without coefficient, so the
+ collection is linear in the number of summands. The order of the summands is
+ the order of their first occurrence. */
 void Summand::simplify() {
-  std::list<std::pair<NumberRepr, NodePtr> > polynom;
+  if (cancelPolynomial()) {
+    return;
+  }
+  std::vector<Term> terms;
+  terms.reserve(op1.size());
+  std::unordered_multimap<std::size_t, std::size_t> index;
+  index.reserve(op1.size());
   for (auto &e : op1) {
-    auto nom = clone_expr_wo_coeff(e);
-    auto pos = std::find_if(polynom.begin(), polynom.end(),
-                            [&nom](const std::pair<NumberRepr, NodePtr> &n) {
-      return n.second->equals(nom.second);
-    });
-    if (pos == polynom.end()) {
-      polynom.push_back(nom);
+    auto term = split_coeff(e);
+    auto h = term.expr->Hash();
+    auto pos = terms.size();
+    auto range = index.equal_range(h);
+    for (auto it = range.first; it != range.second; it++) {
+      if (terms[it->second].expr->equals(term.expr)) {
+        pos = it->second;
+        break;
+      }
+    }
+    if (pos == terms.size()) {
+      index.emplace(h, terms.size());
+      terms.push_back(term);
     } else {
-      pos->first += nom.first;
+      terms[pos].coeff += term.coeff;
     }
   }
   // fill new summands
   op1.clear();
-  for (auto &e : polynom) {
-    if (e.first == NumberRepr(1l)) {
-      op1.push_back(e.second);
-    } else if (e.first == NumberRepr(0l)) {
+  for (auto &e : terms) {
+    if (e.coeff == NumberRepr(1l)) {
+      op1.push_back(e.expr);
+    } else if (e.coeff == NumberRepr(0l)) {
       continue;
     } else {
-      auto coeff = std::make_shared<Number>(e.first);
-      std::shared_ptr<Factor> factor;
-      if (e.second->Type() == Node::Type_t::Factor) {
-        factor = std::static_pointer_cast<Factor>(e.second);
-        factor->Data().push_front(coeff);
+      auto coeff = new_node<Number>(e.coeff);
+      // e.expr may be an operand of the original summand, so it is not
+      // modified.
+      auto factor = new_node<Factor>(coeff);
+      if (e.expr->Type() == Node::Type_t::Factor) {
+        const auto &data =
+            std::static_pointer_cast<const Factor>(e.expr)->Data();
+        factor->Data().insert(factor->Data().end(), data.begin(), data.end());
       } else {
-        factor = std::make_shared<Factor>(coeff);
-        factor->AddOp1(e.second);
+        factor->AddOp1(e.expr);
       }
       op1.push_back(factor);
     }
@@ -203,7 +357,7 @@ void Summand::Eval(NodePtr *base, std::shared_ptr<State> state, bool numeric) {
   simplify();
 
   if (base && op1.size() == 0) {
-    base->reset(new Number(0l));
+    *base = new_node<Number>(0l);
     return;
   }
 
@@ -212,4 +366,6 @@ void Summand::Eval(NodePtr *base, std::shared_ptr<State> state, bool numeric) {
     return;
   }
   op1.sort(comparator_sum);
+  // the operands were modified in place.
+  invalidateHash();
 }
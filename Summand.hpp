@@ -32,10 +32,11 @@ public:
   virtual void Eval(NodePtr *base, std::shared_ptr<State> state,
                     bool numeric = false);
 
-  virtual NodePtr clone() const { return std::make_shared<Summand>(*this); }
+  virtual NodePtr clone() const { return new_node<Summand>(*this); }
 
 private:
   void simplify();
+  bool cancelPolynomial();
 };
 } // namespace Equation
 
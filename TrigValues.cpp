@@ -0,0 +1,340 @@
+//
+//  Copyright © 2017 Lennart Oymanns. All rights reserved.
+//
+#include <map>
+#include <string>
+#include <tuple>
+
+#include "Canonical.hpp"
+#include "Factor.hpp"
+#include "Number.hpp"
+#include "Summand.hpp"
+#include "TrigValues.hpp"
+#include "UnaryMinus.hpp"
+#include "UserFunction.hpp"
+#include "Variable.hpp"
+
+using namespace Equation;
+
+namespace {
+
+/** ClosedForm is the value of sin and tan at p/q*pi. */
+struct ClosedForm {
+  long p;
+  long q;
+  const char *sin;
+  const char *tan;
+};
+
+// the angles of the first quadrant whose values are known in closed form.
+// The values at the other angles are derived from these with the half-angle
+// and angle-sum formulas.
+const ClosedForm first_quadrant[] = {
+    {0, 1, "0", "0"},
+    {1, 12, "(6^(1/2)-2^(1/2))/4", "2-3^(1/2)"},
+    {1, 10, "(5^(1/2)-1)/4", "(25-10*5^(1/2))^(1/2)/5"},
+    {1, 8, "(2-2^(1/2))^(1/2)/2", "2^(1/2)-1"},
+    {1, 6, "1/2", "3^(1/2)/3"},
+    {1, 5, "(10-2*5^(1/2))^(1/2)/4", "(5-2*5^(1/2))^(1/2)"},
+    {1, 4, "2^(1/2)/2", "1"},
+    {3, 10, "(5^(1/2)+1)/4", "(25+10*5^(1/2))^(1/2)/5"},
+    {1, 3, "3^(1/2)/2", "3^(1/2)"},
+    {3, 8, "(2+2^(1/2))^(1/2)/2", "2^(1/2)+1"},
+    {2, 5, "(10+2*5^(1/2))^(1/2)/4", "(5+2*5^(1/2))^(1/2)"},
+    {5, 12, "(6^(1/2)+2^(1/2))/4", "2+3^(1/2)"},
+    {1, 2, "1", nullptr},
+};
+
+// 16, 20 and 24 are halves of 8, 10 and 12. 15 is the sum of thirds and
+// fifths.
+const long denominators[] = {1, 2, 3, 4, 5, 6, 8, 10, 12, 15, 16, 20, 24};
+
+const long max_denominator = 24;
+
+long gcd(long a, long b) {
+  while (b != 0) {
+    auto t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+/** Angle is the angle p/q*pi of the first quadrant and the sign of the
+ function value. */
+struct Angle {
+  long p;
+  long q;
+  bool negative;
+};
+
+Angle make_angle(long k, long n, bool negative) {
+  auto g = gcd(k, n);
+  return Angle{k / g, n / g, negative};
+}
+
+/** sin_angle reduces sin(k/n*pi) with 0 <= k < 2n to the first quadrant. */
+Angle sin_angle(long k, long n) {
+  bool negative = false;
+  if (k >= n) {
+    // sin(x+pi) = -sin(x)
+    k -= n;
+    negative = true;
+  }
+  if (2 * k > n) {
+    // sin(pi-x) = sin(x)
+    k = n - k;
+  }
+  return make_angle(k, n, negative);
+}
+
+/** cos_angle reduces cos(k/n*pi) with 0 <= k < 2n to the first quadrant. */
+Angle cos_angle(long k, long n) {
+  if (k > n) {
+    // cos(2*pi-x) = cos(x)
+    k = 2 * n - k;
+  }
+  bool negative = false;
+  if (2 * k > n) {
+    // cos(pi-x) = -cos(x)
+    k = n - k;
+    negative = true;
+  }
+  return make_angle(k, n, negative);
+}
+
+/** tan_angle reduces tan(k/n*pi) with 0 <= k < 2n to the first quadrant. */
+Angle tan_angle(long k, long n) {
+  // tan(x+pi) = tan(x)
+  k %= n;
+  bool negative = false;
+  if (2 * k > n) {
+    // tan(pi-x) = -tan(x)
+    k = n - k;
+    negative = true;
+  }
+  return make_angle(k, n, negative);
+}
+
+/** reduce reduces f(k/n*pi) with any integer k to the first quadrant. */
+Angle reduce(Trig f, long k, long n) {
+  k %= 2 * n;
+  if (k < 0) {
+    k += 2 * n;
+  }
+  switch (f) {
+  case Trig::Sin:
+    return sin_angle(k, n);
+  case Trig::Cos:
+    return cos_angle(k, n);
+  default:
+    return tan_angle(k, n);
+  }
+}
+
+/** negate returns -n. A sum is negated term by term, so that -(2+3^(1/2)) is
+ stored as -3^(1/2) - 2 like any other evaluated sum. */
+NodePtr negate(const NodePtr &n, const std::shared_ptr<State> &state) {
+  NodePtr res;
+  if (n->Type() == Node::Type_t::Summand) {
+    auto sum = new_node<Summand>();
+    for (const auto &e : std::static_pointer_cast<Summand>(n)->Data()) {
+      sum->AddOp1(new_node<UnaryMinus>(e->clone()));
+    }
+    res = sum;
+  } else {
+    res = new_node<UnaryMinus>(n->clone());
+  }
+  res->Eval(&res, state);
+  return res;
+}
+
+class TrigTable {
+public:
+  static const TrigTable &Get() {
+    // initialization of a local static is thread safe.
+    static const TrigTable table;
+    return table;
+  }
+
+  NodePtr Find(Trig f, long k, long n) const {
+    auto it = values.find(std::make_tuple(f, k, n));
+    if (it == values.end()) {
+      return 0;
+    }
+    return it->second;
+  }
+
+private:
+  /** Forms are sin, cos and tan at an angle of the first quadrant. An empty
+   tan is undefined. */
+  struct Forms {
+    std::string sin;
+    std::string cos;
+    std::string tan;
+  };
+
+  TrigTable() {
+    // the table outlives every arena.
+    NodeArena::Scope heap(nullptr);
+
+    for (const auto &c : first_quadrant) {
+      forms[std::make_pair(c.p, c.q)] =
+          Forms{c.sin, "", c.tan == nullptr ? "" : c.tan};
+    }
+    // cos(x) = sin(pi/2-x)
+    for (auto &f : forms) {
+      auto p = f.first.first;
+      auto q = f.first.second;
+      f.second.cos = str(Trig::Sin, q - 2 * p, 2 * q);
+    }
+    halve(8);
+    halve(10);
+    halve(12);
+    add(3, 5);
+
+    auto state = std::make_shared<State>();
+    std::map<std::tuple<Trig, long, long>, NodePtr> exact;
+    auto value = [&](Trig f, long k, long n) -> NodePtr {
+      auto a = reduce(f, k, n);
+      auto key = std::make_tuple(f, a.p, a.q);
+      auto it = exact.find(key);
+      if (it == exact.end()) {
+        const auto &s = forms.at(std::make_pair(a.p, a.q));
+        const auto &v =
+            f == Trig::Sin ? s.sin : (f == Trig::Cos ? s.cos : s.tan);
+        it = exact.emplace(key, v.empty() ? 0 : UserFunction::make_node(v))
+                 .first;
+      }
+      if (!it->second || !a.negative) {
+        return it->second;
+      }
+      return negate(it->second, state);
+    };
+
+    for (auto n : denominators) {
+      for (long k = 0; k < 2 * n; k++) {
+        for (auto f : {Trig::Sin, Trig::Cos, Trig::Tan}) {
+          auto v = value(f, k, n);
+          if (v) {
+            // the entries are shared between threads.
+            cache_canonical(v);
+          }
+          values[std::make_tuple(f, k, n)] = v;
+        }
+      }
+    }
+  }
+
+  /** str returns f(k/n*pi) as a string which can be used in a product. */
+  std::string str(Trig f, long k, long n) const {
+    auto a = reduce(f, k, n);
+    const auto &s = forms.at(std::make_pair(a.p, a.q));
+    const auto &v = f == Trig::Sin ? s.sin : (f == Trig::Cos ? s.cos : s.tan);
+    return a.negative ? "(-(" + v + "))" : "(" + v + ")";
+  }
+
+  /** halve adds the angles p/(2m)*pi with gcd(p, 2m) = 1 using the
+   half-angle formulas sin(x/2) = ((1-cos(x))/2)^(1/2),
+   cos(x/2) = ((1+cos(x))/2)^(1/2) and tan(x/2) = (1-cos(x))/sin(x). */
+  void halve(long m) {
+    for (long p = 1; p < m; p += 2) {
+      if (gcd(p, m) != 1) {
+        continue;
+      }
+      auto c = str(Trig::Cos, p, m);
+      auto s = str(Trig::Sin, p, m);
+      forms[std::make_pair(p, 2 * m)] =
+          Forms{"((1-" + c + ")/2)^(1/2)", "((1+" + c + ")/2)^(1/2)",
+                "(1-" + c + ")/" + s};
+    }
+  }
+
+  /** add adds the angles p/(m*n)*pi of the first quadrant with gcd(p, m*n)
+   = 1 for coprime m and n. The angle is written as a/m*pi + b/n*pi and
+   computed with the angle-sum formulas. */
+  void add(long m, long n) {
+    auto q = m * n;
+    for (long p = 1; 2 * p < q; p++) {
+      if (gcd(p, q) != 1) {
+        continue;
+      }
+      // p = a*n + b*m
+      long a = 0;
+      while ((p - a * n) % m != 0) {
+        a++;
+      }
+      auto b = (p - a * n) / m;
+      auto sa = str(Trig::Sin, a, m);
+      auto ca = str(Trig::Cos, a, m);
+      auto sb = str(Trig::Sin, b, n);
+      auto cb = str(Trig::Cos, b, n);
+      auto s = sa + "*" + cb + "+" + ca + "*" + sb;
+      auto c = ca + "*" + cb + "-" + sa + "*" + sb;
+      forms[std::make_pair(p, q)] =
+          Forms{s, c, "(" + s + ")/(" + c + ")"};
+    }
+  }
+
+  std::map<std::pair<long, long>, Forms> forms;
+  std::map<std::tuple<Trig, long, long>, NodePtr> values;
+};
+
+bool is_pi(const NodePtr &n) {
+  return n->Type() == Node::Type_t::Variable &&
+         std::static_pointer_cast<Variable>(n)->Name() == "pi";
+}
+
+/** pi_multiple sets r if arg is r*pi with a fraction r. */
+bool pi_multiple(const NodePtr &arg, NumberRepr *r) {
+  switch (arg->Type()) {
+  case Node::Type_t::Number: {
+    // 0 is the only number which is a rational multiple of pi.
+    *r = std::static_pointer_cast<Number>(arg)->GetValue();
+    return r->IsValid() && r->IsFraction() && *r == NumberRepr(0l);
+  }
+  case Node::Type_t::Variable:
+    *r = NumberRepr(1l);
+    return is_pi(arg);
+  case Node::Type_t::Factor: {
+    const auto &ops = std::static_pointer_cast<Factor>(arg)->Data();
+    if (ops.size() != 2) {
+      return false;
+    }
+    for (int i = 0; i < 2; i++) {
+      const auto &a = ops[i];
+      const auto &b = ops[1 - i];
+      if (a->Type() == Node::Type_t::Number && is_pi(b)) {
+        *r = std::static_pointer_cast<Number>(a)->GetValue();
+        return r->IsValid() && r->IsFraction();
+      }
+    }
+    return false;
+  }
+  default:
+    return false;
+  }
+}
+
+} // namespace
+
+namespace Equation {
+
+NodePtr trig_value(Trig f, const NodePtr &arg) {
+  NumberRepr r;
+  if (!pi_multiple(arg, &r)) {
+    return 0;
+  }
+  auto denom = r.Denominator();
+  if (denom > max_denominator) {
+    return 0;
+  }
+  auto n = denom.convert_to<long>();
+  Integer_t k = r.Numerator() % (2 * n);
+  if (k < 0) {
+    k += 2 * n;
+  }
+  return TrigTable::Get().Find(f, k.convert_to<long>(), n);
+}
+
+} // namespace Equation
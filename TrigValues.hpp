@@ -0,0 +1,28 @@
+//
+//  Copyright © 2017 Lennart Oymanns. All rights reserved.
+//
+
+#ifndef TrigValues_hpp
+#define TrigValues_hpp
+
+#include "Node.hpp"
+
+namespace Equation {
+
+/** Trig selects a trigonometric function for trig_value. */
+enum class Trig { Sin, Cos, Tan };
+
+/** trig_value returns the exact value of the function f at arg if arg is
+ k*pi/n with an integer k and n in {1, 2, 3, 4, 5, 6, 8, 10, 12, 15, 16, 20,
+ 24}, e.g. sin(7/12*pi) = (6^(1/2)+2^(1/2))/4. Otherwise, and for tan at odd
+ multiples of pi/2, an empty pointer is returned.
+
+ The values are computed once from closed forms for the first quadrant (the
+ denominators up to 12), from these with the half-angle formulas (16, 20, 24)
+ and the angle-sum formulas (15). They are evaluated and looked up by
+ (k mod 2n, n). The returned node is shared and must not be modified. */
+NodePtr trig_value(Trig f, const NodePtr &arg);
+
+} // namespace Equation
+
+#endif /* TrigValues_hpp */
@@ -3,36 +3,98 @@
 //
 
 #include "TwoOp.hpp"
+#include "Canonical.hpp"
 #include "Number.hpp"
 
 using namespace Equation;
 
 void TwoOp::Eval(NodePtr *base, std::shared_ptr<State> state, bool numeric) {
+  invalidateHash();
   for (auto &e : op1) {
     e->Eval(&e, state, numeric);
   }
 
+  // if a child has the same type as this node, move its operands to this
+  // node, i.e. a tree (*, a, (*, b, c)) is converted to (*, a, b, c).
+  NodeList nested;
+  op1.remove_if([this, &nested](const NodePtr &e) {
+    if (e->Type() != Type()) {
+      return false;
+    }
+    auto op = std::static_pointer_cast<const TwoOp>(e);
+    nested.insert(nested.end(), op->Data().begin(), op->Data().end());
+    return true;
+  });
+  op1.insert(op1.end(), nested.begin(), nested.end());
+
   NumberRepr value = NeutralElement();
-  for (auto it = op1.begin(); it != op1.end();) {
-    if ((*it)->Type() == Node::Type_t::Number) {
-      auto ptr = std::static_pointer_cast<Number>(*it);
-      value = Operation1(value, ptr->GetValue());
-      it = op1.erase(it);
-    } else {
-      it++;
+  op1.remove_if([this, &value](const NodePtr &e) {
+    if (e->Type() != Node::Type_t::Number) {
+      return false;
     }
-  }
+    auto ptr = std::static_pointer_cast<Number>(e);
+    value = Operation1(value, ptr->GetValue());
+    return true;
+  });
 
   if (base && op1.size() == 0) {
-    base->reset(new Number(value));
+    *base = new_node<Number>(value);
     return;
   }
   if (value != NeutralElement()) {
-    auto newnumber = std::make_shared<Number>(value);
+    auto newnumber = new_node<Number>(value);
     op1.push_back(newnumber);
   }
 }
 
+const TwoOp::Order &TwoOp::CanonicalOrder() const {
+  if (!order_valid) {
+    order.clear();
+    for (std::uint32_t i = 0; i < op1.size(); i++) {
+      order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(),
+              [this](std::uint32_t a, std::uint32_t b) {
+                return canonical_compare(op1[a], op1[b]) < 0;
+              });
+    order_valid = true;
+  }
+  return order;
+}
+
+/** equalTo returns true if both nodes have the same operands in any order.
+
+ Both nodes keep their operands in canonical order (see CanonicalOrder), so
+ they are compared in a single pass. */
+bool TwoOp::equalTo(const NodePtr &n) const {
+  if (Type() != n->Type()) {
+    return false;
+  }
+  auto un = std::static_pointer_cast<TwoOp>(n);
+  if (op1.size() != un->op1.size()) {
+    return false;
+  }
+  const auto &a = CanonicalOrder();
+  const auto &b = un->CanonicalOrder();
+  for (size_t i = 0; i < a.size(); i++) {
+    if (!op1[a[i]]->equals(un->op1[b[i]])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/** hash does not depend on the order of the operands. */
+std::size_t TwoOp::hash() const {
+  std::size_t sum = 0;
+  for (const auto &e : op1) {
+    sum += hash_mix(e->Hash());
+  }
+  std::size_t h = static_cast<std::size_t>(Type());
+  hash_combine(h, sum);
+  return h;
+}
+
 void TwoOp::writeTreeToStream(std::ostream &s, const std::string &name) {
   std::string type = "op";
   std::stringstream ss;
@@ -6,7 +6,7 @@
 #define TwoOp_hpp
 
 #include <algorithm>
-#include <list>
+#include <cstdint>
 
 #include "Node.hpp"
 #include "NumberRepr.hpp"
@@ -34,7 +34,10 @@ public:
   virtual void Eval(NodePtr *base, std::shared_ptr<State> state,
                     bool numeric = false);
 
-  void AddOp1(NodePtr node) { op1.push_back(node); }
+  void AddOp1(NodePtr node) {
+    invalidateHash();
+    op1.push_back(node);
+  }
 
   virtual NumberRepr Operation1(NumberRepr base, NumberRepr n) = 0;
   virtual NumberRepr NeutralElement() = 0;
@@ -51,33 +54,31 @@ public:
     return number;
   }
 
-  virtual bool equals(NodePtr n) const {
-    if (Type() != n->Type()) {
-      return false;
-    }
-    auto un = std::static_pointer_cast<TwoOp>(n);
-    if (op1.size() != un->op1.size()) {
-      return false;
-    }
-    bool num =
-        std::is_permutation(op1.begin(), op1.end(), un->op1.begin(),
-                            [](const NodePtr &item1, const NodePtr &item2) {
-                              return (item1->equals(item2));
-                            });
-    // bool num = op1 == un->op1;
-    if (!num) {
-      return false;
-    }
-    return true;
-  }
+  const NodeList &Data() const { return op1; }
 
-  const std::list<NodePtr> &Data() const { return op1; }
+  /** Order is a permutation of the operands. */
+  typedef SmallVector<std::uint32_t, 6> Order;
 
-  std::list<NodePtr> &Data() { return op1; }
+  /** CanonicalOrder returns the indices of the operands sorted by
+   canonical_compare. It is computed once and cached until the node is
+   modified, so two sums or products are compared in a single pass. */
+  const Order &CanonicalOrder() const;
+
+  NodeList &Data() {
+    invalidateHash();
+    return op1;
+  }
 
 protected:
-  std::list<NodePtr> op1;
+  virtual bool equalTo(const NodePtr &n) const;
+
+  virtual std::size_t hash() const;
+
+  NodeList op1;
   std::string o1;
+
+private:
+  mutable Order order;
 };
 } // namespace Equation
 
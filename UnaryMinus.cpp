@@ -19,6 +19,7 @@ void UnaryMinus::writeTreeToStream(std::ostream &s, const std::string &name) {
 
 void UnaryMinus::Eval(NodePtr *base, std::shared_ptr<State> state,
                       bool numeric) {
+  invalidateHash();
   data->Eval(&data, state, numeric);
   if (data->Type() == Node::Type_t::Number) {
     auto ptr = std::static_pointer_cast<Number>(data);
@@ -26,11 +27,11 @@ void UnaryMinus::Eval(NodePtr *base, std::shared_ptr<State> state,
 
     value *= NumberRepr(-1l);
 
-    base->reset(new Number(value));
+    *base = new_node<Number>(value);
     return;
   }
-  auto factor = std::make_shared<Factor>();
-  factor->AddOp1(std::make_shared<Number>(NumberRepr(-1l)));
+  auto factor = new_node<Factor>();
+  factor->AddOp1(new_node<Number>(NumberRepr(-1l)));
   factor->AddOp1(data);
 
   auto node = std::static_pointer_cast<Node>(factor);
@@ -35,7 +35,17 @@ public:
 
   virtual bool IsNumber() const { return data->IsNumber(); }
 
-  virtual bool equals(NodePtr n) const {
+  virtual NodePtr clone() const {
+    return new_node<UnaryMinus>(data->clone());
+  }
+  virtual const NodePtr &Data() const { return data; }
+  virtual NodePtr &Data() {
+    invalidateHash();
+    return data;
+  }
+
+protected:
+  virtual bool equalTo(const NodePtr &n) const {
     if (n->Type() != Node::Type_t::UnaryMinus) {
       return false;
     }
@@ -43,11 +53,11 @@ public:
     return data->equals(un->data);
   }
 
-  virtual NodePtr clone() const {
-    return std::make_shared<UnaryMinus>(data->clone());
+  virtual std::size_t hash() const {
+    std::size_t h = static_cast<std::size_t>(Type());
+    hash_combine(h, data->Hash());
+    return h;
   }
-  virtual const NodePtr &Data() const { return data; }
-  virtual NodePtr &Data() { return data; }
 
 private:
   NodePtr data;
@@ -20,14 +20,20 @@
 
 using namespace Equation;
 
-NodePtr UserFunction::Eval(const std::list<NodePtr> &args, bool numeric) {
+NodePtr UserFunction::Eval(const NodeList &args, bool numeric) {
 
   NodePtr result;
   bool rep = SpecialValues(args, &result);
   if (rep) {
     return result;
   }
+  return evalNumbers(args, numeric);
+}
 
+/** evalNumbers evaluates the function numerically if all arguments are
+ numbers and numeric is true or one of the numbers is a floating point
+ number. Otherwise, it returns an empty pointer. */
+NodePtr UserFunction::evalNumbers(const NodeList &args, bool numeric) {
   std::vector<std::complex<NumberRepr>> dargs;
   dargs.reserve(args.size());
 
@@ -5,26 +5,33 @@
 #ifndef UserFunction_hpp
 #define UserFunction_hpp
 
-#include <list>
+#include <complex>
+#include <vector>
 
 #include "NumberRepr.hpp"
+#include "State.hpp"
 
 namespace Equation {
 
-class Node;
-typedef std::shared_ptr<Node> NodePtr;
-
 class UserFunction {
 public:
-  virtual NodePtr Eval(const std::list<NodePtr> &args, bool numeric = false);
+  virtual NodePtr Eval(const NodeList &args, bool numeric = false);
 
   virtual NodePtr
   EvalNum(const std::vector<std::complex<NumberRepr>> &args) = 0;
-  virtual bool SpecialValues(const std::list<NodePtr> &args,
+  /** SpecialValues sets result to the exact value of the function at args if
+   it is known. Implementations may return a shared node (see MathFunction),
+   which has to be cloned by callers which modify it. */
+  virtual bool SpecialValues(const NodeList &args,
                              NodePtr *result) = 0;
+  /** NumArgs returns the number of arguments of the function. 0 means that
+   the function accepts any number of arguments. */
   virtual size_t NumArgs() const = 0;
 
   static NodePtr make_node(const std::string &expr);
+
+protected:
+  NodePtr evalNumbers(const NodeList &args, bool numeric);
 };
 
 } // namespace Equation
@@ -40,7 +40,12 @@ public:
 
   virtual bool IsNumber() const { return false; }
 
-  virtual bool equals(NodePtr n) const {
+  virtual NodePtr clone() const { return new_node<Variable>(vname); }
+
+  std::string Name() const { return vname; }
+
+protected:
+  virtual bool equalTo(const NodePtr &n) const {
     if (n->Type() != Node::Type_t::Variable) {
       return false;
     }
@@ -48,9 +53,11 @@ public:
     return un && vname == un->vname;
   }
 
-  virtual NodePtr clone() const { return std::make_shared<Variable>(vname); }
-
-  std::string Name() const { return vname; }
+  virtual std::size_t hash() const {
+    std::size_t h = static_cast<std::size_t>(Type());
+    hash_combine(h, std::hash<std::string>()(vname));
+    return h;
+  }
 
 private:
   std::string vname;
@@ -0,0 +1,356 @@
+//
+//  Copyright © 2017 Lennart Oymanns. All rights reserved.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "VectorMath.hpp"
+
+// VECTOR_CLONES compiles a function for several instruction sets and selects
+// the best one when the program is loaded.
+#if defined(__x86_64__) && defined(__linux__) && defined(__has_attribute)
+#if __has_attribute(target_clones)
+#define VECTOR_CLONES                                                          \
+  __attribute__((target_clones("avx512f", "avx2", "default")))
+#endif
+#endif
+#ifndef VECTOR_CLONES
+#define VECTOR_CLONES
+#endif
+
+namespace Equation {
+
+namespace {
+
+// adding and subtracting Shifter rounds a double with |x| < 2^51 to the
+// nearest integer. Afterwards the low bits of the sum contain the integer.
+const double Shifter = 6755399441055744.0; // 1.5 * 2^52
+
+const double Log2E = 1.44269504088896338700e+00;
+const double Ln2Hi = 6.93147180369123816490e-01; // low bits are zero
+const double Ln2Lo = 1.90821492927058770002e-10;
+
+const double TwoOverPi = 6.36619772367581382433e-01;
+// pi/2 split into three parts with 33 significant bits each (from fdlibm).
+const double PiO2_1 = 1.57079632673412561417e+00;
+const double PiO2_2 = 6.07710050630396597660e-11;
+const double PiO2_3 = 2.02226624871116645580e-21;
+// sin and cos are reduced by Cody-Waite reduction only up to this argument.
+const double MaxTrigArg = 1e5;
+
+inline std::uint64_t bits_of(double d) {
+  std::uint64_t u;
+  std::memcpy(&u, &d, sizeof(d));
+  return u;
+}
+
+inline double from_bits(std::uint64_t u) {
+  double d;
+  std::memcpy(&d, &u, sizeof(d));
+  return d;
+}
+
+/** exp_kernel returns exp(x) for -708 <= x <= 709. */
+inline double exp_kernel(double x) {
+  // x = k*ln2 + r with |r| <= ln2/2
+  double t = x * Log2E + Shifter;
+  double k = t - Shifter;
+  double r = (x - k * Ln2Hi) - k * Ln2Lo;
+  // Taylor series up to r^13, the remainder is below 1e-17.
+  double p = 1.0 / 6227020800.0;
+  p = p * r + 1.0 / 479001600.0;
+  p = p * r + 1.0 / 39916800.0;
+  p = p * r + 1.0 / 3628800.0;
+  p = p * r + 1.0 / 362880.0;
+  p = p * r + 1.0 / 40320.0;
+  p = p * r + 1.0 / 5040.0;
+  p = p * r + 1.0 / 720.0;
+  p = p * r + 1.0 / 120.0;
+  p = p * r + 1.0 / 24.0;
+  p = p * r + 1.0 / 6.0;
+  p = p * r + 0.5;
+  p = p * r + 1.0;
+  p = p * r + 1.0;
+  // 2^k is built from the low bits of t, which contain k.
+  double scale = from_bits((bits_of(t) + 1023) << 52);
+  return p * scale;
+}
+
+/** log_kernel returns log(x) for normal positive x. */
+inline double log_kernel(double x) {
+  std::uint64_t u = bits_of(x);
+  // x = m * 2^e with 1 <= m < 2. The exponent is converted to double with
+  // the Shifter trick because there is no vector conversion from integers.
+  double e = from_bits(0x4330000000000000ull | (u >> 52)) - 4503599627370496.0 -
+             1023.0;
+  double m = from_bits((u & 0x000fffffffffffffull) | 0x3ff0000000000000ull);
+  bool big = m > 1.41421356237309504880;
+  m = big ? 0.5 * m : m;
+  e = big ? e + 1.0 : e;
+  // log(m) = 2 atanh(f) with f = (m-1)/(m+1) and |f| < 0.172
+  double f = (m - 1.0) / (m + 1.0);
+  double s = f * f;
+  double p = 1.0 / 21.0;
+  p = p * s + 1.0 / 19.0;
+  p = p * s + 1.0 / 17.0;
+  p = p * s + 1.0 / 15.0;
+  p = p * s + 1.0 / 13.0;
+  p = p * s + 1.0 / 11.0;
+  p = p * s + 1.0 / 9.0;
+  p = p * s + 1.0 / 7.0;
+  p = p * s + 1.0 / 5.0;
+  p = p * s + 1.0 / 3.0;
+  double lm = 2.0 * f + 2.0 * f * s * p;
+  return e * Ln2Hi + (lm + e * Ln2Lo);
+}
+
+/** sin_poly returns sin(r) for |r| <= pi/4. */
+inline double sin_poly(double r) {
+  double z = r * r;
+  double p = -1.0 / 121645100408832000.0;
+  p = p * z + 1.0 / 355687428096000.0;
+  p = p * z - 1.0 / 1307674368000.0;
+  p = p * z + 1.0 / 6227020800.0;
+  p = p * z - 1.0 / 39916800.0;
+  p = p * z + 1.0 / 362880.0;
+  p = p * z - 1.0 / 5040.0;
+  p = p * z + 1.0 / 120.0;
+  p = p * z - 1.0 / 6.0;
+  return r + r * z * p;
+}
+
+/** cos_poly returns cos(r) for |r| <= pi/4. */
+inline double cos_poly(double r) {
+  double z = r * r;
+  double p = 1.0 / 6402373705728000.0;
+  p = p * z - 1.0 / 20922789888000.0;
+  p = p * z + 1.0 / 87178291200.0;
+  p = p * z - 1.0 / 479001600.0;
+  p = p * z + 1.0 / 3628800.0;
+  p = p * z - 1.0 / 40320.0;
+  p = p * z + 1.0 / 720.0;
+  p = p * z - 1.0 / 24.0;
+  p = p * z + 0.5;
+  return 1.0 - z * p;
+}
+
+/** trig_reduce computes x = k*pi/2 + r and returns k mod 4. */
+inline std::uint64_t trig_reduce(double x, double &r) {
+  double t = x * TwoOverPi + Shifter;
+  double k = t - Shifter;
+  r = ((x - k * PiO2_1) - k * PiO2_2) - k * PiO2_3;
+  return bits_of(t) & 3;
+}
+
+/** fix_up recomputes r[i] = f(a[i]) for all elements outside of the domain
+ [lo, hi] of a vector kernel (including NaN). */
+void fix_up(double (*f)(double), double lo, double hi, const double *a,
+            double *r, std::size_t n) {
+  for (std::size_t i = 0; i < n; i++) {
+    if (!(a[i] >= lo && a[i] <= hi)) {
+      r[i] = f(a[i]);
+    }
+  }
+}
+
+double scalar_exp(double x) { return std::exp(x); }
+double scalar_log(double x) { return std::log(x); }
+double scalar_sin(double x) { return std::sin(x); }
+double scalar_cos(double x) { return std::cos(x); }
+double scalar_tan(double x) { return std::tan(x); }
+
+} // namespace
+
+VECTOR_CLONES
+void vec_add(const double *a, const double *b, double *r, std::size_t n) {
+  for (std::size_t i = 0; i < n; i++) {
+    r[i] = a[i] + b[i];
+  }
+}
+
+VECTOR_CLONES
+void vec_sub(const double *a, const double *b, double *r, std::size_t n) {
+  for (std::size_t i = 0; i < n; i++) {
+    r[i] = a[i] - b[i];
+  }
+}
+
+VECTOR_CLONES
+void vec_mul(const double *a, const double *b, double *r, std::size_t n) {
+  for (std::size_t i = 0; i < n; i++) {
+    r[i] = a[i] * b[i];
+  }
+}
+
+VECTOR_CLONES
+void vec_div(const double *a, const double *b, double *r, std::size_t n) {
+  for (std::size_t i = 0; i < n; i++) {
+    r[i] = a[i] / b[i];
+  }
+}
+
+VECTOR_CLONES
+void vec_neg(const double *a, double *r, std::size_t n) {
+  for (std::size_t i = 0; i < n; i++) {
+    r[i] = -a[i];
+  }
+}
+
+VECTOR_CLONES
+void vec_powi(const double *a, std::int32_t e, double *r, std::size_t n) {
+  bool invert = e < 0;
+  std::uint32_t k = invert ? std::uint32_t(-std::int64_t(e)) : e;
+  // the exponent is the same for all elements, so the square-and-multiply
+  // loop is run on blocks of the array.
+  double base[256];
+  std::size_t done = 0;
+  while (done < n) {
+    std::size_t m = n - done < 256 ? n - done : 256;
+    const double *x = a + done;
+    double *y = r + done;
+    for (std::size_t i = 0; i < m; i++) {
+      base[i] = x[i];
+      y[i] = 1.0;
+    }
+    for (std::uint32_t j = k; j > 0; j >>= 1) {
+      if (j & 1) {
+        for (std::size_t i = 0; i < m; i++) {
+          y[i] *= base[i];
+        }
+      }
+      if (j > 1) {
+        for (std::size_t i = 0; i < m; i++) {
+          base[i] *= base[i];
+        }
+      }
+    }
+    if (invert) {
+      for (std::size_t i = 0; i < m; i++) {
+        y[i] = 1.0 / y[i];
+      }
+    }
+    done += m;
+  }
+}
+
+void vec_pow(const double *a, const double *b, double *r, std::size_t n) {
+  for (std::size_t i = 0; i < n; i++) {
+    r[i] = std::pow(a[i], b[i]);
+  }
+}
+
+VECTOR_CLONES
+void vec_sqrt(const double *a, double *r, std::size_t n) {
+  for (std::size_t i = 0; i < n; i++) {
+    r[i] = std::sqrt(a[i]);
+  }
+}
+
+// The kernels below work on chunks of the input which are copied first, so
+// that the elements outside of the domain can be fixed up even if r == a.
+const std::size_t Chunk = 256;
+
+VECTOR_CLONES
+void vec_exp(const double *a, double *r, std::size_t n) {
+  const double lo = -708.0;
+  const double hi = 709.0;
+  double x[Chunk];
+  for (std::size_t start = 0; start < n; start += Chunk) {
+    std::size_t m = std::min(Chunk, n - start);
+    std::copy(a + start, a + start + m, x);
+    double *y = r + start;
+    for (std::size_t i = 0; i < m; i++) {
+      double v = x[i] < lo ? lo : x[i];
+      v = v > hi ? hi : v;
+      y[i] = exp_kernel(v);
+    }
+    fix_up(scalar_exp, lo, hi, x, y, m);
+  }
+}
+
+VECTOR_CLONES
+void vec_log(const double *a, double *r, std::size_t n) {
+  const double lo = 2.2250738585072014e-308; // smallest normal number
+  const double hi = 1.7976931348623157e+308;
+  double x[Chunk];
+  for (std::size_t start = 0; start < n; start += Chunk) {
+    std::size_t m = std::min(Chunk, n - start);
+    std::copy(a + start, a + start + m, x);
+    double *y = r + start;
+    for (std::size_t i = 0; i < m; i++) {
+      double v = x[i] < lo ? 1.0 : x[i];
+      v = v > hi ? 1.0 : v;
+      y[i] = log_kernel(v);
+    }
+    fix_up(scalar_log, lo, hi, x, y, m);
+  }
+}
+
+VECTOR_CLONES
+void vec_sin(const double *a, double *r, std::size_t n) {
+  double x[Chunk];
+  for (std::size_t start = 0; start < n; start += Chunk) {
+    std::size_t m = std::min(Chunk, n - start);
+    std::copy(a + start, a + start + m, x);
+    double *y = r + start;
+    for (std::size_t i = 0; i < m; i++) {
+      double v = x[i] < -MaxTrigArg ? 0.0 : x[i];
+      v = v > MaxTrigArg ? 0.0 : v;
+      double red;
+      std::uint64_t q = trig_reduce(v, red);
+      double res = (q & 1) ? cos_poly(red) : sin_poly(red);
+      y[i] = (q & 2) ? -res : res;
+    }
+    fix_up(scalar_sin, -MaxTrigArg, MaxTrigArg, x, y, m);
+  }
+}
+
+VECTOR_CLONES
+void vec_cos(const double *a, double *r, std::size_t n) {
+  double x[Chunk];
+  for (std::size_t start = 0; start < n; start += Chunk) {
+    std::size_t m = std::min(Chunk, n - start);
+    std::copy(a + start, a + start + m, x);
+    double *y = r + start;
+    for (std::size_t i = 0; i < m; i++) {
+      double v = x[i] < -MaxTrigArg ? 0.0 : x[i];
+      v = v > MaxTrigArg ? 0.0 : v;
+      double red;
+      std::uint64_t q = trig_reduce(v, red);
+      double res = (q & 1) ? sin_poly(red) : cos_poly(red);
+      y[i] = ((q + 1) & 2) ? -res : res;
+    }
+    fix_up(scalar_cos, -MaxTrigArg, MaxTrigArg, x, y, m);
+  }
+}
+
+VECTOR_CLONES
+void vec_tan(const double *a, double *r, std::size_t n) {
+  double x[Chunk];
+  for (std::size_t start = 0; start < n; start += Chunk) {
+    std::size_t m = std::min(Chunk, n - start);
+    std::copy(a + start, a + start + m, x);
+    double *y = r + start;
+    for (std::size_t i = 0; i < m; i++) {
+      double v = x[i] < -MaxTrigArg ? 0.0 : x[i];
+      v = v > MaxTrigArg ? 0.0 : v;
+      double red;
+      std::uint64_t q = trig_reduce(v, red);
+      double sn = sin_poly(red);
+      double cs = cos_poly(red);
+      y[i] = (q & 1) ? -cs / sn : sn / cs;
+    }
+    fix_up(scalar_tan, -MaxTrigArg, MaxTrigArg, x, y, m);
+  }
+}
+
+void vec_apply(double (*f)(double), const double *a, double *r,
+               std::size_t n) {
+  for (std::size_t i = 0; i < n; i++) {
+    r[i] = f(a[i]);
+  }
+}
+
+} // namespace Equation
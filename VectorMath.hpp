@@ -0,0 +1,46 @@
+//
+//  Copyright © 2017 Lennart Oymanns. All rights reserved.
+//
+
+#ifndef VectorMath_hpp
+#define VectorMath_hpp
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Equation {
+
+/* The functions in this file apply an operation elementwise to arrays of n
+ doubles, r[i] = op(a[i], b[i]). The result array may be equal to one of the
+ inputs.
+
+ The loops are written so that the compiler can vectorize them. On x86-64 they
+ are compiled for AVX-512, AVX2 and the baseline instruction set, and the
+ best version for the CPU is chosen at run time. exp, log, sin, cos and tan
+ use their own polynomial approximations (accurate to a few ulp); all other
+ functions call the standard library for each element. */
+
+void vec_add(const double *a, const double *b, double *r, std::size_t n);
+void vec_sub(const double *a, const double *b, double *r, std::size_t n);
+void vec_mul(const double *a, const double *b, double *r, std::size_t n);
+void vec_div(const double *a, const double *b, double *r, std::size_t n);
+void vec_neg(const double *a, double *r, std::size_t n);
+
+/** vec_powi computes a[i]^e for an integer exponent e. */
+void vec_powi(const double *a, std::int32_t e, double *r, std::size_t n);
+void vec_pow(const double *a, const double *b, double *r, std::size_t n);
+void vec_sqrt(const double *a, double *r, std::size_t n);
+
+void vec_exp(const double *a, double *r, std::size_t n);
+void vec_log(const double *a, double *r, std::size_t n);
+void vec_sin(const double *a, double *r, std::size_t n);
+void vec_cos(const double *a, double *r, std::size_t n);
+void vec_tan(const double *a, double *r, std::size_t n);
+
+/** vec_apply computes f(a[i]) with a scalar function f. */
+void vec_apply(double (*f)(double), const double *a, double *r,
+               std::size_t n);
+
+} // namespace Equation
+
+#endif /* VectorMath_hpp */
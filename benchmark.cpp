@@ -0,0 +1,261 @@
+//
+//  Copyright © 2017 Lennart Oymanns. All rights reserved.
+//
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Equation.hpp"
+#include "JitProgram.hpp"
+#include "Number.hpp"
+#include "NumberRepr.hpp"
+
+using namespace Equation;
+
+namespace {
+
+/** harmonic returns the expression 1/1 + 1/2 + ... + 1/n. */
+std::string harmonic(int n) {
+  std::stringstream ss;
+  for (int i = 1; i <= n; i++) {
+    if (i > 1) {
+      ss << "+";
+    }
+    ss << "1/" << i;
+  }
+  return ss.str();
+}
+
+/** coefficients returns a sum of n terms in x and y with large rational
+ coefficients. */
+std::string coefficients(int n) {
+  std::stringstream ss;
+  for (int i = 1; i <= n; i++) {
+    if (i > 1) {
+      ss << "+";
+    }
+    ss << "(" << (i + 2) << "/" << (2 * i + 1) << ")^" << (20 + i % 30) << "*"
+       << (i % 2 == 0 ? "x" : "y");
+  }
+  return ss.str();
+}
+
+/** chain returns a sum over n variables x0, x1, ... which couples
+ neighbouring variables. */
+std::string chain(int n) {
+  std::stringstream ss;
+  for (int i = 0; i < n; i++) {
+    if (i > 0) {
+      ss << "+";
+    }
+    ss << "sin(x" << i << "*x" << (i + 1) % n << ")*exp(-x" << i << "^2)";
+  }
+  return ss.str();
+}
+
+/** powers returns a product of n powers of fractions. */
+std::string powers(int n) {
+  std::stringstream ss;
+  for (int i = 1; i <= n; i++) {
+    if (i > 1) {
+      ss << "*";
+    }
+    ss << "(" << (1000003 * i) << "/" << (999983 + 2 * i) << ")^" << (50 + i);
+  }
+  return ss.str();
+}
+
+void run(const std::string &name, int repetitions,
+         const std::function<void()> &f) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < repetitions; i++) {
+    f();
+  }
+  auto end = std::chrono::steady_clock::now();
+  double ms = std::chrono::duration<double, std::milli>(end - start).count();
+  std::cout << name << ": " << ms / repetitions << " ms\n";
+}
+
+void evaluate(const std::string &expr) {
+  Equation::Equation eq;
+  eq.Set(expr);
+  eq.Evaluate();
+}
+
+} // namespace
+
+/** benchmark measures exact arithmetic with large fractions. Build it with
+ different BIGNUM_BACKEND settings to compare the backends. */
+int main(int argc, char *argv[]) {
+  int repetitions = 10;
+  if (argc == 2) {
+    repetitions = atoi(argv[1]);
+  }
+  if (argc > 2 || repetitions <= 0) {
+    std::cerr << "usage: benchmark [repetitions]\n";
+    return 1;
+  }
+
+  std::cout << "backend: " << NumberRepr::Backend() << "\n";
+
+  run("NumberRepr harmonic sum (n=2000)", repetitions, [] {
+    NumberRepr sum(0l);
+    for (long i = 1; i <= 2000; i++) {
+      sum += NumberRepr(1l, i);
+    }
+  });
+
+  run("NumberRepr power (30/7)^100", repetitions, [] {
+    NumberRepr::Pow(NumberRepr(30l, 7l), NumberRepr(100l));
+  });
+
+  std::string h = harmonic(300);
+  run("Equation harmonic sum (n=300)", repetitions, [&h] { evaluate(h); });
+
+  std::string c = coefficients(300);
+  run("Equation large coefficients (n=300)", repetitions,
+      [&c] { evaluate(c); });
+
+  std::string p = powers(20);
+  run("Equation powers of fractions (n=20)", repetitions,
+      [&p] { evaluate(p); });
+
+  run("Equation one-shot evaluation (1000 expressions)", repetitions, [] {
+    for (int i = 0; i < 1000; i++) {
+      evaluate("2*sin(x)+pi");
+    }
+  });
+
+  const std::string derivative =
+      "D(sin(x^2+3*x)*exp(-x)*cos(x)^3+log(1+x^2)/x+atan(x*y)*(x+y)^5, x)";
+  run("Equation derivative", repetitions,
+      [&derivative] { evaluate(derivative); });
+
+  std::string nested = "sin(x^2+3*x)*exp(-x)";
+  const std::string series = "D(" + nested + ", x, 10)";
+  for (int i = 0; i < 10; i++) {
+    nested = "D(" + nested + ", x)";
+  }
+  run("Equation 10th derivative (nested D)", 1,
+      [&nested] { evaluate(nested); });
+  run("Equation 10th derivative (Taylor series)", repetitions,
+      [&series] { evaluate(series); });
+  run("Equation Taylor polynomial of order 20", repetitions, [] {
+    evaluate("taylor(sin(x^2+3*x)*exp(-x)*cos(x)^3+log(1+x^2)/(1+x), x, 0, "
+             "20)");
+  });
+
+  run("Equation expand (a+b+c+d+e)^12", repetitions,
+      [] { evaluate("expand((a+b+c+d+e)^12)"); });
+  run("Equation expand (1+x+y)^60", repetitions,
+      [] { evaluate("expand((1+x+y)^60)"); });
+  run("Equation normal of a rational function", repetitions, [] {
+    evaluate("normal(((x+y+z)^7-(x-y)^7)/((x+y+z)^2-(x-y)^2))");
+  });
+
+  const std::string formula = "3*x^2-2*x*y+sin(y)/(1+x)^3-sqrt(x)+exp(-x*y)";
+  run("Equation numeric evaluation (1000 points)", repetitions, [&formula] {
+    for (int i = 0; i < 1000; i++) {
+      auto state = std::make_shared<DefaultState>();
+      state->SetVariable("x", std::make_shared<Number>(0.001 * i));
+      state->SetVariable("y", std::make_shared<Number>(1.0 - 0.001 * i));
+      Equation::Equation eq;
+      eq.Set(formula);
+      eq.Evaluate(true, state);
+    }
+  });
+
+  Equation::Equation compiled;
+  compiled.Set(formula);
+  compiled.Evaluate();
+  auto program = compiled.Compile({"x", "y"});
+  run("Program numeric evaluation (1000 points)", repetitions, [&program] {
+    double sum = 0;
+    for (int i = 0; i < 1000; i++) {
+      double values[] = {0.001 * i, 1.0 - 0.001 * i};
+      sum += program.Evaluate(values);
+    }
+    if (std::isnan(sum)) {
+      std::cerr << "unexpected NaN\n";
+    }
+  });
+
+  const std::size_t points = 1000000;
+  std::vector<double> xs(points), ys(points), out(points);
+  for (std::size_t i = 0; i < points; i++) {
+    xs[i] = 1e-6 * i;
+    ys[i] = 1.0 - 1e-6 * i;
+  }
+  run("Program scalar evaluation (10^6 points)", repetitions, [&] {
+    for (std::size_t i = 0; i < points; i++) {
+      double values[] = {xs[i], ys[i]};
+      out[i] = program.Evaluate(values);
+    }
+  });
+  run("Program batch evaluation (10^6 points)", repetitions, [&] {
+    const double *columns[] = {xs.data(), ys.data()};
+    program.EvaluateBatch(columns, points, out.data());
+  });
+  if (JitProgram::Supported()) {
+    JitProgram jit(program);
+    run("JitProgram evaluation (10^6 points)", repetitions, [&] {
+      for (std::size_t i = 0; i < points; i++) {
+        double values[] = {xs[i], ys[i]};
+        out[i] = jit.Evaluate(values);
+      }
+    });
+  }
+
+  const int nvars = 20;
+  Equation::Equation ch;
+  ch.Set("(" + chain(nvars) + ")^2");
+  ch.Evaluate();
+  std::vector<std::string> names;
+  for (int i = 0; i < nvars; i++) {
+    names.push_back("x" + std::to_string(i));
+  }
+  auto chprog = ch.Compile(names);
+  std::vector<double> point(nvars, 0.5), grad(nvars);
+  run("Program gradient (20 variables, 1000 points)", repetitions, [&] {
+    for (int i = 0; i < 1000; i++) {
+      point[i % nvars] = 0.001 * i;
+      chprog.Gradient(point.data(), grad.data());
+    }
+  });
+  std::vector<Program> partials;
+  run("Symbolic gradient (20 variables, D and Compile)", repetitions, [&] {
+    partials.clear();
+    for (const auto &v : names) {
+      Equation::Equation d;
+      d.Set("D(" + ch.ToString() + "," + v + ")");
+      d.Evaluate();
+      partials.push_back(d.Compile(names));
+    }
+  });
+  run("Symbolic gradient (20 variables, 1000 points)", repetitions, [&] {
+    for (int i = 0; i < 1000; i++) {
+      point[i % nvars] = 0.001 * i;
+      for (int j = 0; j < nvars; j++) {
+        grad[j] = partials[j].Evaluate(point.data());
+      }
+    }
+  });
+
+  run("Equation large coefficients (n=300, 4 threads)", repetitions, [&c] {
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; i++) {
+      threads.emplace_back([&c] { evaluate(c); });
+    }
+    for (auto &t : threads) {
+      t.join();
+    }
+  });
+  return 0;
+}
@@ -0,0 +1,123 @@
+//
+//  Copyright © 2017 Lennart Oymanns. All rights reserved.
+//
+
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "CppEmitter.hpp"
+#include "Equation.hpp"
+#include "Error.h"
+
+/** Formula is a function definition like "f(x,y)=x^2+y". */
+struct Formula {
+  std::string name;
+  std::vector<std::string> variables;
+  std::string expression;
+};
+
+bool parse_formula(const std::string &s, Formula *f) {
+  auto eq = s.find('=');
+  if (eq == std::string::npos) {
+    return false;
+  }
+  auto head = s.substr(0, eq);
+  f->expression = s.substr(eq + 1);
+  auto open = head.find('(');
+  if (open == std::string::npos) {
+    f->name = head;
+    return !f->name.empty();
+  }
+  if (head.back() != ')') {
+    return false;
+  }
+  f->name = head.substr(0, open);
+  std::stringstream vars(head.substr(open + 1, head.size() - open - 2));
+  std::string v;
+  while (std::getline(vars, v, ',')) {
+    if (!v.empty()) {
+      f->variables.push_back(v);
+    }
+  }
+  return !f->name.empty();
+}
+
+/** include_guard returns an include guard for the file path. */
+std::string include_guard(const std::string &path) {
+  auto slash = path.find_last_of("/\\");
+  auto base = slash == std::string::npos ? path : path.substr(slash + 1);
+  std::string guard;
+  for (auto c : base) {
+    guard += std::isalnum(static_cast<unsigned char>(c))
+                 ? char(std::toupper(static_cast<unsigned char>(c)))
+                 : '_';
+  }
+  return guard + "_";
+}
+
+/** calcgen writes C++ functions for formulas to a header file, e.g.
+
+   calcgen formulas.hpp "f(x,y)=x^2+sin(y)" "g=pi*r^2"
+
+ If no variables are given, the parameters are the variables of the formula
+ in the order of their first occurrence. With --no-temporaries, every
+ function is a single expression. */
+int main(int argc, char *argv[]) {
+  bool temporaries = true;
+  std::vector<std::string> args;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if (a == "--no-temporaries") {
+      temporaries = false;
+    } else {
+      args.push_back(a);
+    }
+  }
+  if (args.size() < 2) {
+    std::cerr << "usage: calcgen [--no-temporaries] OUTPUT "
+                 "NAME(VARIABLES)=EXPRESSION...\n";
+    return 1;
+  }
+
+  std::stringstream out;
+  auto guard = include_guard(args[0]);
+  out << "// generated by calcgen, do not edit.\n\n"
+      << "#ifndef " << guard << "\n"
+      << "#define " << guard << "\n\n";
+  Equation::CppEmitter::EmitPrelude(out);
+  Equation::CppEmitter emitter(temporaries);
+
+  for (std::size_t i = 1; i < args.size(); i++) {
+    Formula f;
+    if (!parse_formula(args[i], &f)) {
+      std::cerr << "error: invalid formula '" << args[i] << "'\n";
+      return 1;
+    }
+    Equation::Equation eq;
+    if (!eq.Set(f.expression)) {
+      return 1;
+    }
+    try {
+      eq.Evaluate();
+      out << "// " << f.name << " = " << eq.ToString() << "\n";
+      emitter.Emit(out, f.name, eq.Compile(f.variables));
+      out << "\n";
+    } catch (Equation::InputError &e) {
+      std::cerr << "error: " << f.name << ": " << e.what() << "\n";
+      return 1;
+    }
+  }
+  out << "#endif // " << guard << "\n";
+
+  std::ofstream file(args[0]);
+  file << out.str();
+  if (!file) {
+    std::cerr << "error: cannot write '" << args[0] << "'\n";
+    return 1;
+  }
+  return 0;
+}
@@ -1,4 +1,11 @@
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
 #include "Equation.hpp"
+#include "Error.h"
+#include "Number.hpp"
 
 std::string eval(const std::string &expression) {
   Equation::Equation eq;
@@ -6,10 +13,109 @@ std::string eval(const std::string &expression) {
   return eq.Evaluate(true);
 }
 
+/** Assignment is a command line argument "name=value[:seed]". */
+struct Assignment {
+  std::string name;
+  double value = 0.0;
+  double seed = 0.0;
+};
+
+bool parse_number(const std::string &s, double *d) {
+  char *end = nullptr;
+  *d = std::strtod(s.c_str(), &end);
+  return !s.empty() && *end == '\0';
+}
+
+bool parse_assignment(const std::string &s, Assignment *a, bool *seeded) {
+  auto eq = s.find('=');
+  if (eq == std::string::npos || eq == 0) {
+    return false;
+  }
+  a->name = s.substr(0, eq);
+  auto value = s.substr(eq + 1);
+  auto colon = value.find(':');
+  if (colon != std::string::npos) {
+    *seeded = true;
+    if (!parse_number(value.substr(colon + 1), &a->seed)) {
+      return false;
+    }
+    value = value.substr(0, colon);
+  }
+  return parse_number(value, &a->value);
+}
+
+std::string to_string(double d) { return Equation::NumberRepr(d).String(); }
+
+/** eval_at evaluates the expression at the given point. If a seed is given
+ for any variable, the derivative in the direction of the seeds is printed as
+ well. It is computed with dual numbers in the same pass as the value. */
+int eval_at(const std::string &expression,
+            const std::vector<Assignment> &point, bool seeded) {
+  Equation::Equation eq;
+  if (!eq.Set(expression)) {
+    return 1;
+  }
+  try {
+    if (!seeded) {
+      auto state = std::make_shared<Equation::DefaultState>();
+      for (const auto &a : point) {
+        state->SetVariable(a.name,
+                           std::make_shared<Equation::Number>(a.value));
+      }
+      std::cout << eq.Evaluate(true, state) << "\n";
+      return 0;
+    }
+    eq.Evaluate();
+    std::vector<std::string> names;
+    for (const auto &a : point) {
+      names.push_back(a.name);
+    }
+    auto program = eq.Compile(names);
+    if (!program.IsReal() || program.Variables().size() > point.size()) {
+      std::cerr << "error: expression is not a real function of the given "
+                   "variables\n";
+      return 1;
+    }
+    std::vector<Equation::Dual> values;
+    for (const auto &a : point) {
+      values.push_back(Equation::Dual(a.value, a.seed));
+    }
+    auto result = program.Evaluate(values);
+    std::cout << to_string(result.value) << "\n"
+              << "derivative: " << to_string(result.derivative) << "\n";
+  } catch (const std::exception &e) {
+    std::cerr << "error: " << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
+
+/** calculatorf evaluates expressions numerically, e.g.
+
+   calculatorf "x^2*sin(y)" x=2 y=1
+   calculatorf "x^2*sin(y)" x=2:1 y=1:0
+
+ The second form also prints the derivative in the direction of the seeds
+ after the colons, here the partial derivative with respect to x. */
 int main(int argc, char *argv[]) {
   if (argc >= 3) {
-    std::cerr << "error: too many arguments\n";
-    return 1;
+    std::vector<Assignment> point;
+    bool seeded = false;
+    for (int i = 2; i < argc; i++) {
+      Assignment a;
+      if (!parse_assignment(argv[i], &a, &seeded)) {
+        std::cerr << "error: expected name=value[:seed], got '" << argv[i]
+                  << "'\n";
+        return 1;
+      }
+      auto same = [&a](const Assignment &b) { return b.name == a.name; };
+      if (std::any_of(point.begin(), point.end(), same)) {
+        std::cerr << "error: variable '" << a.name << "' is assigned twice\n";
+        return 1;
+      }
+      point.push_back(a);
+    }
+    return eval_at(argv[1], point, seeded);
   }
   if (argc == 2) {
     std::cout << eval(argv[1]) << "\n";
@@ -1,6 +1,30 @@
 #include "gtest/gtest.h"
 
+#include <cmath>
+#include <complex>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+#include "Builtins.hpp"
+#include "Canonical.hpp"
+#include "CppEmitter.hpp"
+#include "Error.h"
+#include "JitProgram.hpp"
 #include "Equation.hpp"
+#include "LimbPool.hpp"
+#include "MathFunction.hpp"
+#include "NodeArena.hpp"
+#include "Number.hpp"
+#include "NumberRepr.hpp"
+#include "Parser.hpp"
+#include "Polynomial.hpp"
+#include "SmallVector.hpp"
+#include "Summand.hpp"
+#include "UserFunction.hpp"
+#include "VectorMath.hpp"
+#include "formulas.hpp"
+#include "formulas_inline.hpp"
 
 std::string eval(const std::string &expression) {
   Equation::Equation eq;
@@ -80,11 +104,21 @@ TEST(Equation, Power) {
   EQUATION_EXPECT_EQUAL("(-x)*(-y)*(-z)", "-(x*y*z)");
 }
 
+TEST(Equation, PowerManyFactors) {
+  std::string product, expected;
+  for (int i = 0; i < 200; i++) {
+    auto x = "x" + std::to_string(i);
+    product += x + "^2*" + x + "^a*y/" + x + "*";
+    expected += x + "^(a+1)*";
+  }
+  EQUATION_EXPECT_EQUAL(product + "1", expected + "y^200");
+}
+
 TEST(Equation, Summand) {
   EQUATION_EXPECT_EQUAL("x-x", "0");
   EQUATION_EXPECT_EQUAL("x+x", "2*x");
   EQUATION_EXPECT_EQUAL("4*x^2+5*x^2", "9*x^2");
-  EQUATION_EXPECT_EQUAL("(x+1)+(x+1)+(x+1)", "3*(x+1)");
+  EQUATION_EXPECT_EQUAL("(x+1)+(x+1)+(x+1)", "3*x+3");
   EQUATION_EXPECT_EQUAL("x+x+y+2*y+z", "2*x+3*y+z");
   EQUATION_EXPECT_EQUAL("x+x+y+2*y-z", "2*x+3*y-z");
   EQUATION_EXPECT_EQUAL("x-x+y-2*y-z", "-y-z");
@@ -92,6 +126,16 @@ TEST(Equation, Summand) {
   EQUATION_EXPECT_EQUAL("x-2*x", "-x");
 }
 
+TEST(Equation, SummandManyTerms) {
+  std::string sum, expected;
+  for (int i = 0; i < 300; i++) {
+    auto x = "x" + std::to_string(i);
+    sum += x + "*y+2*" + x + "*y-" + x + "+";
+    expected += "3*" + x + "*y-" + x + "+";
+  }
+  EQUATION_EXPECT_EQUAL(sum + "0", expected + "0");
+}
+
 TEST(Equation, Latex) {
   EXPECT_EQ(Eq("x / y").ToLatex(), "\\frac{x}{y}");
   EXPECT_EQ(Eq("x / y^3").ToLatex(), "\\frac{x}{y^{3}}");
@@ -322,3 +366,648 @@ TEST(Equation, Root) {
   EQUATION_EXPECT_EQUAL("(-4)^(1/2)", "2*i");
   EQUATION_EXPECT_EQUAL("sqrt(-7)", "sqrt(7)*i");
 }
+
+TEST(NodeArena, ReusesFreedNodes) {
+  Equation::NodeArenaPtr arena(new Equation::NodeArena);
+  Equation::NodeArena::Scope scope(arena);
+  auto a = Equation::new_node<Equation::Number>(1l);
+  auto ptr = a.get();
+  a.reset();
+  auto b = Equation::new_node<Equation::Number>(2l);
+  EXPECT_EQ(ptr, b.get());
+}
+
+TEST(NodeArena, EquationOutlivesCopy) {
+  Equation::Equation copy;
+  {
+    Equation::Equation eq;
+    eq.Set("x+x");
+    copy = eq;
+    eq.Set("y");
+  }
+  EXPECT_EQ(copy.Evaluate(), "2 * x");
+}
+
+Equation::NodePtr Node(const std::string &expr) {
+  Equation::Parser parser;
+  auto node = parser.Parse(expr);
+  node->Eval(&node, std::make_shared<Equation::DefaultState>());
+  return node;
+}
+
+TEST(Node, Hash) {
+  EXPECT_EQ(Node("x*y+2*sin(z)")->Hash(), Node("sin(z)*2+y*x")->Hash());
+  EXPECT_EQ(Node("x^2")->Hash(), Node("x*x")->Hash());
+  EXPECT_NE(Node("x+y")->Hash(), Node("x+z")->Hash());
+  EXPECT_NE(Node("x^y")->Hash(), Node("y^x")->Hash());
+  EXPECT_TRUE(Node("x*y+2*sin(z)")->equals(Node("sin(z)*2+y*x")));
+  EXPECT_FALSE(Node("x*y+2*sin(z)")->equals(Node("sin(z)*2+y*z")));
+}
+
+TEST(SmallVector, Operations) {
+  Equation::SmallVector<std::string, 2> v = {"b", "c"};
+  v.push_front("a");
+  v.push_back("d");
+  ASSERT_EQ(v.size(), 4u);
+  EXPECT_EQ(v.front(), "a");
+  EXPECT_EQ(v.back(), "d");
+
+  auto it = v.erase(v.begin() + 1);
+  EXPECT_EQ(*it, "c");
+  std::vector<std::string> other = {"x", "y"};
+  v.insert(v.begin() + 1, other.begin(), other.end());
+  EXPECT_EQ(std::vector<std::string>(v.begin(), v.end()),
+            std::vector<std::string>({"a", "x", "y", "c", "d"}));
+
+  std::string removed;
+  v.remove_if([&removed](const std::string &s) {
+    if (s == "x" || s == "c") {
+      removed += s;
+      return true;
+    }
+    return false;
+  });
+  EXPECT_EQ(removed, "xc");
+  EXPECT_EQ(std::vector<std::string>(v.begin(), v.end()),
+            std::vector<std::string>({"a", "y", "d"}));
+
+  auto moved = std::move(v);
+  EXPECT_TRUE(v.empty());
+  moved.pop_front();
+  moved.sort([](const std::string &a, const std::string &b) { return b < a; });
+  EXPECT_EQ(std::vector<std::string>(moved.begin(), moved.end()),
+            std::vector<std::string>({"y", "d"}));
+}
+
+TEST(Node, CanonicalOrder) {
+  auto a = Node("x*y+2*sin(z)");
+  auto b = Node("sin(z)*2+y*x");
+  auto c = Node("x^2+y");
+  EXPECT_EQ(Equation::canonical_compare(a, b), 0);
+  EXPECT_NE(Equation::canonical_compare(a, c), 0);
+  EXPECT_EQ(Equation::canonical_compare(a, c) < 0,
+            Equation::canonical_compare(c, a) > 0);
+
+  Equation::NodeList l1 = {Node("x"), Node("2"), Node("y^2"), Node("cos(x)")};
+  Equation::NodeList l2 = {Node("cos(x)"), Node("y^2"), Node("x"), Node("2")};
+  Equation::canonical_sort(l1);
+  Equation::canonical_sort(l2);
+  for (size_t i = 0; i < l1.size(); i++) {
+    EXPECT_TRUE(l1[i]->equals(l2[i]));
+  }
+
+  // the cached order follows modifications of the operands.
+  auto sum = std::static_pointer_cast<Equation::Summand>(Node("x+y"));
+  EXPECT_TRUE(sum->equals(Node("y+x")));
+  sum->Data().push_back(Node("z"));
+  EXPECT_TRUE(sum->equals(Node("z+y+x")));
+  EXPECT_FALSE(sum->equals(Node("y+x")));
+}
+
+TEST(Equation, Flatten) {
+  EXPECT_EQ(eval("x+(y+(z+1))+2"), "x + y + z + 3");
+  EXPECT_EQ(eval("x*(y*(z*2))*3"), "6 * x * y * z");
+}
+
+TEST(NumberRepr, SmallFastPath) {
+  using Equation::NumberRepr;
+  using Equation::Integer_t;
+  NumberRepr a(3l, 4l);
+  NumberRepr b(-6l, 8l);
+  EXPECT_TRUE(a.IsSmall());
+  EXPECT_EQ((a + b).String(), "0");
+  EXPECT_EQ((a * b).String(), "-9 / 16");
+  EXPECT_EQ((a / b).String(), "-1");
+  EXPECT_TRUE(NumberRepr(Integer_t(5)) == NumberRepr(5l));
+  EXPECT_EQ(NumberRepr(Integer_t(5)).Hash(), NumberRepr(5l).Hash());
+
+  // results which do not fit into 64 bits are promoted and demoted again.
+  NumberRepr big(std::numeric_limits<long>::max());
+  NumberRepr sq = big * big;
+  EXPECT_FALSE(sq.IsSmall());
+  EXPECT_EQ(sq.Numerator(), Integer_t(std::numeric_limits<long>::max()) *
+                                std::numeric_limits<long>::max());
+  NumberRepr back = sq / big;
+  EXPECT_TRUE(back.IsSmall());
+  EXPECT_TRUE(back == big);
+  EXPECT_EQ(back.Hash(), big.Hash());
+  EXPECT_TRUE(NumberRepr("123456789012345678901234567890") >
+              NumberRepr("123456789012345678"));
+
+  EXPECT_EQ(NumberRepr::Pow(NumberRepr(2l, 3l), NumberRepr(-3l)).String(),
+            "27 / 8");
+  EXPECT_EQ(NumberRepr::Pow(NumberRepr(10l), NumberRepr(30l)).String(),
+            "1000000000000000000000000000000");
+  EXPECT_THROW(NumberRepr::Pow(NumberRepr(0l), NumberRepr(-1l)),
+               std::overflow_error);
+}
+
+TEST(Equation, DivideByZero) {
+  for (auto expr : {"1/0", "0^(-2)", "x/0", "1/(2-2)"}) {
+    try {
+      eval(expr);
+      ADD_FAILURE() << expr << " did not throw";
+    } catch (const std::overflow_error &e) {
+      EXPECT_STREQ(e.what(), "Divide by zero.") << expr;
+    }
+  }
+}
+
+// only the cpp_int backend allocates its limbs from the pool.
+#if !defined(CALCULATOR_BIGNUM_GMP) && !defined(CALCULATOR_BIGNUM_CHECKED)
+TEST(LimbPool, ReusesBuffers) {
+  using Equation::LimbPool;
+  LimbPool::Release();
+  EXPECT_EQ(LimbPool::Cached(), 0u);
+  {
+    Equation::Integer_t big = Equation::Integer_t(1) << 1000;
+    EXPECT_EQ(big.str().size(), 302u);
+  }
+  auto cached = LimbPool::Cached();
+  EXPECT_GT(cached, 0u);
+  {
+    Equation::Integer_t big = Equation::Integer_t(3) << 1000;
+    big += 1;
+  }
+  EXPECT_EQ(LimbPool::Cached(), cached);
+  LimbPool::Release();
+  EXPECT_EQ(LimbPool::Cached(), 0u);
+}
+#endif
+
+TEST(Program, Evaluate) {
+  Equation::Equation eq;
+  eq.Set("3*x^2-2*x*y+sin(y)/(1+x)^3-sqrt(x)+pi");
+  eq.Evaluate();
+  auto prog = eq.Compile({"x", "y"});
+  ASSERT_EQ(prog.Variables().size(), 2u);
+  EXPECT_TRUE(prog.IsReal());
+  for (double x = 0.5; x < 3; x += 0.75) {
+    for (double y = -1; y < 1; y += 0.5) {
+      double expected = 3 * x * x - 2 * x * y +
+                        std::sin(y) / std::pow(1 + x, 3) - std::sqrt(x) +
+                        M_PI;
+      EXPECT_NEAR(prog.Evaluate(std::vector<double>{x, y}), expected, 1e-12);
+    }
+  }
+
+  eq.Set("exp(i*x)+z");
+  eq.Evaluate();
+  prog = eq.Compile();
+  ASSERT_EQ(prog.Variables().size(), 2u);
+  EXPECT_EQ(prog.Variables()[0], "x");
+  EXPECT_FALSE(prog.IsReal());
+  auto c = prog.Evaluate(std::vector<std::complex<double>>{2.0, 1.0});
+  EXPECT_NEAR(c.real(), std::cos(2.0) + 1.0, 1e-12);
+  EXPECT_NEAR(c.imag(), std::sin(2.0), 1e-12);
+
+  eq.Set("f(x)");
+  eq.Evaluate();
+  EXPECT_THROW(eq.Compile(), Equation::InputError);
+}
+
+TEST(VectorMath, Functions) {
+  std::vector<double> x;
+  for (int i = -2000; i <= 2000; i++) {
+    x.push_back(i * 0.0173);
+  }
+  x.push_back(1e-300);
+  x.push_back(800.0);
+  x.push_back(-800.0);
+  x.push_back(1e7);
+  x.push_back(std::numeric_limits<double>::infinity());
+  x.push_back(std::numeric_limits<double>::quiet_NaN());
+
+  auto check = [&x](void (*vf)(const double *, double *, std::size_t),
+                    double (*f)(double), const std::string &name) {
+    std::vector<double> y(x.size());
+    vf(x.data(), y.data(), x.size());
+    for (std::size_t i = 0; i < x.size(); i++) {
+      double expected = f(x[i]);
+      if (std::isnan(expected)) {
+        EXPECT_TRUE(std::isnan(y[i])) << name << "(" << x[i] << ")";
+        continue;
+      }
+      if (std::isinf(expected)) {
+        EXPECT_EQ(y[i], expected) << name << "(" << x[i] << ")";
+        continue;
+      }
+      double tol = 4e-16 * std::max(1.0, std::abs(expected));
+      EXPECT_NEAR(y[i], expected, tol) << name << "(" << x[i] << ")";
+    }
+    // in place
+    std::vector<double> z = x;
+    vf(z.data(), z.data(), z.size());
+    for (std::size_t i = 0; i < x.size(); i++) {
+      EXPECT_TRUE(z[i] == y[i] || (std::isnan(z[i]) && std::isnan(y[i])));
+    }
+  };
+  check(Equation::vec_exp, [](double v) { return std::exp(v); }, "exp");
+  check(Equation::vec_log, [](double v) { return std::log(v); }, "log");
+  check(Equation::vec_sin, [](double v) { return std::sin(v); }, "sin");
+  check(Equation::vec_cos, [](double v) { return std::cos(v); }, "cos");
+  check(Equation::vec_tan, [](double v) { return std::tan(v); }, "tan");
+}
+
+TEST(Program, EvaluateBatch) {
+  Equation::Equation eq;
+  eq.Set("x^3/(1+y^2)-exp(-x)*cos(y)+log(1+x^2)*tan(y/4)");
+  eq.Evaluate();
+  auto prog = eq.Compile({"x", "y"});
+  const std::size_t n = 1000;
+  std::vector<double> xs(n), ys(n), out(n);
+  for (std::size_t i = 0; i < n; i++) {
+    xs[i] = -3.0 + 0.006 * i;
+    ys[i] = 2.0 - 0.004 * i;
+  }
+  const double *columns[] = {xs.data(), ys.data()};
+  prog.EvaluateBatch(columns, n, out.data());
+  for (std::size_t i = 0; i < n; i++) {
+    double expected = prog.Evaluate(std::vector<double>{xs[i], ys[i]});
+    EXPECT_NEAR(out[i], expected, 1e-13 * std::max(1.0, std::abs(expected)));
+  }
+}
+
+TEST(JitProgram, Evaluate) {
+  if (!Equation::JitProgram::Supported()) {
+    return;
+  }
+  Equation::Equation eq;
+  eq.Set("-x^5/(2+y^2)^2+sqrt(x)*exp(-y)-sin(x*y)+x^y+1/x^3+atan(y)-pi");
+  eq.Evaluate();
+  auto prog = eq.Compile({"x", "y"});
+  Equation::JitProgram jit(prog);
+  EXPECT_EQ(jit.Variables(), prog.Variables());
+  for (double x = 0.25; x < 4; x += 0.5) {
+    for (double y = -2; y < 2; y += 0.5) {
+      double values[] = {x, y};
+      EXPECT_EQ(jit.Evaluate(values), prog.Evaluate(values));
+    }
+  }
+
+  eq.Set("42");
+  eq.Evaluate();
+  Equation::JitProgram constant(eq.Compile());
+  EXPECT_EQ(constant.Evaluate(nullptr), 42.0);
+
+  eq.Set("x*i");
+  eq.Evaluate();
+  EXPECT_THROW(Equation::JitProgram(eq.Compile()), Equation::InputError);
+}
+
+TEST(CppEmitter, Generated) {
+  Equation::Equation eq;
+  eq.Set("exp(-(x^2+y^2))*cos(x*y)+(x+y)^3/(1+x^2)");
+  eq.Evaluate();
+  auto prog = eq.Compile({"x", "y"});
+  for (double x = -2; x < 2; x += 0.5) {
+    for (double y = -2; y < 2; y += 0.5) {
+      double expected = prog.Evaluate(std::vector<double>{x, y});
+      EXPECT_NEAR(bump(x, y), expected, 1e-14 * std::max(1.0, std::abs(expected)));
+    }
+  }
+  EXPECT_DOUBLE_EQ(area(2.0), 4 * M_PI);
+
+  static_assert(cubic(2.0) == 8.0 - 4.0 + 0.5, "cubic is constexpr");
+
+  std::stringstream s;
+  eq.Set("sin(x)*sin(x)+sin(x)");
+  eq.Evaluate();
+  Equation::CppEmitter(true).Emit(s, "f", eq.Compile());
+  EXPECT_EQ(s.str(), "inline double f(double x) {\n"
+                     "  const double _t0 = std::sin(x);\n"
+                     "  const double _t1 = calcgen_powi(_t0, 2);\n"
+                     "  const double _t2 = _t1 + _t0;\n"
+                     "  return _t2;\n"
+                     "}\n");
+
+  Equation::CppEmitter emitter;
+  for (auto name : {"new", "int", "auto", "f-1", " x", "_t0", "std", "1f"}) {
+    EXPECT_THROW(emitter.Emit(s, name, eq.Compile()), Equation::InputError)
+        << name;
+    EXPECT_THROW(emitter.Emit(s, "f", eq.Compile({name})),
+                 Equation::InputError)
+        << name;
+  }
+}
+
+TEST(State, SharedBuiltins) {
+  auto a = std::make_shared<Equation::DefaultState>();
+  auto b = std::make_shared<Equation::DefaultState>();
+  auto pi = Equation::Builtins::Get().Variable("pi");
+  ASSERT_TRUE(pi);
+  EXPECT_EQ(a->GetVariable("pi"), pi);
+  EXPECT_TRUE(a->IsFunction("sin"));
+  EXPECT_FALSE(Equation::State().IsFunction("sin"));
+
+  // user variables hide the builtins of the state only.
+  a->SetVariable("pi", std::make_shared<Equation::Number>(3l));
+  EXPECT_EQ(a->GetVariable("pi")->ToString(), "3");
+  EXPECT_EQ(b->GetVariable("pi"), pi);
+
+  // builtins created while an arena is active must not use the arena.
+  {
+    Equation::Equation eq;
+    eq.Set("sin(3*pi/2)+D(cos(x),x)");
+    EXPECT_EQ(eq.Evaluate(), "-sin(x) - 1");
+  }
+  EXPECT_EQ(eval("cos(pi)"), "-1");
+
+  // special values are looked up without a copy. Eval returns a copy, so
+  // evaluating it does not change the table.
+  auto sin = Equation::Builtins::Get().Function("sin");
+  Equation::NodeList args;
+  args.push_back(Node("pi/3"));
+  Equation::NodePtr v1, v2;
+  ASSERT_TRUE(sin->SpecialValues(args, &v1));
+  ASSERT_TRUE(sin->SpecialValues(args, &v2));
+  EXPECT_EQ(v1, v2);
+  auto value = sin->Eval(args);
+  EXPECT_NE(value, v1);
+  EXPECT_EQ(eval("2*sin(pi/3)"), "3 ^ (1 / 2)");
+  EXPECT_EQ(v1->ToString(), "1 / 2 * 3 ^ (1 / 2)");
+
+  // functions with their own Eval return a copy as well.
+  Equation::FuncSqrt sqrt;
+  sqrt.AddSpecialValue(Equation::UserFunction::make_node("4"), "2");
+  Equation::NodeList four;
+  four.push_back(Node("4"));
+  ASSERT_TRUE(sqrt.SpecialValues(four, &v1));
+  EXPECT_NE(sqrt.Eval(four), v1);
+}
+
+TEST(Equation, TrigRationalMultiplesOfPi) {
+  EQUATION_EXPECT_EQUAL("sin(7/12*pi)", "(6^(1/2)+2^(1/2))/4");
+  EQUATION_EXPECT_EQUAL("cos(5/6*pi)", "-3^(1/2)/2");
+  EQUATION_EXPECT_EQUAL("sin(-pi/4)", "-2^(1/2)/2");
+  EQUATION_EXPECT_EQUAL("cos(13/5*pi)", "-(5^(1/2)-1)/4");
+  EQUATION_EXPECT_EQUAL("tan(2/3*pi)", "-3^(1/2)");
+  EQUATION_EXPECT_EQUAL("sin(2/7*pi)", "sin(2/7*pi)");
+  EQUATION_EXPECT_EQUAL("tan(pi/2)", "tan(pi/2)");
+  EQUATION_EXPECT_EQUAL("sin(pi/7)", "sin(pi/7)");
+  EXPECT_EQ(eval("tan(7*pi/12)"), "-3 ^ (1 / 2) - 2");
+
+  // compare the exact values with the numerical values.
+  const long denominators[] = {1, 2, 3, 4, 5, 6, 8, 10, 12, 15, 16, 20, 24};
+  for (auto n : denominators) {
+    for (long k = -2 * n; k <= 2 * n; k++) {
+      std::stringstream arg;
+      arg << "(" << k << "/" << n << "*pi)";
+      double x = k * M_PI / n;
+      EXPECT_NEAR(std::stod(evalf("sin" + arg.str())), std::sin(x), 1e-12)
+          << arg.str();
+      EXPECT_NEAR(std::stod(evalf("cos" + arg.str())), std::cos(x), 1e-12)
+          << arg.str();
+      if (2 * k % n != 0 || (2 * k / n) % 2 == 0) {
+        EXPECT_NEAR(std::stod(evalf("tan" + arg.str())), std::tan(x), 1e-9)
+            << arg.str();
+      }
+    }
+  }
+}
+
+TEST(Equation, DerivativeRules) {
+  EQUATION_EXPECT_EQUAL("D(2^x,x)", "2^x*log(2)");
+  EQUATION_EXPECT_EQUAL("D(x^x,x)", "x^(x-1)*(x+x*log(x))");
+  EQUATION_EXPECT_EQUAL("D(x*y*sin(x),x)", "y*(sin(x)+x*cos(x))");
+  EQUATION_EXPECT_EQUAL("D(sin(x)^2+sin(x)^2,x)", "4*sin(x)*cos(x)");
+  EQUATION_EXPECT_EQUAL("D(atan(x^2),x)", "2*x/(1+x^4)");
+  EQUATION_EXPECT_EQUAL("D(D(x^3,x),x)", "6*x");
+  EQUATION_EXPECT_EQUAL("D(f(x),x)", "D(f(x),x)");
+  EQUATION_EXPECT_EQUAL("D(x^2+f(x),x)", "2*x+D(f(x),x)");
+}
+
+TEST(Equation, TaylorSeries) {
+  EQUATION_EXPECT_EQUAL("taylor(sin(x),x,0,5)", "x-x^3/6+x^5/120");
+  EQUATION_EXPECT_EQUAL("taylor(log(1+x),x,0,3)", "x-x^2/2+x^3/3");
+  EQUATION_EXPECT_EQUAL("taylor(tan(x),x,0,5)", "x+x^3/3+2*x^5/15");
+  EQUATION_EXPECT_EQUAL("taylor(1/(1-x),x,0,3)", "1+x+x^2+x^3");
+  EQUATION_EXPECT_EQUAL("taylor(x^3,x,1,3)", "1+3*(x-1)+3*(x-1)^2+(x-1)^3");
+  EQUATION_EXPECT_EQUAL("taylor(sqrt(x),x,0,2)", "taylor(sqrt(x),x,0,2)");
+  EQUATION_EXPECT_EQUAL("D(x^5,x,3)", "60*x^2");
+  EQUATION_EXPECT_EQUAL("D(sin(y*x),x,4)", "y^4*sin(y*x)");
+  EQUATION_EXPECT_EQUAL("D(x^3,x,0)", "x^3");
+  EQUATION_EXPECT_EQUAL("D(f(x),x,2)", "D(f(x),x,2)");
+
+  // D(f,x,n) agrees with nested first derivatives.
+  auto check = [](const std::string &f, double from, double to, double step) {
+    Equation::Equation d, nested;
+    d.Set("D(" + f + ",x,3)");
+    d.Evaluate();
+    nested.Set("D(D(D(" + f + ",x),x),x)");
+    nested.Evaluate();
+    auto p = d.Compile({"x"});
+    auto q = nested.Compile({"x"});
+    ASSERT_TRUE(p.IsReal()) << f << ": " << d.ToString();
+    for (double x = from; x < to; x += step) {
+      double expected = q.Evaluate(std::vector<double>{x});
+      EXPECT_NEAR(p.Evaluate(std::vector<double>{x}), expected,
+                  1e-12 * std::abs(expected))
+          << f << " at " << x;
+    }
+  };
+  check("exp(sin(x))*atan(x)/(2+x^2)+x^x", 0.3, 2, 0.4);
+  check("asin(x)", -0.9, 0.95, 0.3);
+  check("acos(2*x)", -0.45, 0.45, 0.15);
+  check("artanh(x)", -0.9, 0.95, 0.3);
+  EQUATION_EXPECT_EQUAL("D(asin(x),x,2)", "D(D(asin(x),x),x)");
+  EQUATION_EXPECT_EQUAL("D(acos(x),x,2)", "D(D(acos(x),x),x)");
+}
+
+TEST(Equation, Expand) {
+  EQUATION_EXPECT_EQUAL("expand((x+1)^2)", "x^2+2*x+1");
+  EQUATION_EXPECT_EQUAL("expand((a+b+c)^2)", "a^2+b^2+c^2+2*a*b+2*a*c+2*b*c");
+  EQUATION_EXPECT_EQUAL("expand((x+1/2)*(x-1/2))", "x^2-1/4");
+  EQUATION_EXPECT_EQUAL("expand(sin(x)*(sin(x)+y))", "sin(x)^2+y*sin(x)");
+  EQUATION_EXPECT_EQUAL("expand((x+1/x)^2)", "x^2+2+x^(-2)");
+  EQUATION_EXPECT_EQUAL("expand((sqrt(x)+1)^2)", "x+2*sqrt(x)+1");
+  EQUATION_EXPECT_EQUAL("expand((x-y)^2-(x+y)^2)", "-4*x*y");
+  EQUATION_EXPECT_EQUAL("expand((x+1)*(x-1)/y)", "x^2/y-1/y");
+
+  // sums of polynomials are multiplied out if terms cancel.
+  EQUATION_EXPECT_EQUAL("(x+1)^2-x^2-1", "2*x");
+  EQUATION_EXPECT_EQUAL("(a+b)^2-(a-b)^2", "4*a*b");
+  EXPECT_EQ(eval("(x+1)^2+1"), "(x + 1) ^ 2 + 1");
+
+  Equation::Equation eq;
+  eq.Set("expand((1+x+2*y)^20)");
+  eq.Evaluate();
+  auto expanded = eq.Compile({"x", "y"});
+  EXPECT_NEAR(expanded.Evaluate(std::vector<double>{0.3, -0.2}),
+              std::pow(1 + 0.3 - 0.4, 20), 1e-12);
+  EXPECT_EQ(eq.ToString().find('('), std::string::npos);
+}
+
+TEST(Polynomial, Multiplication) {
+  // Pow squares dense polynomials by Kronecker substitution, multiplying
+  // with the base multiplies term by term.
+  const char *bases[] = {"1+x+y", "x-2*y+1/3", "1-x", "x^2-3*x*y+y/7-5"};
+  for (auto base : bases) {
+    auto n = Equation::UserFunction::make_node(base);
+    Equation::PolynomialRing ring;
+    ASSERT_TRUE(ring.Add(n));
+    auto p = ring.FromNode(n);
+    auto vars = ring.Generators().size();
+    auto product = Equation::Polynomial::Constant(Equation::Rational_t(1), vars);
+    for (int i = 0; i < 40; i++) {
+      product = product * p;
+    }
+    EXPECT_TRUE(p.Pow(40) == product) << base;
+  }
+  auto sum = Equation::UserFunction::make_node("x+y");
+  auto diff = Equation::UserFunction::make_node("x-y");
+  Equation::PolynomialRing ring;
+  ring.Add(sum);
+  auto a = ring.FromNode(sum).Pow(50);
+  auto b = ring.FromNode(diff).Pow(50);
+  // (x+y)^50 * (x-y)^50 = (x^2-y^2)^50 has 51 terms with alternating signs.
+  auto c = a * b;
+  ASSERT_EQ(c.NumTerms(), 51u);
+  EXPECT_EQ(c.Coefficient(1), Equation::Rational_t(-50));
+  auto squares = Equation::UserFunction::make_node("x^2-y^2");
+  EXPECT_TRUE(c == ring.FromNode(squares).Pow(50));
+}
+
+TEST(Polynomial, Gcd) {
+  Equation::PolynomialRing ring;
+  ring.Add(Equation::UserFunction::make_node("x*y*z"));
+  auto poly = [&ring](const char *s) {
+    return ring.FromNode(Equation::UserFunction::make_node(s));
+  };
+  struct {
+    const char *a, *b, *gcd;
+  } cases[] = {
+      {"x^2-1", "x^2-2*x+1", "x-1"},
+      {"2*x^2-2", "4*x+4", "x+1"},
+      {"x^2/2-y^2/2", "3*x-3*y", "x-y"},
+      {"(x+y+z)^5*(x-2*y)^2*(z+1)", "(x+y+z)^3*(x-2*y)*(z-1)",
+       "(x+y+z)^3*(x-2*y)"},
+      {"(1000*x^3+y)*(x+3)", "(1000*x^3+y)*(x-3)", "1000*x^3+y"},
+      {"x^3+y", "x^2+z", "1"},
+      {"-x-1", "0", "x+1"},
+  };
+  for (const auto &c : cases) {
+    auto a = poly(c.a), b = poly(c.b);
+    auto g = Equation::Polynomial::Gcd(a, b);
+    EXPECT_TRUE(g == poly(c.gcd)) << c.a << ", " << c.b;
+    Equation::Polynomial q;
+    EXPECT_TRUE(a.Divide(g, &q)) << c.a;
+  }
+  Equation::Polynomial q;
+  EXPECT_FALSE(poly("x^2+1").Divide(poly("x+1"), &q));
+  ASSERT_TRUE(poly("x^3-y^3").Divide(poly("x-y"), &q));
+  EXPECT_TRUE(q == poly("x^2+x*y+y^2"));
+}
+
+TEST(Equation, Normal) {
+  EQUATION_EXPECT_EQUAL("normal(1/x+1/y)", "(x+y)/(x*y)");
+  EQUATION_EXPECT_EQUAL("normal(1/x+1/(x*(x+1)))", "(x+2)/(x^2+x)");
+  EQUATION_EXPECT_EQUAL("normal((x^2-y^2)/(2*x+2*y))", "x/2-y/2");
+  EQUATION_EXPECT_EQUAL("normal(x/(x-1)-1/(x-1))", "1");
+  EQUATION_EXPECT_EQUAL("normal((a/b+1)/(a+b))", "1/b");
+  EQUATION_EXPECT_EQUAL("normal(sin(x)/(sin(x)^2+sin(x)))", "1/(sin(x)+1)");
+  EXPECT_EQ(eval("normal(x+1.5)"), "x + 1.5");
+
+  // common factors of products are cancelled automatically.
+  EQUATION_EXPECT_EQUAL("(x^2-1)/(x-1)", "x+1");
+  EQUATION_EXPECT_EQUAL("(x-1)/(x^2-1)", "1/(x+1)");
+  EQUATION_EXPECT_EQUAL("(1-x)/(x^2-1)", "-1/(x+1)");
+  EQUATION_EXPECT_EQUAL("x*y/(x^2+x*y)", "y/(x+y)");
+  EXPECT_EQ(eval("(6*x^2-6)/(4*x-4)"), "3 / 2 * (x + 1)");
+  EXPECT_EQ(eval("(4*x-4)/(6*x^2-6)"), "2 / 3 * (x + 1) ^ (-1)");
+  EQUATION_EXPECT_EQUAL("(a^3-b^3)*(a+b)/((a-b)*(a^2-b^2))",
+                        "(a^2+a*b+b^2)/(a-b)");
+  EXPECT_EQ(eval("x/(x+1)"), "x * (x + 1) ^ (-1)");
+}
+
+TEST(Program, Gradient) {
+  Equation::Equation eq;
+  eq.Set("x^3*y+sin(x*y)/z+exp(-z)*sqrt(x)+atan(y)^2+2^(x*z)+x^y+log(z)*x");
+  eq.Evaluate();
+  auto prog = eq.Compile({"x", "y", "z"});
+  const char *names[] = {"x", "y", "z"};
+  std::vector<double> point = {1.3, 0.7, 2.1};
+  std::vector<double> grad;
+  double value = prog.Gradient(point, &grad);
+  EXPECT_DOUBLE_EQ(value, prog.Evaluate(point));
+  ASSERT_EQ(grad.size(), 3u);
+  for (int j = 0; j < 3; j++) {
+    // compare with the symbolic derivative.
+    Equation::Equation d;
+    d.Set(std::string("D(") + eq.ToString() + "," + names[j] + ")");
+    d.Evaluate();
+    auto dprog = d.Compile({"x", "y", "z"});
+    EXPECT_NEAR(grad[j], dprog.Evaluate(point), 1e-12) << names[j];
+  }
+}
+
+TEST(Program, DualNumbers) {
+  Equation::Equation eq;
+  eq.Set("x^3*y+sin(x*y)/z+exp(-z)*sqrt(x)+atan(y)^2+2^(x*z)+x^y+log(z)*x");
+  eq.Evaluate();
+  auto prog = eq.Compile({"x", "y", "z"});
+  std::vector<double> point = {1.3, 0.7, 2.1};
+  std::vector<double> grad;
+  double value = prog.Gradient(point, &grad);
+  const double direction[] = {0.5, -1.0, 2.0};
+  std::vector<Equation::Dual> values;
+  for (int j = 0; j < 3; j++) {
+    values.push_back(Equation::Dual(point[j], direction[j]));
+  }
+  auto result = prog.Evaluate(values);
+  EXPECT_DOUBLE_EQ(result.value, value);
+  EXPECT_NEAR(result.derivative,
+              0.5 * grad[0] - grad[1] + 2.0 * grad[2], 1e-12);
+}
+
+TEST(Equation, GradJacobianHessian) {
+  EQUATION_EXPECT_EQUAL("grad(x^2*y+z,x,y,z)", "vector(2*x*y,x^2,1)");
+  EQUATION_EXPECT_EQUAL("jacobian(vector(x*y,sin(x)),x,y)",
+                        "matrix(vector(y,x),vector(cos(x),0))");
+  EQUATION_EXPECT_EQUAL("jacobian(x*y,x,y)", "matrix(vector(y,x))");
+  EQUATION_EXPECT_EQUAL("hessian(x^3*y^2,x,y)",
+                        "matrix(vector(6*x*y^2,6*x^2*y),vector(6*x^2*y,2*x^3))");
+  EXPECT_EQ(evalf("grad(sin(x),x)"), "vector(cos(x))");
+  EXPECT_THROW(eval("grad(x^2,2)"), Equation::InputError);
+}
+
+TEST(Equation, DerivativeWideProduct) {
+  // products with many factors are differentiated by splitting them.
+  std::stringstream f;
+  for (int i = 1; i <= 12; i++) {
+    f << (i > 1 ? "*" : "") << "(x+" << i << ")^" << (i % 3 + 1);
+  }
+  f << "*sin(x)*y";
+  Equation::Equation eq;
+  eq.Set(f.str());
+  eq.Evaluate();
+  Equation::Equation d;
+  d.Set("D(" + f.str() + ",x)");
+  d.Evaluate();
+  auto prog = eq.Compile({"x", "y"});
+  auto dprog = d.Compile({"x", "y"});
+  std::vector<double> grad;
+  for (double x = -0.4; x < 1; x += 0.3) {
+    prog.Gradient(std::vector<double>{x, 1.5}, &grad);
+    double expected = grad[0];
+    EXPECT_NEAR(dprog.Evaluate(std::vector<double>{x, 1.5}), expected,
+                1e-12 * std::abs(expected))
+        << x;
+  }
+  EXPECT_LT(d.ToString().size(), 5 * eq.ToString().size());
+
+  // the derivative is defined at the roots of the factors.
+  auto at = [](const std::string &f, long x) {
+    Equation::Equation d;
+    d.Set("D(" + f + ",x)");
+    Equation::Equation value;
+    value.Set(d.Evaluate());
+    auto state = std::make_shared<Equation::DefaultState>();
+    state->SetVariable("x", Equation::new_node<Equation::Number>(x));
+    return value.Evaluate(false, state);
+  };
+  const std::string roots = "(x+1)*(x+2)*(x+3)*(x+4)*(x+5)*(x+6)*(x+7)";
+  EXPECT_EQ(at("x*" + roots, 0), "5040");
+  EXPECT_EQ(at("x^3*" + roots, 0), "0");
+  EXPECT_EQ(at("x^3*" + roots, -1), "-720");
+}